@@ -6,54 +6,16 @@
 
 #include <argparse.h>
 
-#if defined(_WIN32) || defined(MSC_VER)
-#define WIN32_LEAN_AND_MEAN
-#define NOMINMAX
-#include <windows.h>
-#else
-#include <sys/stat.h>
-#include <unistd.h>
-#include <sys/errno.h>
-#endif
+#include "util/fs.h"
+#include "util/thread.h"
 
 
 static const char* const s_description = "Converts MT Framework XFS files to and from JSON.";
 static const char* const s_usages[] = {
-    "xfs2json [-h] [-o <output>] <input>",
+    "xfs2json [-h] [-m] [-j <jobs>] [-p <count>] [-d] [-s <count>] [-c <dir>] [-i] [-r <dir>] [-k] [-o <output>] <input>",
     NULL,
 };
 
-static bool util_fs_exists(const char* path) {
-#ifdef _WIN32
-    DWORD file_attr = GetFileAttributesA(path);
-    return file_attr != INVALID_FILE_ATTRIBUTES;
-#else
-    return access(path, F_OK) != -1;
-#endif
-}
-
-static bool util_fs_is_dir(const char* path) {
-#ifdef _WIN32
-    DWORD file_attr = GetFileAttributesA(path);
-    return (file_attr != INVALID_FILE_ATTRIBUTES && (file_attr & FILE_ATTRIBUTE_DIRECTORY));
-#else
-    struct stat statbuf;
-    if (stat(path, &statbuf) != 0) {
-        return false;
-    }
-
-    return S_ISDIR(statbuf.st_mode);
-#endif
-}
-
-static const char* util_fs_get_filename(const char* path) {
-    const char* filename = strrchr(path, '/');
-    if (filename == NULL) {
-        filename = strrchr(path, '\\');
-    }
-    return filename ? filename + 1 : (char*)path;
-}
-
 
 int args_parse(int argc, char** argv, Args* args) {
     if (argv == NULL || args == NULL) {
@@ -62,11 +24,28 @@ int args_parse(int argc, char** argv, Args* args) {
 
     char* input = NULL;
     char* output = NULL;
-    const char* input_extension = NULL;
+    int minify = 0;
+    int jobs = 0;
+    int pack = 0;
+    int dedup = 0;
+    int shards = 0;
+    char* cache = NULL;
+    int incremental = 0;
+    char* result_cache = NULL;
+    int keep_unchanged = 0;
 
     struct argparse_option options[] = {
         OPT_HELP(),
         OPT_STRING('o', "output", &output, "Output file/directory", NULL, 0, 0),
+        OPT_BOOLEAN('m', "minify", &minify, "Write JSON without whitespace", NULL, 0, 0),
+        OPT_INTEGER('j', "jobs", &jobs, "Number of threads to use (default: all cores)", NULL, 0, 0),
+        OPT_INTEGER('p', "pack", &pack, "Write arrays of plain values with at least this many elements as base64", NULL, 0, 0),
+        OPT_BOOLEAN('d', "dedup", &dedup, "Write repeated objects once and reference them afterwards", NULL, 0, 0),
+        OPT_INTEGER('s', "shards", &shards, "Split the largest array of objects in the root into this many files", NULL, 0, 0),
+        OPT_STRING('c', "cache", &cache, "Keep parsed XFS definitions in this directory across runs", NULL, 0, 0),
+        OPT_BOOLEAN('i', "incremental", &incremental, "Skip files of a directory that haven't changed since the last run", NULL, 0, 0),
+        OPT_STRING('r', "result-cache", &result_cache, "Keep converted files in this directory and copy them when the same input is converted again", NULL, 0, 0),
+        OPT_BOOLEAN('k', "keep-unchanged", &keep_unchanged, "Leave output files that already hold what would be written untouched", NULL, 0, 0),
         OPT_END(),
     };
 
@@ -80,6 +59,16 @@ int args_parse(int argc, char** argv, Args* args) {
         return ARGS_RESULT_EXIT;
     }
 
+    args->minify = minify != 0;
+    args->jobs = jobs > 0 ? jobs : thread_hardware_concurrency();
+    args->pack_min_count = pack > 0 ? (uint32_t)pack : 0;
+    args->dedup = dedup != 0;
+    args->shard_count = shards > 0 ? (uint32_t)shards : 0;
+    args->cache_dir = cache != NULL ? strdup(cache) : NULL;
+    args->incremental = incremental != 0;
+    args->result_cache_dir = result_cache != NULL ? strdup(result_cache) : NULL;
+    args->keep_unchanged = keep_unchanged != 0;
+
     input = argv[0]; {
         if (!util_fs_exists(input)) {
             printf("Error: %s does not exist!\n", input);
@@ -88,10 +77,6 @@ int args_parse(int argc, char** argv, Args* args) {
 
         args->input = strdup(input);
         args->is_bulk = util_fs_is_dir(input);
-
-        if (!args->is_bulk) {
-            input_extension = strrchr(input, '.');
-        }
     }
 
     if (output != NULL) {
@@ -109,8 +94,9 @@ int args_parse(int argc, char** argv, Args* args) {
 
             args->output = strdup(output);
         } else {
-            // For single file conversion, the output can either be a file or an existing directory
-            if (util_fs_is_dir(output)) {
+            // For single file conversion, the output can either be a file or an existing directory.
+            // Tables are written to a directory of their own, which may be left from an earlier run.
+            if (util_fs_is_dir(output) && !util_fs_has_extension(output, ".tables")) {
                 // If the output is a directory, we need to create the output file path
                 const char* filename = util_fs_get_filename(input);
                 const int length = snprintf(NULL, 0, "%s/%s", output, filename);
@@ -136,7 +122,8 @@ int args_parse(int argc, char** argv, Args* args) {
             args->output = strdup(input);
         } else {
             // Just using .xfs for now because we can't guess the actual extension it should be
-            const char* output_extension = strcmp(input_extension, ".json") == 0 ? "xfs" : "json";
+            const bool is_xfs_input = !util_fs_has_extension(input, ".json") && !util_fs_has_extension(input, ".msgpack");
+            const char* output_extension = is_xfs_input ? "json" : "xfs";
             const int length = snprintf(NULL, 0, "%s.%s", input, output_extension);
             output = malloc(length + 1);
             if (output == NULL) {
@@ -160,16 +147,29 @@ void args_free(Args* args) {
 
     free((void*)args->input);
     free((void*)args->output);
+    free((void*)args->cache_dir);
+    free((void*)args->result_cache_dir);
 
     args->input = NULL;
     args->output = NULL;
+    args->cache_dir = NULL;
+    args->result_cache_dir = NULL;
 }
 
 void args_print_help() {
-    printf("Usage: xfs2json [-h] [-o <output>] <input>\n");
+    printf("Usage: xfs2json [-h] [-m] [-j <jobs>] [-p <count>] [-d] [-s <count>] [-c <dir>] [-i] [-r <dir>] [-k] [-o <output>] <input>\n");
     printf("\n");
     printf("Options:\n");
     printf("    -h, --help              Displays this help and exits.\n");
     printf("    -o, --output <output>   Sets the output file/directory.\n");
+    printf("    -m, --minify            Writes JSON without whitespace.\n");
+    printf("    -j, --jobs <jobs>       Sets the number of threads to use (default: all cores).\n");
+    printf("    -p, --pack <count>      Writes arrays of plain values with at least <count> elements as base64.\n");
+    printf("    -d, --dedup             Writes repeated objects once and references them afterwards.\n");
+    printf("    -s, --shards <count>    Splits the largest array of objects in the root into <count> files.\n");
+    printf("    -c, --cache <dir>       Keeps parsed XFS definitions in <dir> across runs.\n");
+    printf("    -i, --incremental       Skips files of a directory that haven't changed since the last run.\n");
+    printf("    -r, --result-cache <dir> Keeps converted files in <dir> and copies them when the same input is converted again.\n");
+    printf("    -k, --keep-unchanged    Leaves output files that already hold what would be written untouched.\n");
     printf("    <input>                 Sets the input file/directory (required)\n");
 }
@@ -9,6 +9,15 @@ typedef struct Args {
     const char* output;
 
     bool is_bulk;
+    bool minify; //< Write JSON without indentation and line breaks
+    int jobs; //< Number of threads to use, at least 1
+    uint32_t pack_min_count; //< Pack arrays of plain values with at least this many elements, 0 never packs
+    bool dedup; //< Write repeated subtrees once and reference them afterwards
+    uint32_t shard_count; //< Split the largest array of objects in the root into this many files, 0 or 1 writes a single file
+    const char* cache_dir; //< Keep parsed XFS definitions here across runs, NULL for none
+    bool incremental; //< Skip the inputs of a bulk run that haven't changed since the last one
+    const char* result_cache_dir; //< Keep converted outputs here to copy instead of converting the same input again, NULL for none
+    bool keep_unchanged; //< Leave outputs that already hold exactly what would be written untouched
 } Args;
 
 enum {
@@ -0,0 +1,284 @@
+// xfs2json_codegen: generates the specialized codecs of codec.h from schemas.
+//
+// Usage: xfs2json_codegen -o <output.c> <schema.json>...
+//
+// Each input is a JSON document with a "$defs" array, as written to schemas/ in bulk mode or
+// embedded in a converted file. Every distinct definition (dti hash and property types) gets a
+// load and a save function with its fields unrolled, and the output ends with the table
+// xfs_def_codec_find searches.
+
+#include "xfs/codec.h"
+
+#include <cJSON.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct codegen_def {
+    xfs_def def; //< Only dti_hash, prop_count and the types and names of props are set
+    uint64_t signature;
+} codegen_def;
+
+typedef struct codegen {
+    codegen_def* defs; //< Free this
+    size_t count;
+    size_t capacity;
+} codegen;
+
+
+static char* codegen_read_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return NULL;
+    }
+
+    char* data = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    for (;;) {
+        if (capacity - size < 4096) {
+            capacity = capacity != 0 ? capacity * 2 : 65536;
+            char* grown = realloc(data, capacity + 1);
+            if (grown == NULL) {
+                fprintf(stderr, "Failed to allocate memory for %s\n", path);
+                free(data);
+                fclose(file);
+                return NULL;
+            }
+
+            data = grown;
+        }
+
+        const size_t read = fread(data + size, 1, capacity - size, file);
+        size += read;
+        if (read == 0) {
+            break;
+        }
+    }
+
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        free(data);
+        return NULL;
+    }
+
+    data[size] = '\0';
+    return data;
+}
+
+static bool codegen_add_def(codegen* gen, const cJSON* def_json) {
+    const cJSON* props_json = cJSON_GetObjectItem(def_json, "props");
+    if (!cJSON_IsObject(def_json) || !cJSON_IsNumber(cJSON_GetObjectItem(def_json, "dti")) || !cJSON_IsArray(props_json)) {
+        fprintf(stderr, "Invalid definition\n");
+        return false;
+    }
+
+    if (gen->count == gen->capacity) {
+        const size_t capacity = gen->capacity != 0 ? gen->capacity * 2 : 256;
+        codegen_def* grown = realloc(gen->defs, capacity * sizeof(codegen_def));
+        if (grown == NULL) {
+            fprintf(stderr, "Failed to allocate memory for definitions\n");
+            return false;
+        }
+
+        gen->defs = grown;
+        gen->capacity = capacity;
+    }
+
+    codegen_def* entry = &gen->defs[gen->count];
+    memset(entry, 0, sizeof(codegen_def));
+    entry->def.dti_hash = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(def_json, "dti"));
+    entry->def.prop_count = (uint32_t)cJSON_GetArraySize(props_json);
+    entry->def.props = calloc(entry->def.prop_count != 0 ? entry->def.prop_count : 1, sizeof(xfs_property_def));
+    if (entry->def.props == NULL) {
+        fprintf(stderr, "Failed to allocate memory for properties\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < entry->def.prop_count; i++) {
+        const cJSON* prop_json = cJSON_GetArrayItem(props_json, (int)i);
+        const char* name = cJSON_GetStringValue(cJSON_GetObjectItem(prop_json, "name"));
+        entry->def.props[i].type = (xfs_type_t)cJSON_GetNumberValue(cJSON_GetObjectItem(prop_json, "type"));
+        entry->def.props[i].name = strdup(name != NULL ? name : "");
+    }
+
+    entry->signature = xfs_def_codec_signature(&entry->def);
+    gen->count++;
+
+    return true;
+}
+
+static bool codegen_add_file(codegen* gen, const char* path) {
+    char* data = codegen_read_file(path);
+    if (data == NULL) {
+        return false;
+    }
+
+    cJSON* json = cJSON_Parse(data);
+    free(data);
+
+    const cJSON* defs = cJSON_GetObjectItem(json, "$defs");
+    if (!cJSON_IsArray(defs)) {
+        fprintf(stderr, "No $defs array in %s\n", path);
+        cJSON_Delete(json);
+        return false;
+    }
+
+    bool ok = true;
+    const cJSON* def_json = NULL;
+    cJSON_ArrayForEach(def_json, defs) {
+        if (!codegen_add_def(gen, def_json)) {
+            fprintf(stderr, "Failed to read definitions from %s\n", path);
+            ok = false;
+            break;
+        }
+    }
+
+    cJSON_Delete(json);
+    return ok;
+}
+
+static int codegen_compare(const void* a, const void* b) {
+    const codegen_def* x = a;
+    const codegen_def* y = b;
+    if (x->def.dti_hash != y->def.dti_hash) {
+        return x->def.dti_hash < y->def.dti_hash ? -1 : 1;
+    }
+
+    if (x->signature != y->signature) {
+        return x->signature < y->signature ? -1 : 1;
+    }
+
+    return 0;
+}
+
+// Property names end up in line comments, anything that could end or continue one is replaced
+static void codegen_write_comment(FILE* out, const char* name) {
+    fputs(" // ", out);
+    for (const char* c = name; c != NULL && *c != '\0'; c++) {
+        fputc(*c >= 0x20 && *c < 0x7F && *c != '\\' ? *c : '?', out);
+    }
+}
+
+static void codegen_write_def(FILE* out, const codegen_def* entry) {
+    const xfs_def* def = &entry->def;
+    const uint32_t dti = def->dti_hash;
+    const uint64_t sig = entry->signature;
+
+    fprintf(out, "// dti %08" PRIX32 ", %" PRIu32 " properties\n", dti, (uint32_t)def->prop_count);
+    fprintf(out, "static bool xfs_codec_load_%08" PRIX32 "_%016" PRIX64 "(xfs* xfs, xfs_object* obj, binary_reader* r) {\n", dti, sig);
+    for (uint32_t i = 0; i < def->prop_count; i++) {
+        fprintf(out, "    if (!xfs_codec_load_field(xfs, obj, %" PRIu32 ", (xfs_type_t)%d, r)) return false;", i, (int)def->props[i].type);
+        codegen_write_comment(out, def->props[i].name);
+        fputc('\n', out);
+    }
+    fputs("    (void)xfs; (void)obj; (void)r;\n    return true;\n}\n\n", out);
+
+    fprintf(out, "static bool xfs_codec_save_%08" PRIX32 "_%016" PRIX64 "(const xfs* xfs, const xfs_object* obj, binary_writer* w) {\n", dti, sig);
+    for (uint32_t i = 0; i < def->prop_count; i++) {
+        fprintf(out, "    if (!xfs_codec_save_field(xfs, obj, %" PRIu32 ", (xfs_type_t)%d, w)) return false;", i, (int)def->props[i].type);
+        codegen_write_comment(out, def->props[i].name);
+        fputc('\n', out);
+    }
+    fputs("    (void)xfs; (void)obj; (void)w;\n    return true;\n}\n\n", out);
+}
+
+static bool codegen_write(const codegen* gen, size_t input_count, const char* path) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    fprintf(out, "// Generated by xfs2json_codegen from %zu schema files, do not edit\n\n", input_count);
+    fputs("#include \"xfs/codec.h\"\n\n", out);
+
+    for (size_t i = 0; i < gen->count; i++) {
+        codegen_write_def(out, &gen->defs[i]);
+    }
+
+    // C has no empty arrays, an empty table still gets one (uncounted) entry
+    fputs("const xfs_def_codec xfs_generated_codecs[] = {\n", out);
+    for (size_t i = 0; i < gen->count; i++) {
+        const uint32_t dti = gen->defs[i].def.dti_hash;
+        const uint64_t sig = gen->defs[i].signature;
+        fprintf(out, "    { 0x%08" PRIX32 "u, 0x%016" PRIX64 "ull, xfs_codec_load_%08" PRIX32 "_%016" PRIX64 ", xfs_codec_save_%08" PRIX32 "_%016" PRIX64 " },\n",
+            dti, sig, dti, sig, dti, sig);
+    }
+    if (gen->count == 0) {
+        fputs("    { 0, 0, NULL, NULL },\n", out);
+    }
+    fputs("};\n\n", out);
+    fprintf(out, "const size_t xfs_generated_codec_count = %zu;\n", gen->count);
+
+    const bool failed = ferror(out) != 0;
+    if (fclose(out) != 0 || failed) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+static void codegen_free(codegen* gen) {
+    for (size_t i = 0; i < gen->count; i++) {
+        for (uint32_t j = 0; j < gen->defs[i].def.prop_count; j++) {
+            free(gen->defs[i].def.props[j].name);
+        }
+
+        free(gen->defs[i].def.props);
+    }
+
+    free(gen->defs);
+    gen->defs = NULL;
+    gen->count = 0;
+}
+
+int main(int argc, char** argv) {
+    const char* output = NULL;
+    int first_input = 1;
+    if (argc >= 3 && strcmp(argv[1], "-o") == 0) {
+        output = argv[2];
+        first_input = 3;
+    }
+
+    if (output == NULL) {
+        fprintf(stderr, "Usage: %s -o <output.c> <schema.json>...\n", argv[0]);
+        return -1;
+    }
+
+    codegen gen = { 0 };
+    for (int i = first_input; i < argc; i++) {
+        if (!codegen_add_file(&gen, argv[i])) {
+            codegen_free(&gen);
+            return -1;
+        }
+    }
+
+    // Schemas of different files repeat most definitions, each distinct one is generated once
+    qsort(gen.defs, gen.count, sizeof(codegen_def), codegen_compare);
+    size_t unique = 0;
+    for (size_t i = 0; i < gen.count; i++) {
+        if (unique != 0 && codegen_compare(&gen.defs[unique - 1], &gen.defs[i]) == 0) {
+            for (uint32_t j = 0; j < gen.defs[i].def.prop_count; j++) {
+                free(gen.defs[i].def.props[j].name);
+            }
+
+            free(gen.defs[i].def.props);
+            continue;
+        }
+
+        gen.defs[unique++] = gen.defs[i];
+    }
+    gen.count = unique;
+
+    const bool ok = codegen_write(&gen, (size_t)(argc - first_input), output);
+    codegen_free(&gen);
+
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,206 @@
+#include "arena.h"
+#include "thread.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGNMENT 16
+
+struct arena_block {
+    arena_block* next;
+    size_t size;
+    size_t used;
+};
+
+struct arena_pool {
+    mutex* lock;
+    arena_block* spare; //< Guarded by lock
+    size_t spare_size; //< Guarded by lock
+    size_t block_size;
+    size_t retain;
+};
+
+// Block headers are padded so the data following them stays aligned
+#define ARENA_HEADER_SIZE ((sizeof(arena_block) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+
+// Takes a regular block from the pool, or allocates one if it has none left
+static arena_block* arena_pool_take(arena_pool* pool) {
+    mutex_lock(pool->lock);
+    arena_block* block = pool->spare;
+    if (block != NULL) {
+        pool->spare = block->next;
+        pool->spare_size -= block->size;
+    }
+    mutex_unlock(pool->lock);
+
+    if (block == NULL) {
+        block = malloc(ARENA_HEADER_SIZE + pool->block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+
+        block->size = pool->block_size;
+    }
+
+    block->next = NULL;
+    block->used = 0;
+
+    return block;
+}
+
+// Hands blocks back to the pool until it holds retain bytes, frees the rest
+static void arena_pool_give(arena_pool* pool, arena_block* block) {
+    while (block != NULL) {
+        arena_block* next = block->next;
+
+        bool is_kept = false;
+        if (block->size == pool->block_size) {
+            mutex_lock(pool->lock);
+            is_kept = pool->spare_size + block->size <= pool->retain;
+            if (is_kept) {
+                block->next = pool->spare;
+                pool->spare = block;
+                pool->spare_size += block->size;
+            }
+            mutex_unlock(pool->lock);
+        }
+
+        if (!is_kept) {
+            free(block);
+        }
+
+        block = next;
+    }
+}
+
+static void arena_free_blocks(arena_block* block) {
+    while (block != NULL) {
+        arena_block* next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+static arena_block* arena_block_create(size_t size) {
+    arena_block* block = malloc(ARENA_HEADER_SIZE + size);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+}
+
+arena* arena_create(size_t block_size) {
+    arena* arena = malloc(sizeof(struct arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    arena->head = NULL;
+    arena->block_size = block_size != 0 ? block_size : ARENA_BLOCK_SIZE;
+    arena->pool = NULL;
+
+    return arena;
+}
+
+void arena_destroy(arena* arena) {
+    if (arena == NULL) {
+        return;
+    }
+
+    arena_reset(arena);
+    free(arena);
+}
+
+void arena_reset(arena* arena) {
+    if (arena == NULL) {
+        return;
+    }
+
+    if (arena->pool != NULL) {
+        arena_pool_give(arena->pool, arena->head);
+    } else {
+        arena_free_blocks(arena->head);
+    }
+
+    arena->head = NULL;
+}
+
+arena_pool* arena_pool_create(size_t block_size, size_t retain) {
+    arena_pool* pool = calloc(1, sizeof(arena_pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->lock = mutex_create();
+    if (pool->lock == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    pool->block_size = block_size != 0 ? block_size : ARENA_BLOCK_SIZE;
+    pool->retain = retain;
+
+    return pool;
+}
+
+void arena_pool_destroy(arena_pool* pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    arena_free_blocks(pool->spare);
+    mutex_destroy(pool->lock);
+    free(pool);
+}
+
+arena* arena_create_pooled(arena_pool* pool) {
+    arena* arena = arena_create(pool->block_size);
+    if (arena != NULL) {
+        arena->pool = pool;
+    }
+
+    return arena;
+}
+
+void* arena_alloc(arena* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    arena_block* block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        // Oversized allocations get a block of their own behind the current one,
+        // so the space left in the current block isn't wasted
+        if (block != NULL && size > arena->block_size / 4) {
+            arena_block* large = arena_block_create(size);
+            if (large == NULL) {
+                return NULL;
+            }
+
+            large->used = size;
+            large->next = block->next;
+            block->next = large;
+
+            return (uint8_t*)large + ARENA_HEADER_SIZE;
+        }
+
+        block = arena->pool != NULL && size <= arena->block_size
+            ? arena_pool_take(arena->pool)
+            : arena_block_create(size > arena->block_size ? size : arena->block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void* ptr = (uint8_t*)block + ARENA_HEADER_SIZE + block->used;
+    block->used += size;
+
+    return ptr;
+}
@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#ifndef ARENA_BLOCK_SIZE
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+#endif
+
+
+typedef struct arena_block arena_block;
+typedef struct arena_pool arena_pool;
+
+// Bump allocator for lots of small allocations that are all released together.
+// Individual allocations can't be freed.
+typedef struct arena {
+    arena_block* head;
+    size_t block_size;
+    arena_pool* pool; //< Where blocks come from and go back to, NULL for malloc and free
+} arena;
+
+arena* arena_create(size_t block_size);
+void arena_destroy(arena* arena);
+
+// Releases every allocation at once, the arena can be filled again afterwards
+void arena_reset(arena* arena);
+
+// Spare blocks shared by the arenas created from the pool, which may be used on different threads.
+// Blocks of reset or destroyed arenas are kept for the next ones up to retain bytes, so filling
+// arenas over and over doesn't keep going back to malloc and faulting in fresh pages.
+arena_pool* arena_pool_create(size_t block_size, size_t retain);
+// Every arena of the pool has to be destroyed first
+void arena_pool_destroy(arena_pool* pool);
+
+arena* arena_create_pooled(arena_pool* pool);
+
+// Returns memory aligned for any of the tool's types, or NULL if out of memory
+void* arena_alloc(arena* arena, size_t size);
+
+#endif // ARENA_H
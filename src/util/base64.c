@@ -0,0 +1,104 @@
+#include "base64.h"
+
+#define BASE64_INVALID_BITS 0xC0
+
+
+static const char s_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Maps characters back to their 6-bit value, anything outside the alphabet has the top bits set
+static const uint8_t s_values[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+size_t base64_encode(char* buffer, const uint8_t* data, size_t size) {
+    char* out = buffer;
+    size_t i = 0;
+
+    for (; i + 3 <= size; i += 3) {
+        const uint32_t group = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        out[0] = s_alphabet[(group >> 18) & 0x3F];
+        out[1] = s_alphabet[(group >> 12) & 0x3F];
+        out[2] = s_alphabet[(group >> 6) & 0x3F];
+        out[3] = s_alphabet[group & 0x3F];
+        out += 4;
+    }
+
+    const size_t remaining = size - i;
+    if (remaining != 0) {
+        const uint32_t group = ((uint32_t)data[i] << 16) | (remaining == 2 ? (uint32_t)data[i + 1] << 8 : 0);
+        out[0] = s_alphabet[(group >> 18) & 0x3F];
+        out[1] = s_alphabet[(group >> 12) & 0x3F];
+        out[2] = remaining == 2 ? s_alphabet[(group >> 6) & 0x3F] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+
+    *out = '\0';
+
+    return (size_t)(out - buffer);
+}
+
+bool base64_decode(uint8_t* buffer, size_t* size, const char* text, size_t length) {
+    // Padding only carries the length, which the number of remaining characters tells as well
+    while (length > 0 && text[length - 1] == '=') {
+        length--;
+    }
+
+    if (length % 4 == 1) {
+        return false;
+    }
+
+    uint8_t* out = buffer;
+    size_t i = 0;
+
+    for (; i + 4 <= length; i += 4) {
+        const uint8_t a = s_values[(uint8_t)text[i]];
+        const uint8_t b = s_values[(uint8_t)text[i + 1]];
+        const uint8_t c = s_values[(uint8_t)text[i + 2]];
+        const uint8_t d = s_values[(uint8_t)text[i + 3]];
+        if ((a | b | c | d) & BASE64_INVALID_BITS) {
+            return false;
+        }
+
+        const uint32_t group = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | d;
+        out[0] = (uint8_t)(group >> 16);
+        out[1] = (uint8_t)(group >> 8);
+        out[2] = (uint8_t)group;
+        out += 3;
+    }
+
+    const size_t remaining = length - i;
+    if (remaining != 0) {
+        const uint8_t a = s_values[(uint8_t)text[i]];
+        const uint8_t b = s_values[(uint8_t)text[i + 1]];
+        const uint8_t c = remaining == 3 ? s_values[(uint8_t)text[i + 2]] : 0;
+        if ((a | b | c) & BASE64_INVALID_BITS) {
+            return false;
+        }
+
+        const uint32_t group = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6);
+        *out++ = (uint8_t)(group >> 16);
+        if (remaining == 3) {
+            *out++ = (uint8_t)(group >> 8);
+        }
+    }
+
+    *size = (size_t)(out - buffer);
+
+    return true;
+}
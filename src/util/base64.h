@@ -0,0 +1,21 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Characters base64_encode writes for size bytes, excluding the null terminator
+#define BASE64_ENCODED_SIZE(size) (((size) + 2) / 3 * 4)
+// Upper bound of the bytes base64_decode produces for length characters
+#define BASE64_DECODED_MAX(length) ((length) / 4 * 3 + 3)
+
+// Encodes data with the standard alphabet and '=' padding. buffer must hold
+// BASE64_ENCODED_SIZE(size) + 1 characters and is null-terminated.
+size_t base64_encode(char* buffer, const uint8_t* data, size_t size);
+
+// Decodes padded or unpadded base64, buffer must hold BASE64_DECODED_MAX(length) bytes.
+// Returns false on characters outside the alphabet or a truncated final group.
+bool base64_decode(uint8_t* buffer, size_t* size, const char* text, size_t length);
+
+#endif // BASE64_H
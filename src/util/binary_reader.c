@@ -106,10 +106,14 @@ size_t binary_reader_seek(binary_reader* reader, int offset, int origin) {
 }
 
 size_t binary_reader_tell(binary_reader* reader) {
-    if (reader == NULL || reader->file == NULL) {
+    if (reader == NULL) {
         return (size_t)-1;
     }
 
+    if (reader->file == NULL) {
+        return reader->buffer_pos;
+    }
+
     return ftell(reader->file) - reader->buffer_size + reader->buffer_pos;
 }
 
@@ -124,7 +128,8 @@ int binary_reader_read(binary_reader* reader, void* data, size_t size) {
         return BINARY_READER_OK;
     }
 
-    const size_t remaining_size = reader->buffer_size - reader->buffer_pos;
+    // A seek can move past the end of an in-memory buffer
+    const size_t remaining_size = reader->buffer_pos < reader->buffer_size ? reader->buffer_size - reader->buffer_pos : 0;
     if (remaining_size > 0) {
         memcpy(data, reader->buffer + reader->buffer_pos, remaining_size);
         size -= remaining_size;
@@ -132,6 +137,10 @@ int binary_reader_read(binary_reader* reader, void* data, size_t size) {
         data = (char*)data + remaining_size;
     }
 
+    if (size > 0 && reader->file == NULL) {
+        return BINARY_READER_EOF;
+    }
+
     if (size > 0) {
         fread(data, 1, size, reader->file);
         if (ferror(reader->file)) {
@@ -223,9 +232,9 @@ static int binary_reader_refill_buffer(binary_reader* reader) {
         return BINARY_READER_ERROR;
     }
 
-    // file == NULL just means it reads from an in-memory buffer
+    // file == NULL just means it reads from an in-memory buffer, which has nothing left to refill from
     if (reader->file == NULL) {
-        return BINARY_READER_OK;
+        return BINARY_READER_EOF;
     }
 
     const size_t remaining_size = reader->buffer_size - reader->buffer_pos;
@@ -14,7 +14,8 @@
 static void binary_writer_flush(binary_writer* writer);
 
 binary_writer* binary_writer_create(const char* path) {
-    binary_writer* writer = malloc(sizeof(binary_writer));
+    // The buffer lives right behind the writer, one allocation for both
+    binary_writer* writer = malloc(sizeof(binary_writer) + BINARY_WRITER_BUFFER_SIZE);
     if (writer == NULL) {
         return NULL;
     }
@@ -25,15 +26,10 @@ binary_writer* binary_writer_create(const char* path) {
         return NULL;
     }
 
-    writer->buffer = malloc(BINARY_WRITER_BUFFER_SIZE);
-    if (writer->buffer == NULL) {
-        fclose(writer->file);
-        free(writer);
-        return NULL;
-    }
-
+    writer->buffer = (uint8_t*)(writer + 1);
     writer->buffer_size = BINARY_WRITER_BUFFER_SIZE;
     writer->buffer_pos = 0;
+    writer->error = false;
 
     return writer;
 }
@@ -52,23 +48,31 @@ binary_writer* binary_writer_create_buffer(uint8_t* buffer, size_t size) {
     writer->buffer = buffer;
     writer->buffer_size = size;
     writer->buffer_pos = 0;
+    writer->error = false;
 
     return writer;
 }
 
-void binary_writer_destroy(binary_writer* writer) {
+bool binary_writer_destroy(binary_writer* writer) {
     if (writer == NULL) {
-        return;
+        return false;
     }
 
     binary_writer_flush(writer);
 
+    // The stream's own error flag also covers data it failed to flush while seeking
+    bool result = !writer->error;
     if (writer->file != NULL) {
-        fclose(writer->file);
-        free(writer->buffer); // Free the buffer only if it was allocated by the writer
+        result = !ferror(writer->file) && fclose(writer->file) == 0 && result;
     }
 
     free(writer);
+
+    return result;
+}
+
+bool binary_writer_has_error(const binary_writer* writer) {
+    return writer == NULL || writer->error;
 }
 
 size_t binary_writer_tell(binary_writer* writer) {
@@ -111,6 +115,7 @@ size_t binary_writer_seek(binary_writer* writer, int offset, int origin) {
         return ftell(writer->file);
     }
 
+    writer->error = true;
     return (size_t)-1;
 }
 
@@ -124,7 +129,9 @@ void binary_writer_write(binary_writer* writer, const void* data, size_t size) {
         // but flush the buffer first. If the file is NULL, we can't write.
         if (writer->file != NULL) {
             binary_writer_flush(writer);
-            fwrite(data, 1, size, writer->file);
+            if (fwrite(data, 1, size, writer->file) != size) {
+                writer->error = true;
+            }
         }
 
         return;
@@ -215,7 +222,9 @@ void binary_writer_write_at(binary_writer* writer, size_t offset, const void* da
 
 void binary_writer_flush(binary_writer* writer) {
     if (writer->file != NULL && writer->buffer_pos > 0) {
-        fwrite(writer->buffer, 1, writer->buffer_pos, writer->file);
+        if (fwrite(writer->buffer, 1, writer->buffer_pos, writer->file) != writer->buffer_pos) {
+            writer->error = true;
+        }
         writer->buffer_pos = 0;
     }
 }
@@ -15,6 +15,7 @@ typedef struct binary_writer {
     uint8_t* buffer;
     size_t buffer_size;
     size_t buffer_pos;
+    bool error; //< Set once a write to the file fails, stays set
 } binary_writer;
 
 enum {
@@ -24,7 +25,11 @@ enum {
 
 binary_writer* binary_writer_create(const char* path);
 binary_writer* binary_writer_create_buffer(uint8_t* buffer, size_t size);
-void binary_writer_destroy(binary_writer* writer);
+// Flushes and closes the file. Returns false if any write to it failed along the way.
+bool binary_writer_destroy(binary_writer* writer);
+// Whether a write to the file has failed so far. Data is buffered, so a failed write may only
+// show up in a later call or in binary_writer_destroy.
+bool binary_writer_has_error(const binary_writer* writer);
 
 size_t binary_writer_tell(binary_writer* writer);
 size_t binary_writer_seek(binary_writer* writer, int offset, int origin);
@@ -0,0 +1,104 @@
+#include "file_map.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+file_map* file_map_create(const char* path) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    file_map* map = calloc(1, sizeof(file_map));
+    if (map == NULL) {
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        free(map);
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        free(map);
+        return NULL;
+    }
+
+    map->size = (size_t)size.QuadPart;
+    if (map->size != 0) {
+        // The view keeps the mapping and the mapping the file open, so the file handle can go
+        map->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        map->data = map->mapping != NULL ? (const uint8_t*)MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    }
+
+    CloseHandle(file);
+    if (map->size != 0 && map->data == NULL) {
+        file_map_destroy(map);
+        return NULL;
+    }
+#else
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        free(map);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        free(map);
+        return NULL;
+    }
+
+    map->size = (size_t)st.st_size;
+    if (map->size != 0) {
+        void* data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        map->data = data != MAP_FAILED ? (const uint8_t*)data : NULL;
+    }
+
+    // The mapping stays valid without the descriptor
+    close(fd);
+    if (map->size != 0 && map->data == NULL) {
+        free(map);
+        return NULL;
+    }
+#endif
+
+    return map;
+}
+
+void file_map_destroy(file_map* map) {
+    if (map == NULL) {
+        return;
+    }
+
+#if defined(_WIN32)
+    if (map->data != NULL) {
+        UnmapViewOfFile(map->data);
+    }
+
+    if (map->mapping != NULL) {
+        CloseHandle(map->mapping);
+    }
+#else
+    if (map->data != NULL) {
+        munmap((void*)map->data, map->size);
+    }
+#endif
+
+    free(map);
+}
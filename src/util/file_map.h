@@ -0,0 +1,23 @@
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Whole file mapped read-only into memory. Opening it takes a handful of system calls no matter
+// how large it is, and pages are only read from disk as they are touched. Lets several passes
+// over a file (detecting its format, then loading it) share a single open.
+typedef struct file_map {
+    const uint8_t* data; //< NULL for an empty file
+    size_t size;
+#if defined(_WIN32)
+    void* mapping;
+#endif
+} file_map;
+
+// Returns NULL if the file can't be opened or mapped
+file_map* file_map_create(const char* path);
+void file_map_destroy(file_map* map);
+
+#endif // FILE_MAP_H
@@ -0,0 +1,347 @@
+#include "file_reader.h"
+#include "file_stream.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(XFS2JSON_HAS_IO_URING)
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Kinds of submissions, kept in the low bits of their user data next to the request index
+#define FILE_READER_OP_STATX 0
+#define FILE_READER_OP_OPEN 1
+#define FILE_READER_OP_READ 2
+#define FILE_READER_OP_CLOSE 3
+#define FILE_READER_OP_BITS 2
+#define FILE_READER_OP_MASK ((1u << FILE_READER_OP_BITS) - 1)
+
+// Longest read Linux does in one go, larger files are read the plain way
+#define FILE_READER_MAX_READ 0x7FFFF000
+
+// State of a file in the batch being read
+typedef struct file_reader_entry {
+    struct statx stat;
+    int fd; //< -1 until opened
+    bool failed; //< Read again with file_read_into, which also reports what went wrong
+} file_reader_entry;
+#endif
+
+struct file_reader {
+    size_t batch_size;
+#if defined(XFS2JSON_HAS_IO_URING)
+    int ring; //< -1 if io_uring isn't available
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map; //< Same as sq_map if the kernel maps both rings at once
+    size_t cq_map_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    unsigned tail; //< Tail of the prepared submissions, handed to the kernel on submit
+    unsigned pending; //< Prepared submissions the kernel didn't take yet
+    file_reader_entry* entries; //< batch_size of them
+#endif
+};
+
+#if defined(XFS2JSON_HAS_IO_URING)
+static bool file_reader_setup(file_reader* reader, unsigned entries);
+static void file_reader_teardown(file_reader* reader);
+static void file_reader_read_ring(file_reader* reader, file_read_request* requests, size_t count);
+#endif
+
+file_reader* file_reader_create(size_t batch_size) {
+    file_reader* reader = (file_reader*)calloc(1, sizeof(file_reader));
+    if (reader == NULL) {
+        return NULL;
+    }
+
+    reader->batch_size = batch_size != 0 ? batch_size : 1;
+
+#if defined(XFS2JSON_HAS_IO_URING)
+    reader->ring = -1;
+    reader->entries = (file_reader_entry*)calloc(reader->batch_size, sizeof(file_reader_entry));
+
+    // Two submissions per file, sizing and opening it and later reading and closing it.
+    // Without a ring every file is read the plain way.
+    if (reader->entries != NULL && !file_reader_setup(reader, (unsigned)reader->batch_size * 2)) {
+        reader->ring = -1;
+    }
+#endif
+
+    return reader;
+}
+
+void file_reader_destroy(file_reader* reader) {
+    if (reader == NULL) {
+        return;
+    }
+
+#if defined(XFS2JSON_HAS_IO_URING)
+    file_reader_teardown(reader);
+    free(reader->entries);
+#endif
+
+    free(reader);
+}
+
+void file_reader_read(file_reader* reader, file_read_request* requests, size_t count) {
+#if defined(XFS2JSON_HAS_IO_URING)
+    if (reader != NULL && reader->ring >= 0) {
+        for (size_t i = 0; i < count; i += reader->batch_size) {
+            const size_t left = count - i;
+            file_reader_read_ring(reader, requests + i, left < reader->batch_size ? left : reader->batch_size);
+        }
+
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++) {
+        file_read_request* request = &requests[i];
+        request->result = file_read_into(request->path, request->buffer, request->capacity, request->size);
+    }
+}
+
+#if defined(XFS2JSON_HAS_IO_URING)
+bool file_reader_setup(file_reader* reader, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // Fails with ENOSYS on old kernels and EPERM where io_uring is disabled or filtered out
+    const int ring = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring < 0) {
+        return false;
+    }
+
+    // Opening, closing and statx came along with IORING_FEAT_RW_CUR_POS in Linux 5.6
+    if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+        close(ring);
+        return false;
+    }
+
+    reader->ring = ring;
+    reader->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    reader->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    reader->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    const bool is_single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (is_single_map) {
+        const size_t size = reader->sq_map_size > reader->cq_map_size ? reader->sq_map_size : reader->cq_map_size;
+        reader->sq_map_size = size;
+        reader->cq_map_size = size;
+    }
+
+    reader->sq_map = mmap(NULL, reader->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring, IORING_OFF_SQ_RING);
+    reader->cq_map = is_single_map
+        ? reader->sq_map
+        : mmap(NULL, reader->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring, IORING_OFF_CQ_RING);
+    reader->sqes = (struct io_uring_sqe*)mmap(NULL, reader->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring, IORING_OFF_SQES);
+
+    if (reader->sq_map == MAP_FAILED || reader->cq_map == MAP_FAILED || (void*)reader->sqes == MAP_FAILED) {
+        file_reader_teardown(reader);
+        return false;
+    }
+
+    uint8_t* const sq = (uint8_t*)reader->sq_map;
+    uint8_t* const cq = (uint8_t*)reader->cq_map;
+    reader->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    reader->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    reader->sq_array = (unsigned*)(sq + params.sq_off.array);
+    reader->cq_head = (unsigned*)(cq + params.cq_off.head);
+    reader->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    reader->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    reader->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    reader->tail = *reader->sq_tail;
+
+    return true;
+}
+
+void file_reader_teardown(file_reader* reader) {
+    if (reader->ring < 0) {
+        return;
+    }
+
+    if (reader->sqes != NULL && (void*)reader->sqes != MAP_FAILED) {
+        munmap(reader->sqes, reader->sqes_size);
+    }
+
+    if (reader->cq_map != NULL && reader->cq_map != MAP_FAILED && reader->cq_map != reader->sq_map) {
+        munmap(reader->cq_map, reader->cq_map_size);
+    }
+
+    if (reader->sq_map != NULL && reader->sq_map != MAP_FAILED) {
+        munmap(reader->sq_map, reader->sq_map_size);
+    }
+
+    close(reader->ring);
+    reader->ring = -1;
+}
+
+// Prepares the next submission, the kernel only sees it with the next file_reader_submit
+static struct io_uring_sqe* file_reader_prepare(file_reader* reader, uint8_t opcode, size_t index, uint64_t op) {
+    const unsigned slot = reader->tail & *reader->sq_mask;
+    struct io_uring_sqe* sqe = &reader->sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = ((uint64_t)index << FILE_READER_OP_BITS) | op;
+
+    reader->sq_array[slot] = slot;
+    reader->tail++;
+    reader->pending++;
+
+    return sqe;
+}
+
+// Submits everything prepared and waits until count completions are there to be taken.
+// Returns false if the kernel refused, the ring can't be used any further then.
+static bool file_reader_submit(file_reader* reader, unsigned count) {
+    __atomic_store_n(reader->sq_tail, reader->tail, __ATOMIC_RELEASE);
+
+    for (;;) {
+        const unsigned ready = __atomic_load_n(reader->cq_tail, __ATOMIC_ACQUIRE) - *reader->cq_head;
+        if (reader->pending == 0 && ready >= count) {
+            return true;
+        }
+
+        const unsigned wait = ready < count ? count - ready : 0;
+        const int submitted = (int)syscall(__NR_io_uring_enter, reader->ring, reader->pending, wait, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+
+            return false;
+        }
+
+        reader->pending -= (unsigned)submitted;
+    }
+}
+
+// Takes the oldest completion
+static void file_reader_complete(file_reader* reader, uint64_t* user_data, int* res) {
+    const unsigned head = *reader->cq_head;
+    const struct io_uring_cqe* cqe = &reader->cqes[head & *reader->cq_mask];
+    *user_data = cqe->user_data;
+    *res = cqe->res;
+
+    __atomic_store_n(reader->cq_head, head + 1, __ATOMIC_RELEASE);
+}
+
+void file_reader_read_ring(file_reader* reader, file_read_request* requests, size_t count) {
+    file_reader_entry* const entries = reader->entries;
+    unsigned submitted = 0;
+
+    // Sizes and opens every file of the batch at once
+    for (size_t i = 0; i < count; i++) {
+        file_reader_entry* entry = &entries[i];
+        entry->fd = -1;
+        entry->failed = false;
+
+        struct io_uring_sqe* sqe = file_reader_prepare(reader, IORING_OP_STATX, i, FILE_READER_OP_STATX);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t)(uintptr_t)requests[i].path;
+        sqe->len = STATX_SIZE;
+        sqe->off = (uint64_t)(uintptr_t)&entry->stat;
+
+        sqe = file_reader_prepare(reader, IORING_OP_OPENAT, i, FILE_READER_OP_OPEN);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t)(uintptr_t)requests[i].path;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        submitted += 2;
+    }
+
+    bool is_ring_ok = file_reader_submit(reader, submitted);
+    for (unsigned i = 0; is_ring_ok && i < submitted; i++) {
+        uint64_t user_data = 0;
+        int res = 0;
+        file_reader_complete(reader, &user_data, &res);
+
+        file_reader_entry* entry = &entries[user_data >> FILE_READER_OP_BITS];
+        if ((user_data & FILE_READER_OP_MASK) == FILE_READER_OP_OPEN && res >= 0) {
+            entry->fd = res;
+        } else if (res < 0) {
+            entry->failed = true;
+        }
+    }
+
+    // Reads every file that could be opened, each read is linked to closing the file again
+    submitted = 0;
+    for (size_t i = 0; is_ring_ok && i < count; i++) {
+        file_reader_entry* entry = &entries[i];
+        if (entry->fd < 0) {
+            entry->failed = true;
+            continue;
+        }
+
+        const file_read_request* request = &requests[i];
+        if (!entry->failed && entry->stat.stx_size <= FILE_READER_MAX_READ
+            && file_buffer_reserve(request->buffer, request->capacity, (size_t)entry->stat.stx_size)) {
+            struct io_uring_sqe* sqe = file_reader_prepare(reader, IORING_OP_READ, i, FILE_READER_OP_READ);
+            sqe->fd = entry->fd;
+            sqe->addr = (uint64_t)(uintptr_t)*request->buffer;
+            sqe->len = (uint32_t)entry->stat.stx_size;
+            sqe->off = 0;
+            sqe->flags = IOSQE_IO_LINK;
+            submitted++;
+        } else {
+            entry->failed = true;
+        }
+
+        struct io_uring_sqe* sqe = file_reader_prepare(reader, IORING_OP_CLOSE, i, FILE_READER_OP_CLOSE);
+        sqe->fd = entry->fd;
+        submitted++;
+    }
+
+    is_ring_ok = is_ring_ok && file_reader_submit(reader, submitted);
+    for (unsigned i = 0; is_ring_ok && i < submitted; i++) {
+        uint64_t user_data = 0;
+        int res = 0;
+        file_reader_complete(reader, &user_data, &res);
+
+        file_reader_entry* entry = &entries[user_data >> FILE_READER_OP_BITS];
+        if ((user_data & FILE_READER_OP_MASK) == FILE_READER_OP_CLOSE) {
+            // A short read breaks the link, so the close is cancelled and left to be done here
+            if (res == -ECANCELED) {
+                close(entry->fd);
+            }
+
+            entry->fd = -1;
+        } else if (res < 0 || (uint64_t)res != entry->stat.stx_size) {
+            // The file changed size since it was looked at, it's read again as it is now
+            entry->failed = true;
+        }
+    }
+
+    if (!is_ring_ok) {
+        // Submissions the kernel did take may still complete, so the ring is given up on for good
+        // and this batch and everything after it is read the plain way
+        for (size_t i = 0; i < count; i++) {
+            entries[i].failed = true;
+        }
+
+        file_reader_teardown(reader);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        file_read_request* request = &requests[i];
+        request->result = entries[i].failed
+            ? file_read_into(request->path, request->buffer, request->capacity, request->size)
+            : file_read_finish(request->path, request->buffer, request->capacity, request->size, (size_t)entries[i].stat.stx_size);
+    }
+}
+#endif
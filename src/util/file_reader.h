@@ -0,0 +1,29 @@
+#ifndef FILE_READER_H
+#define FILE_READER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// One whole file to read, with the same buffer handling as file_read_into
+typedef struct file_read_request {
+    const char* path;
+    char** buffer; //< Reused if large enough, stays owned by the caller
+    size_t* capacity;
+    size_t* size;
+    bool result; //< Set by file_reader_read
+} file_read_request;
+
+// Reads batches of whole files. On Linux builds with io_uring the files of a batch are sized and
+// opened with a single system call for all of them and read and closed with a second one, instead
+// of several blocking calls per file. Without io_uring, or where the kernel doesn't allow it, every
+// file is read with file_read_into. A reader is meant for one thread at a time.
+typedef struct file_reader file_reader;
+
+// batch_size is how many files one submission covers at most, larger requests are split up
+file_reader* file_reader_create(size_t batch_size);
+void file_reader_destroy(file_reader* reader);
+
+// Reads every request into its buffer, decompressing it if needed. A NULL reader reads them one by one.
+void file_reader_read(file_reader* reader, file_read_request* requests, size_t count);
+
+#endif // FILE_READER_H
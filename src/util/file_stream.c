@@ -0,0 +1,586 @@
+#include "file_stream.h"
+#include "thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(XFS2JSON_HAS_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(XFS2JSON_HAS_ZSTD)
+#include <zstd.h>
+#endif
+
+#define FILE_STREAM_GZIP_LEVEL 6
+#define FILE_STREAM_ZSTD_LEVEL 3
+#define FILE_STREAM_OUT_SIZE (256 * 1024)
+
+
+struct file_stream {
+    FILE* file;
+    file_compression compression;
+    bool failed;
+
+    // Ring of blocks, [head, head + count) are queued for the worker and fill is being written to
+    uint8_t* blocks[FILE_STREAM_BLOCK_COUNT];
+    size_t block_sizes[FILE_STREAM_BLOCK_COUNT];
+    size_t head;
+    size_t count;
+    size_t fill;
+    bool finished; //< No more blocks will be queued
+    bool worker_failed;
+    mutex* lock;
+    condition* changed;
+    thread* worker;
+
+    uint8_t* out;
+#if defined(XFS2JSON_HAS_ZLIB)
+    z_stream zstream;
+#endif
+#if defined(XFS2JSON_HAS_ZSTD)
+    ZSTD_CCtx* zstd;
+#endif
+};
+
+static void file_stream_destroy(file_stream* stream);
+
+static bool file_stream_ends_with(const char* str, const char* suffix) {
+    const size_t str_len = strlen(str);
+    const size_t suffix_len = strlen(suffix);
+    return str_len >= suffix_len && strcmp(str + str_len - suffix_len, suffix) == 0;
+}
+
+file_compression file_compression_from_path(const char* path) {
+    if (path == NULL) {
+        return FILE_COMPRESSION_NONE;
+    }
+
+    if (file_stream_ends_with(path, ".gz")) {
+        return FILE_COMPRESSION_GZIP;
+    }
+
+    if (file_stream_ends_with(path, ".zst")) {
+        return FILE_COMPRESSION_ZSTD;
+    }
+
+    return FILE_COMPRESSION_NONE;
+}
+
+const char* file_compression_extension(file_compression compression) {
+    switch (compression) {
+    case FILE_COMPRESSION_GZIP:
+        return ".gz";
+    case FILE_COMPRESSION_ZSTD:
+        return ".zst";
+    case FILE_COMPRESSION_NONE:
+    default:
+        return "";
+    }
+}
+
+bool file_compression_is_supported(file_compression compression) {
+    switch (compression) {
+    case FILE_COMPRESSION_NONE:
+        return true;
+    case FILE_COMPRESSION_GZIP:
+#if defined(XFS2JSON_HAS_ZLIB)
+        return true;
+#else
+        return false;
+#endif
+    case FILE_COMPRESSION_ZSTD:
+#if defined(XFS2JSON_HAS_ZSTD)
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+// Compresses data and writes the result, finish flushes everything the compressor still holds
+static bool file_stream_compress(file_stream* stream, const uint8_t* data, size_t size, bool finish) {
+    switch (stream->compression) {
+#if defined(XFS2JSON_HAS_ZLIB)
+    case FILE_COMPRESSION_GZIP: {
+        z_stream* const z = &stream->zstream;
+        z->next_in = (Bytef*)data;
+        z->avail_in = (uInt)size;
+
+        do {
+            z->next_out = stream->out;
+            z->avail_out = FILE_STREAM_OUT_SIZE;
+
+            if (deflate(z, finish ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR) {
+                return false;
+            }
+
+            const size_t produced = FILE_STREAM_OUT_SIZE - z->avail_out;
+            if (fwrite(stream->out, 1, produced, stream->file) != produced) {
+                return false;
+            }
+        } while (z->avail_out == 0);
+
+        return true;
+    }
+#endif
+#if defined(XFS2JSON_HAS_ZSTD)
+    case FILE_COMPRESSION_ZSTD: {
+        ZSTD_inBuffer in = { data, size, 0 };
+
+        for (;;) {
+            ZSTD_outBuffer out = { stream->out, FILE_STREAM_OUT_SIZE, 0 };
+            const size_t remaining = ZSTD_compressStream2(stream->zstd, &out, &in, finish ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError(remaining)) {
+                return false;
+            }
+
+            if (fwrite(stream->out, 1, out.pos, stream->file) != out.pos) {
+                return false;
+            }
+
+            if (finish ? remaining == 0 : in.pos == in.size) {
+                return true;
+            }
+        }
+    }
+#endif
+    default:
+        // Without any compression library, nothing above uses them
+        (void)data;
+        (void)size;
+        (void)finish;
+        return false;
+    }
+}
+
+static void file_stream_worker(void* arg) {
+    file_stream* const stream = (file_stream*)arg;
+    bool ok = true;
+
+    mutex_lock(stream->lock);
+
+    for (;;) {
+        while (stream->count == 0 && !stream->finished) {
+            condition_wait(stream->changed, stream->lock);
+        }
+
+        if (stream->count == 0) {
+            break;
+        }
+
+        const size_t slot = stream->head;
+        mutex_unlock(stream->lock);
+
+        // The producer never touches queued blocks, so this runs without the lock
+        ok = ok && file_stream_compress(stream, stream->blocks[slot], stream->block_sizes[slot], false);
+
+        mutex_lock(stream->lock);
+        stream->head = (stream->head + 1) % FILE_STREAM_BLOCK_COUNT;
+        stream->count--;
+        condition_broadcast(stream->changed);
+    }
+
+    mutex_unlock(stream->lock);
+
+    stream->worker_failed = !(ok && file_stream_compress(stream, NULL, 0, true));
+}
+
+static bool file_stream_init_compressor(file_stream* stream) {
+    switch (stream->compression) {
+#if defined(XFS2JSON_HAS_ZLIB)
+    case FILE_COMPRESSION_GZIP:
+        memset(&stream->zstream, 0, sizeof(z_stream));
+        // 16 added to the window bits selects the gzip container instead of zlib
+        return deflateInit2(&stream->zstream, FILE_STREAM_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+#endif
+#if defined(XFS2JSON_HAS_ZSTD)
+    case FILE_COMPRESSION_ZSTD:
+        stream->zstd = ZSTD_createCCtx();
+        return stream->zstd != NULL && !ZSTD_isError(ZSTD_CCtx_setParameter(stream->zstd, ZSTD_c_compressionLevel, FILE_STREAM_ZSTD_LEVEL));
+#endif
+    default:
+        return false;
+    }
+}
+
+file_stream* file_stream_create(const char* path, file_compression compression) {
+    if (!file_compression_is_supported(compression)) {
+        fprintf(stderr, "Compression for %s is not supported by this build\n", path);
+        return NULL;
+    }
+
+    file_stream* stream = calloc(1, sizeof(file_stream));
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    stream->compression = compression;
+    stream->file = fopen(path, "wb");
+    if (stream->file == NULL) {
+        fprintf(stderr, "Failed to open output file: %s\n", path);
+        free(stream);
+        return NULL;
+    }
+
+    if (compression == FILE_COMPRESSION_NONE) {
+        return stream;
+    }
+
+    for (int i = 0; i < FILE_STREAM_BLOCK_COUNT; i++) {
+        stream->blocks[i] = malloc(FILE_STREAM_BLOCK_SIZE);
+        if (stream->blocks[i] == NULL) {
+            file_stream_destroy(stream);
+            return NULL;
+        }
+    }
+
+    stream->out = malloc(FILE_STREAM_OUT_SIZE);
+    stream->lock = mutex_create();
+    stream->changed = condition_create();
+    if (stream->out == NULL || stream->lock == NULL || stream->changed == NULL || !file_stream_init_compressor(stream)) {
+        file_stream_destroy(stream);
+        return NULL;
+    }
+
+    stream->worker = thread_create(file_stream_worker, stream);
+    if (stream->worker == NULL) {
+        file_stream_destroy(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+// Hands the block being filled to the worker and waits for a free one
+static void file_stream_commit(file_stream* stream, size_t size, bool last) {
+    mutex_lock(stream->lock);
+
+    stream->block_sizes[stream->fill] = size;
+    stream->count++;
+    stream->finished = last;
+    condition_broadcast(stream->changed);
+
+    if (!last) {
+        while (stream->count == FILE_STREAM_BLOCK_COUNT) {
+            condition_wait(stream->changed, stream->lock);
+        }
+
+        stream->fill = (stream->head + stream->count) % FILE_STREAM_BLOCK_COUNT;
+        stream->block_sizes[stream->fill] = 0;
+    }
+
+    mutex_unlock(stream->lock);
+}
+
+void file_stream_write(file_stream* stream, const void* data, size_t size) {
+    if (stream == NULL || size == 0) {
+        return;
+    }
+
+    if (stream->compression == FILE_COMPRESSION_NONE) {
+        stream->failed |= fwrite(data, 1, size, stream->file) != size;
+        return;
+    }
+
+    const uint8_t* src = (const uint8_t*)data;
+    while (size > 0) {
+        // Only the producer changes the size of the block being filled
+        size_t* const used = &stream->block_sizes[stream->fill];
+        const size_t count = size < FILE_STREAM_BLOCK_SIZE - *used ? size : FILE_STREAM_BLOCK_SIZE - *used;
+
+        memcpy(stream->blocks[stream->fill] + *used, src, count);
+        *used += count;
+        src += count;
+        size -= count;
+
+        if (*used == FILE_STREAM_BLOCK_SIZE) {
+            file_stream_commit(stream, *used, false);
+        }
+    }
+}
+
+bool file_stream_close(file_stream* stream) {
+    if (stream == NULL) {
+        return false;
+    }
+
+    if (stream->worker != NULL) {
+        file_stream_commit(stream, stream->block_sizes[stream->fill], true);
+        thread_join(stream->worker);
+        stream->worker = NULL;
+        stream->failed |= stream->worker_failed;
+    }
+
+    const bool result = !stream->failed;
+    file_stream_destroy(stream);
+
+    return result;
+}
+
+void file_stream_destroy(file_stream* stream) {
+    if (stream->file != NULL && fclose(stream->file) != 0) {
+        stream->failed = true;
+    }
+
+#if defined(XFS2JSON_HAS_ZLIB)
+    if (stream->compression == FILE_COMPRESSION_GZIP) {
+        deflateEnd(&stream->zstream);
+    }
+#endif
+#if defined(XFS2JSON_HAS_ZSTD)
+    ZSTD_freeCCtx(stream->zstd);
+#endif
+
+    for (int i = 0; i < FILE_STREAM_BLOCK_COUNT; i++) {
+        free(stream->blocks[i]);
+    }
+
+    free(stream->out);
+    mutex_destroy(stream->lock);
+    condition_destroy(stream->changed);
+    free(stream);
+}
+
+#if defined(XFS2JSON_HAS_ZLIB) || defined(XFS2JSON_HAS_ZSTD)
+// Makes room for at least one more byte after size, keeping space for the terminator
+static bool file_read_grow(char** data, size_t* capacity, size_t size) {
+    if (size + 1 < *capacity) {
+        return true;
+    }
+
+    const size_t new_capacity = *capacity * 2;
+    char* new_data = realloc(*data, new_capacity);
+    if (new_data == NULL) {
+        return false;
+    }
+
+    *data = new_data;
+    *capacity = new_capacity;
+
+    return true;
+}
+#endif
+
+#if defined(XFS2JSON_HAS_ZLIB)
+static char* file_read_gzip(const uint8_t* src, size_t src_size, size_t* size) {
+    z_stream z;
+    memset(&z, 0, sizeof(z_stream));
+
+    // 32 added to the window bits detects gzip and zlib headers automatically
+    if (inflateInit2(&z, 15 + 32) != Z_OK) {
+        return NULL;
+    }
+
+    size_t capacity = src_size * 4 + 1024;
+    size_t length = 0;
+    char* data = malloc(capacity);
+    if (data == NULL) {
+        inflateEnd(&z);
+        return NULL;
+    }
+
+    z.next_in = (Bytef*)src;
+    z.avail_in = (uInt)src_size;
+
+    for (;;) {
+        if (!file_read_grow(&data, &capacity, length)) {
+            break;
+        }
+
+        z.next_out = (Bytef*)data + length;
+        z.avail_out = (uInt)(capacity - length - 1);
+
+        const int result = inflate(&z, Z_NO_FLUSH);
+        length = capacity - 1 - z.avail_out;
+
+        if (result == Z_STREAM_END) {
+            // Concatenated gzip members are valid too
+            if (z.avail_in == 0) {
+                inflateEnd(&z);
+                *size = length;
+                return data;
+            }
+
+            inflateReset(&z);
+        } else if (result != Z_OK && result != Z_BUF_ERROR) {
+            break;
+        } else if (result == Z_BUF_ERROR && z.avail_in == 0) {
+            break; // Truncated
+        }
+    }
+
+    inflateEnd(&z);
+    free(data);
+
+    return NULL;
+}
+#endif
+
+#if defined(XFS2JSON_HAS_ZSTD)
+static char* file_read_zstd(const uint8_t* src, size_t src_size, size_t* size) {
+    ZSTD_DCtx* const zstd = ZSTD_createDCtx();
+    if (zstd == NULL) {
+        return NULL;
+    }
+
+    const unsigned long long content_size = ZSTD_getFrameContentSize(src, src_size);
+    size_t capacity = content_size != ZSTD_CONTENTSIZE_UNKNOWN && content_size != ZSTD_CONTENTSIZE_ERROR
+        ? (size_t)content_size + 1
+        : src_size * 4 + 1024;
+
+    size_t length = 0;
+    char* data = malloc(capacity);
+    if (data == NULL) {
+        ZSTD_freeDCtx(zstd);
+        return NULL;
+    }
+
+    ZSTD_inBuffer in = { src, src_size, 0 };
+    size_t result = 0;
+
+    while (in.pos < in.size) {
+        if (!file_read_grow(&data, &capacity, length)) {
+            result = (size_t)-1;
+            break;
+        }
+
+        ZSTD_outBuffer out = { data, capacity - 1, length };
+        result = ZSTD_decompressStream(zstd, &out, &in);
+        length = out.pos;
+
+        if (ZSTD_isError(result)) {
+            break;
+        }
+    }
+
+    // Whatever the last frame still buffers once all input is consumed
+    while (!ZSTD_isError(result) && result != 0) {
+        if (!file_read_grow(&data, &capacity, length)) {
+            result = (size_t)-1;
+            break;
+        }
+
+        ZSTD_outBuffer out = { data, capacity - 1, length };
+        const size_t before = length;
+        result = ZSTD_decompressStream(zstd, &out, &in);
+        length = out.pos;
+
+        if (!ZSTD_isError(result) && result != 0 && length == before) {
+            result = (size_t)-1; // Truncated, no progress without more input
+        }
+    }
+
+    ZSTD_freeDCtx(zstd);
+
+    if (ZSTD_isError(result)) {
+        free(data);
+        return NULL;
+    }
+
+    *size = length;
+    return data;
+}
+#endif
+
+char* file_read_all(const char* path, size_t* size) {
+    char* data = NULL;
+    size_t capacity = 0;
+    if (!file_read_into(path, &data, &capacity, size)) {
+        free(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+bool file_read_into(const char* path, char** buffer, size_t* capacity, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open input file: %s\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const size_t file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (!file_buffer_reserve(buffer, capacity, file_size)) {
+        fclose(file);
+        return false;
+    }
+
+    const size_t data_size = fread(*buffer, 1, file_size, file);
+    fclose(file);
+
+    return file_read_finish(path, buffer, capacity, size, data_size);
+}
+
+bool file_buffer_reserve(char** buffer, size_t* capacity, size_t size) {
+    if (*buffer != NULL && *capacity >= size + 1) {
+        return true;
+    }
+
+    // The old contents don't matter, so there's nothing to copy over like realloc would
+    free(*buffer);
+    *buffer = malloc(size + 1);
+    *capacity = *buffer != NULL ? size + 1 : 0;
+    if (*buffer == NULL) {
+        fprintf(stderr, "Failed to allocate memory for input file data\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool file_read_finish(const char* path, char** buffer, size_t* capacity, size_t* size, size_t data_size) {
+    char* const data = *buffer;
+    const uint8_t* const magic = (const uint8_t*)data;
+    file_compression compression = FILE_COMPRESSION_NONE;
+    if (data_size >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) {
+        compression = FILE_COMPRESSION_GZIP;
+    } else if (data_size >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) {
+        compression = FILE_COMPRESSION_ZSTD;
+    }
+
+    if (compression == FILE_COMPRESSION_NONE) {
+        data[data_size] = '\0';
+        *size = data_size;
+        return true;
+    }
+
+    if (!file_compression_is_supported(compression)) {
+        fprintf(stderr, "%s is compressed, which is not supported by this build\n", path);
+        return false;
+    }
+
+    char* decompressed = NULL;
+    size_t decompressed_size = 0;
+#if defined(XFS2JSON_HAS_ZLIB)
+    if (compression == FILE_COMPRESSION_GZIP) {
+        decompressed = file_read_gzip((const uint8_t*)data, data_size, &decompressed_size);
+    }
+#endif
+#if defined(XFS2JSON_HAS_ZSTD)
+    if (compression == FILE_COMPRESSION_ZSTD) {
+        decompressed = file_read_zstd((const uint8_t*)data, data_size, &decompressed_size);
+    }
+#endif
+
+    if (decompressed == NULL) {
+        fprintf(stderr, "Failed to decompress input file: %s\n", path);
+        return false;
+    }
+
+    // The decompressed data takes the place of the buffer, which only held the compressed file
+    free(*buffer);
+    decompressed[decompressed_size] = '\0';
+    *buffer = decompressed;
+    *capacity = decompressed_size + 1;
+    *size = decompressed_size;
+
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef FILE_STREAM_H
+#define FILE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef FILE_STREAM_BLOCK_SIZE
+#define FILE_STREAM_BLOCK_SIZE (1024 * 1024)
+#endif
+
+// Blocks that can be queued for the compression thread before writes block
+#ifndef FILE_STREAM_BLOCK_COUNT
+#define FILE_STREAM_BLOCK_COUNT 4
+#endif
+
+
+typedef enum file_compression {
+    FILE_COMPRESSION_NONE,
+    FILE_COMPRESSION_GZIP,
+    FILE_COMPRESSION_ZSTD,
+} file_compression;
+
+// Picks the compression from the extension: .gz for gzip, .zst for zstd
+file_compression file_compression_from_path(const char* path);
+// The extension file_compression_from_path looks for, "" for FILE_COMPRESSION_NONE
+const char* file_compression_extension(file_compression compression);
+// Whether support for the compression was compiled in
+bool file_compression_is_supported(file_compression compression);
+
+typedef struct file_stream file_stream;
+
+// Sequential output file. With compression, written data is collected into blocks that a
+// background thread compresses and writes while the caller keeps producing the next ones.
+file_stream* file_stream_create(const char* path, file_compression compression);
+void file_stream_write(file_stream* stream, const void* data, size_t size);
+// Flushes everything, closes the file and frees the stream.
+// Returns false if any write (or the compression) failed along the way.
+bool file_stream_close(file_stream* stream);
+
+// Reads a whole file, decompressing it if it starts with a gzip or zstd header.
+// The returned buffer has one extra byte after size which is set to '\0'. Free it with free.
+char* file_read_all(const char* path, size_t* size);
+
+// Same as file_read_all, but reads into *buffer, which is only reallocated when its capacity is
+// too small, so the same buffer can be reused for many files. *buffer stays owned by the caller,
+// also on failure.
+bool file_read_into(const char* path, char** buffer, size_t* capacity, size_t* size);
+
+// The steps of file_read_into around the actual read, for reading files some other way.
+// file_buffer_reserve makes room for size bytes and the '\0' after them, file_read_finish takes
+// the data_size bytes read from path into *buffer and decompresses and terminates them.
+bool file_buffer_reserve(char** buffer, size_t* capacity, size_t size);
+bool file_read_finish(const char* path, char** buffer, size_t* capacity, size_t* size, size_t data_size);
+
+#endif // FILE_STREAM_H
@@ -0,0 +1,350 @@
+#include "fs.h"
+#include "file_map.h"
+#include "file_stream.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(MSC_VER)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+#endif
+
+
+bool util_fs_exists(const char* path) {
+#ifdef _WIN32
+    DWORD file_attr = GetFileAttributesA(path);
+    return file_attr != INVALID_FILE_ATTRIBUTES;
+#else
+    return access(path, F_OK) != -1;
+#endif
+}
+
+bool util_fs_is_dir(const char* path) {
+#ifdef _WIN32
+    DWORD file_attr = GetFileAttributesA(path);
+    return (file_attr != INVALID_FILE_ATTRIBUTES && (file_attr & FILE_ATTRIBUTE_DIRECTORY));
+#else
+    struct stat statbuf;
+    if (stat(path, &statbuf) != 0) {
+        return false;
+    }
+
+    return S_ISDIR(statbuf.st_mode);
+#endif
+}
+
+bool util_fs_get_info(const char* path, util_fs_info* info) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        return false;
+    }
+
+    // FILETIMEs count 100ns intervals since 1601
+    const uint64_t time = (uint64_t)data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime;
+    info->size = (uint64_t)data.nFileSizeHigh << 32 | data.nFileSizeLow;
+    info->mtime = ((int64_t)time - 116444736000000000ll) * 100;
+#else
+    struct stat statbuf;
+    if (stat(path, &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) {
+        return false;
+    }
+
+#if defined(__APPLE__)
+    const struct timespec mtime = statbuf.st_mtimespec;
+#else
+    const struct timespec mtime = statbuf.st_mtim;
+#endif
+    info->size = (uint64_t)statbuf.st_size;
+    info->mtime = (int64_t)mtime.tv_sec * 1000000000ll + mtime.tv_nsec;
+#endif
+
+    return true;
+}
+
+const char* util_fs_get_filename(const char* path) {
+    const char* filename = strrchr(path, '/');
+    if (filename == NULL) {
+        filename = strrchr(path, '\\');
+    }
+    return filename ? filename + 1 : (char*)path;
+}
+
+char* util_fs_get_dir(const char* path) {
+    const char* filename = util_fs_get_filename(path);
+    if (filename == path) {
+        return strdup(".");
+    }
+
+    const size_t length = (size_t)(filename - path - 1);
+    char* dir = malloc(length + 2);
+    if (dir == NULL) {
+        return NULL;
+    }
+
+    // Keep the separator for files in the root directory
+    const size_t copied = length != 0 ? length : 1;
+    memcpy(dir, path, copied);
+    dir[copied] = '\0';
+
+    return dir;
+}
+
+bool util_fs_make_dir(const char* path) {
+#ifdef _WIN32
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    return mkdir(path, 0755) == 0 || (errno == EEXIST && util_fs_is_dir(path));
+#endif
+}
+
+bool util_fs_copy_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return CopyFileA(from, to, FALSE) != 0;
+#else
+#if defined(__APPLE__)
+    // clonefile only creates new files
+    unlink(to);
+    if (clonefile(from, to, 0) == 0) {
+        return true;
+    }
+#endif
+
+    const int in = open(from, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+
+    const int out = open(to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    bool copied = false;
+#if defined(__linux__) && defined(FICLONE)
+    copied = ioctl(out, FICLONE, in) == 0;
+#endif
+
+    const size_t buffer_size = 1024 * 1024;
+    char* buffer = !copied ? malloc(buffer_size) : NULL;
+    if (buffer != NULL) {
+        copied = true;
+        for (;;) {
+            const ssize_t read_size = read(in, buffer, buffer_size);
+            if (read_size <= 0) {
+                copied = read_size == 0;
+                break;
+            }
+
+            for (ssize_t written = 0; copied && written < read_size;) {
+                const ssize_t result = write(out, buffer + written, (size_t)(read_size - written));
+                copied = result > 0;
+                written += result > 0 ? result : 0;
+            }
+
+            if (!copied) {
+                break;
+            }
+        }
+
+        free(buffer);
+    }
+
+    close(in);
+    return close(out) == 0 && copied;
+#endif
+}
+
+char* util_fs_temp_path(const char* path) {
+    // Threads of a process don't share a stack, so the address of a local tells them apart
+    int marker = 0;
+#ifdef _WIN32
+    const unsigned long pid = (unsigned long)_getpid();
+#else
+    const unsigned long pid = (unsigned long)getpid();
+#endif
+
+    const int length = snprintf(NULL, 0, "%s.%lx-%p.tmp", path, pid, (void*)&marker);
+    char* temp_path = malloc(length + 1);
+    if (temp_path == NULL) {
+        return NULL;
+    }
+
+    snprintf(temp_path, length + 1, "%s.%lx-%p.tmp", path, pid, (void*)&marker);
+
+    return temp_path;
+}
+
+bool util_fs_replace(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+bool util_fs_replace_if_changed(const char* from, const char* to) {
+    file_map* const old_map = file_map_create(to);
+    file_map* const new_map = old_map != NULL ? file_map_create(from) : NULL;
+    const bool unchanged = new_map != NULL && old_map->size == new_map->size
+        && (old_map->size == 0 || memcmp(old_map->data, new_map->data, old_map->size) == 0);
+
+    file_map_destroy(old_map);
+    file_map_destroy(new_map);
+
+    if (unchanged) {
+        remove(from);
+        return true;
+    }
+
+    return util_fs_replace(from, to);
+}
+
+bool util_fs_has_extension(const char* path, const char* extension) {
+    if (path == NULL || extension == NULL) {
+        return false;
+    }
+
+    const size_t path_len = strlen(path) - strlen(file_compression_extension(file_compression_from_path(path)));
+    const size_t extension_len = strlen(extension);
+
+    return path_len >= extension_len && strncmp(path + path_len - extension_len, extension, extension_len) == 0;
+}
+
+char* util_fs_join(const char* dir, const char* name) {
+    const int length = snprintf(NULL, 0, "%s/%s", dir, name);
+    char* path = malloc(length + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    snprintf(path, length + 1, "%s/%s", dir, name);
+
+    return path;
+}
+
+static int util_fs_compare_names(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static bool util_fs_push_name(char*** list, size_t* count, size_t* capacity, const char* name) {
+    if (*count == *capacity) {
+        const size_t new_capacity = *capacity != 0 ? *capacity * 2 : 64;
+        char** new_list = realloc(*list, new_capacity * sizeof(char*));
+        if (new_list == NULL) {
+            return false;
+        }
+
+        *list = new_list;
+        *capacity = new_capacity;
+    }
+
+    char* copy = strdup(name);
+    if (copy == NULL) {
+        return false;
+    }
+
+    (*list)[(*count)++] = copy;
+
+    return true;
+}
+
+char** util_fs_list_files(const char* dir, size_t* count) {
+    char** list = NULL;
+    size_t capacity = 0;
+    bool ok = true;
+
+    *count = 0;
+
+#ifdef _WIN32
+    char* pattern = util_fs_join(dir, "*");
+    if (pattern == NULL) {
+        return NULL;
+    }
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    free(pattern);
+    if (find == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            ok = util_fs_push_name(&list, count, &capacity, data.cFileName);
+        }
+    } while (ok && FindNextFileA(find, &data));
+
+    FindClose(find);
+#else
+    DIR* handle = opendir(dir);
+    if (handle == NULL) {
+        return NULL;
+    }
+
+    const struct dirent* entry;
+    while (ok && (entry = readdir(handle)) != NULL) {
+        char* path = util_fs_join(dir, entry->d_name);
+        if (path == NULL) {
+            ok = false;
+            break;
+        }
+
+        struct stat statbuf;
+        if (stat(path, &statbuf) == 0 && S_ISREG(statbuf.st_mode)) {
+            ok = util_fs_push_name(&list, count, &capacity, entry->d_name);
+        }
+
+        free(path);
+    }
+
+    closedir(handle);
+#endif
+
+    if (!ok) {
+        util_fs_free_list(list, *count);
+        *count = 0;
+        return NULL;
+    }
+
+    if (list == NULL) {
+        // Empty directories still get a list so they aren't mistaken for errors
+        list = malloc(sizeof(char*));
+        if (list == NULL) {
+            return NULL;
+        }
+    }
+
+    qsort(list, *count, sizeof(char*), util_fs_compare_names);
+
+    return list;
+}
+
+void util_fs_free_list(char** list, size_t count) {
+    if (list == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(list[i]);
+    }
+
+    free(list);
+}
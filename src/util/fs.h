@@ -0,0 +1,51 @@
+#ifndef FS_H
+#define FS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+typedef struct util_fs_info {
+    uint64_t size;
+    int64_t mtime; //< Last modification in nanoseconds since the Unix epoch, as precise as the file system keeps it
+} util_fs_info;
+
+bool util_fs_exists(const char* path);
+bool util_fs_is_dir(const char* path);
+// Size and modification time of a regular file, false if it doesn't exist or isn't one
+bool util_fs_get_info(const char* path, util_fs_info* info);
+const char* util_fs_get_filename(const char* path);
+// Directory part of path, "." if there is none. Free the result with free.
+char* util_fs_get_dir(const char* path);
+
+// Creates a directory, succeeds if it exists already
+bool util_fs_make_dir(const char* path);
+
+// Copies a regular file, replacing to if it exists. Where the file system supports it (Btrfs, XFS
+// and APFS), the copy is a reflink that shares the blocks of from until either is changed.
+bool util_fs_copy_file(const char* from, const char* to);
+
+// Path next to path that a file can be written to before replacing path with it, unique among
+// the threads and processes doing the same. Free the result with free.
+char* util_fs_temp_path(const char* path);
+
+// Moves from over to, replacing to if it exists. Readers see either the old or the new file.
+bool util_fs_replace(const char* from, const char* to);
+
+// Same as util_fs_replace, unless to already holds exactly what from holds. Then from is removed
+// and to is left alone, keeping its modification time.
+bool util_fs_replace_if_changed(const char* from, const char* to);
+
+// Checks the extension in front of a .gz or .zst extension if there is one
+bool util_fs_has_extension(const char* path, const char* extension);
+
+// Joins dir and name with a '/', free the result with free
+char* util_fs_join(const char* dir, const char* name);
+
+// Names of the regular files directly inside dir, sorted. Free the list with util_fs_free_list.
+// Returns NULL if the directory can't be read.
+char** util_fs_list_files(const char* dir, size_t* count);
+void util_fs_free_list(char** list, size_t count);
+
+#endif // FS_H
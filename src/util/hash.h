@@ -0,0 +1,18 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Starting value for hash_fnv1a
+#define HASH_FNV_OFFSET_BASIS 0xCBF29CE484222325ull
+
+
+// 64-bit FNV-1a of data, continuing from hash. Not meant to resist deliberate collisions.
+uint64_t hash_fnv1a(uint64_t hash, const void* data, size_t size);
+
+// Hash a value byte by byte, least significant first, so the result doesn't depend on endianness
+uint64_t hash_fnv1a_u32(uint64_t hash, uint32_t value);
+uint64_t hash_fnv1a_u64(uint64_t hash, uint64_t value);
+
+#endif // HASH_H
@@ -0,0 +1,458 @@
+#include "json_reader.h"
+#include "number_parse.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSON_READER_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Same limit cJSON uses, to avoid running out of stack on malicious input
+#define JSON_READER_NESTING_LIMIT 1000
+
+
+typedef struct json_reader {
+    const char* cur;
+    const char* end;
+    int depth;
+} json_reader;
+
+static cJSON* json_reader_parse_value(json_reader* r);
+
+static cJSON* json_reader_new_item(int type) {
+    cJSON* item = cJSON_malloc(sizeof(cJSON));
+    if (item == NULL) {
+        return NULL;
+    }
+
+    memset(item, 0, sizeof(cJSON));
+    item->type = type;
+
+    return item;
+}
+
+static bool json_reader_is_whitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+#if defined(JSON_READER_SSE2)
+
+static int json_reader_ctz(uint32_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (int)index;
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+// Pretty-printed files are mostly indentation, so whitespace runs are skipped 16 bytes at a time
+static const char* json_reader_find_non_whitespace(const char* p, const char* end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)p);
+        const __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, carriage_return), _mm_cmpeq_epi8(v, tab))
+        );
+
+        const uint32_t mask = ~(uint32_t)_mm_movemask_epi8(ws) & 0xFFFF;
+        if (mask != 0) {
+            return p + json_reader_ctz(mask);
+        }
+
+        p += 16;
+    }
+
+    while (p < end && json_reader_is_whitespace(*p)) {
+        p++;
+    }
+
+    return p;
+}
+
+// Finds the next quote or backslash, everything else in a string is copied verbatim
+static const char* json_reader_find_string_special(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)p);
+        const uint32_t mask = (uint32_t)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash))
+        );
+
+        if (mask != 0) {
+            return p + json_reader_ctz(mask);
+        }
+
+        p += 16;
+    }
+
+    while (p < end && *p != '"' && *p != '\\') {
+        p++;
+    }
+
+    return p;
+}
+
+#else
+
+static const char* json_reader_find_non_whitespace(const char* p, const char* end) {
+    while (p < end && json_reader_is_whitespace(*p)) {
+        p++;
+    }
+
+    return p;
+}
+
+static const char* json_reader_find_string_special(const char* p, const char* end) {
+    while (p < end && *p != '"' && *p != '\\') {
+        p++;
+    }
+
+    return p;
+}
+
+#endif
+
+static void json_reader_skip_whitespace(json_reader* r) {
+    // Single spaces (after ':') and tokens without any whitespace in between are the common case
+    if (r->cur < r->end && !json_reader_is_whitespace(*r->cur)) {
+        return;
+    }
+
+    if (r->cur + 1 < r->end && !json_reader_is_whitespace(r->cur[1])) {
+        r->cur++;
+        return;
+    }
+
+    r->cur = json_reader_find_non_whitespace(r->cur, r->end);
+}
+
+static int json_reader_hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static bool json_reader_parse_hex4(const char* str, const char* end, uint32_t* value) {
+    if (end - str < 4) {
+        return false;
+    }
+
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        const int digit = json_reader_hex_digit(str[i]);
+        if (digit < 0) {
+            return false;
+        }
+
+        *value = (*value << 4) | (uint32_t)digit;
+    }
+
+    return true;
+}
+
+static char* json_reader_write_utf8(char* out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        *out++ = (char)codepoint;
+    } else if (codepoint < 0x800) {
+        *out++ = (char)(0xC0 | (codepoint >> 6));
+        *out++ = (char)(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        *out++ = (char)(0xE0 | (codepoint >> 12));
+        *out++ = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (codepoint & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (codepoint >> 18));
+        *out++ = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (codepoint & 0x3F));
+    }
+
+    return out;
+}
+
+// Parses the string starting at the opening quote. The string is unescaped in place (which
+// never makes it longer) and null-terminated where the closing quote was, so no copy is made.
+static char* json_reader_parse_string(json_reader* r) {
+    if (r->cur >= r->end || *r->cur != '"') {
+        return NULL;
+    }
+
+    // json_reader_parse takes a mutable buffer, this is where it gets written to
+    char* str = (char*)++r->cur;
+    char* out = str;
+    const char* p = str;
+
+    for (;;) {
+        const char* special = json_reader_find_string_special(p, r->end);
+        if (out != p) {
+            memmove(out, p, (size_t)(special - p));
+        }
+        out += special - p;
+        p = special;
+
+        if (p >= r->end) {
+            return NULL;
+        }
+
+        if (*p == '"') {
+            break;
+        }
+
+        if (++p >= r->end) {
+            return NULL;
+        }
+
+        switch (*p++) {
+        case '"': *out++ = '"'; break;
+        case '\\': *out++ = '\\'; break;
+        case '/': *out++ = '/'; break;
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u': {
+            uint32_t codepoint;
+            if (!json_reader_parse_hex4(p, r->end, &codepoint)) {
+                return NULL;
+            }
+            p += 4;
+
+            // Combine UTF-16 surrogate pairs
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                uint32_t low;
+                if (r->end - p < 6 || p[0] != '\\' || p[1] != 'u' || !json_reader_parse_hex4(p + 2, r->end, &low)
+                    || low < 0xDC00 || low > 0xDFFF) {
+                    return NULL;
+                }
+
+                codepoint = 0x10000 + (((codepoint & 0x3FF) << 10) | (low & 0x3FF));
+                p += 6;
+            }
+
+            // At most 4 bytes of UTF-8 for at least 6 bytes of escape sequence
+            out = json_reader_write_utf8(out, codepoint);
+            break;
+        }
+        default:
+            return NULL;
+        }
+    }
+
+    *out = '\0';
+    r->cur = p + 1;
+
+    return str;
+}
+
+static cJSON* json_reader_parse_number(json_reader* r) {
+    cJSON* item = json_reader_new_item(cJSON_Number | cJSON_IsReference);
+    if (item == NULL) {
+        return NULL;
+    }
+
+    const char* end = number_parse_f64(r->cur, &item->valuedouble);
+    if (end == NULL || end > r->end) {
+        cJSON_free(item);
+        return NULL;
+    }
+
+    if (item->valuedouble >= INT32_MAX) {
+        item->valueint = INT32_MAX;
+    } else if (item->valuedouble <= (double)INT32_MIN) {
+        item->valueint = INT32_MIN;
+    } else {
+        item->valueint = (int)item->valuedouble;
+    }
+
+    // Keep the literal around for exact integer conversions later on
+    item->valuestring = (char*)r->cur;
+    r->cur = end;
+
+    return item;
+}
+
+static bool json_reader_match(json_reader* r, const char* literal, size_t length) {
+    if ((size_t)(r->end - r->cur) < length || memcmp(r->cur, literal, length) != 0) {
+        return false;
+    }
+
+    r->cur += length;
+    return true;
+}
+
+// Parses an array or object, the opening bracket has already been consumed
+static cJSON* json_reader_parse_container(json_reader* r, bool is_object) {
+    const char closing = is_object ? '}' : ']';
+
+    if (++r->depth > JSON_READER_NESTING_LIMIT) {
+        return NULL;
+    }
+
+    cJSON* container = json_reader_new_item(is_object ? cJSON_Object : cJSON_Array);
+    if (container == NULL) {
+        return NULL;
+    }
+
+    json_reader_skip_whitespace(r);
+    if (r->cur < r->end && *r->cur == closing) {
+        r->cur++;
+        r->depth--;
+        return container;
+    }
+
+    cJSON* last = NULL;
+    for (;;) {
+        char* key = NULL;
+
+        json_reader_skip_whitespace(r);
+        if (is_object) {
+            key = json_reader_parse_string(r);
+            if (key == NULL) {
+                cJSON_Delete(container);
+                return NULL;
+            }
+
+            json_reader_skip_whitespace(r);
+            if (r->cur >= r->end || *r->cur != ':') {
+                cJSON_Delete(container);
+                return NULL;
+            }
+            r->cur++;
+        }
+
+        cJSON* item = json_reader_parse_value(r);
+        if (item == NULL) {
+            cJSON_Delete(container);
+            return NULL;
+        }
+
+        if (key != NULL) {
+            item->string = key;
+            item->type |= cJSON_StringIsConst;
+        }
+
+        // Same linkage cJSON uses: child->prev points at the last element
+        if (last == NULL) {
+            container->child = item;
+        } else {
+            last->next = item;
+            item->prev = last;
+        }
+        last = item;
+        container->child->prev = last;
+
+        json_reader_skip_whitespace(r);
+        if (r->cur >= r->end) {
+            cJSON_Delete(container);
+            return NULL;
+        }
+
+        if (*r->cur == ',') {
+            r->cur++;
+            continue;
+        }
+
+        if (*r->cur == closing) {
+            r->cur++;
+            break;
+        }
+
+        cJSON_Delete(container);
+        return NULL;
+    }
+
+    r->depth--;
+
+    return container;
+}
+
+static cJSON* json_reader_parse_value(json_reader* r) {
+    cJSON* item = NULL;
+
+    json_reader_skip_whitespace(r);
+    if (r->cur >= r->end) {
+        return NULL;
+    }
+
+    switch (*r->cur) {
+    case '{':
+    case '[':
+        r->cur++;
+        return json_reader_parse_container(r, r->cur[-1] == '{');
+    case '"':
+        item = json_reader_new_item(cJSON_String | cJSON_IsReference);
+        if (item == NULL) {
+            return NULL;
+        }
+
+        item->valuestring = json_reader_parse_string(r);
+        if (item->valuestring == NULL) {
+            cJSON_free(item);
+            return NULL;
+        }
+        return item;
+    case 't':
+        return json_reader_match(r, "true", 4) ? json_reader_new_item(cJSON_True) : NULL;
+    case 'f':
+        return json_reader_match(r, "false", 5) ? json_reader_new_item(cJSON_False) : NULL;
+    case 'n':
+        return json_reader_match(r, "null", 4) ? json_reader_new_item(cJSON_NULL) : NULL;
+    default:
+        return json_reader_parse_number(r);
+    }
+}
+
+cJSON* json_reader_parse(char* buffer, size_t size) {
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    json_reader reader = {
+        .cur = buffer,
+        .end = buffer + size,
+        .depth = 0,
+    };
+
+    // Skip a UTF-8 BOM, some editors like to add one
+    if (size >= 3 && memcmp(buffer, "\xEF\xBB\xBF", 3) == 0) {
+        reader.cur += 3;
+    }
+
+    cJSON* root = json_reader_parse_value(&reader);
+    if (root == NULL) {
+        return NULL;
+    }
+
+    json_reader_skip_whitespace(&reader);
+    if (reader.cur != reader.end) {
+        cJSON_Delete(root);
+        return NULL;
+    }
+
+    return root;
+}
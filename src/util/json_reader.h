@@ -0,0 +1,15 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stddef.h>
+#include <cJSON.h>
+
+// Parses a JSON document into a regular cJSON tree, which is freed with cJSON_Delete.
+// Numbers are converted with util/number_parse instead of cJSON's strtod, and every number
+// item keeps a reference to its source literal in valuestring (flagged cJSON_IsReference)
+// so integers wider than 53 bits can be read back exactly.
+// Strings and keys are decoded in place and referenced instead of copied, so the buffer is
+// modified, must be null-terminated and must outlive the returned tree.
+cJSON* json_reader_parse(char* buffer, size_t size);
+
+#endif // JSON_READER_H
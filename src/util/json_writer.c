@@ -0,0 +1,650 @@
+#include "json_writer.h"
+#include "file_map.h"
+#include "file_stream.h"
+#include "fs.h"
+#include "number_format.h"
+#include "thread.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+// Containers with fewer members are always printed by whoever reaches them
+#define JSON_WRITER_SPLIT_THRESHOLD 256
+// Lower bound of members per task, so the per-task overhead stays small
+#define JSON_WRITER_TASK_MIN_MEMBERS 64
+// Tasks per thread, more tasks balance uneven members better
+#define JSON_WRITER_TASKS_PER_THREAD 4
+
+#if !defined(_WIN32) && !defined(IOV_MAX)
+#define IOV_MAX 1024
+#endif
+
+
+typedef struct json_buffer {
+    char* data;
+    size_t size;
+    size_t capacity;
+    bool failed;
+} json_buffer;
+
+// Members [first, first + count) of a container, printed into output on a worker thread
+typedef struct json_task {
+    const cJSON* first;
+    size_t count;
+    size_t index; //< Index of first within the container
+    int depth;
+    bool is_object;
+    json_buffer* output;
+} json_task;
+
+struct json_writer_buffers {
+    json_buffer** spare;
+    size_t spare_count;
+    size_t spare_capacity;
+    size_t retain;
+};
+
+typedef struct json_writer {
+    int indent;
+    int thread_count;
+    json_buffer* current;
+
+    // Only used by the top-level writer, the document is the concatenation of all chunks
+    bool can_split;
+    json_buffer** chunks;
+    size_t chunk_count;
+    size_t chunk_capacity;
+    json_task* tasks;
+    size_t task_count;
+    size_t task_capacity;
+    bool failed;
+
+    // Compressed output, printed data is handed over while the walk is still sequential
+    file_stream* stream;
+
+    json_writer_buffers* buffers; //< Chunks are taken from and given back to these if set
+} json_writer;
+
+typedef struct json_worker {
+    const json_writer* writer;
+    size_t first_task;
+    size_t task_stride;
+} json_worker;
+
+static void json_writer_print_value(json_writer* w, const cJSON* item, int depth);
+
+static bool json_buffer_reserve(json_buffer* b, size_t size) {
+    if (b->size + size <= b->capacity) {
+        return true;
+    }
+
+    size_t capacity = b->capacity != 0 ? b->capacity * 2 : 4096;
+    while (capacity < b->size + size) {
+        capacity *= 2;
+    }
+
+    char* data = realloc(b->data, capacity);
+    if (data == NULL) {
+        b->failed = true;
+        return false;
+    }
+
+    b->data = data;
+    b->capacity = capacity;
+
+    return true;
+}
+
+static void json_buffer_append(json_buffer* b, const char* data, size_t size) {
+    if (!json_buffer_reserve(b, size)) {
+        return;
+    }
+
+    memcpy(b->data + b->size, data, size);
+    b->size += size;
+}
+
+static void json_buffer_append_char(json_buffer* b, char c) {
+    if (b->size < b->capacity || json_buffer_reserve(b, 1)) {
+        b->data[b->size++] = c;
+    }
+}
+
+static json_buffer* json_writer_push_chunk(json_writer* w) {
+    if (w->chunk_count == w->chunk_capacity) {
+        const size_t capacity = w->chunk_capacity != 0 ? w->chunk_capacity * 2 : 16;
+        json_buffer** chunks = realloc(w->chunks, capacity * sizeof(json_buffer*));
+        if (chunks == NULL) {
+            w->failed = true;
+            return NULL;
+        }
+
+        w->chunks = chunks;
+        w->chunk_capacity = capacity;
+    }
+
+    json_buffer* chunk = w->buffers != NULL && w->buffers->spare_count != 0
+        ? w->buffers->spare[--w->buffers->spare_count]
+        : calloc(1, sizeof(json_buffer));
+    if (chunk == NULL) {
+        w->failed = true;
+        return NULL;
+    }
+
+    w->chunks[w->chunk_count++] = chunk;
+
+    return chunk;
+}
+
+// Hands a printed chunk back to the buffers, or frees it if they are full or there are none
+static void json_writer_release_chunk(json_writer_buffers* buffers, json_buffer* chunk, size_t* retained) {
+    if (buffers != NULL && *retained + chunk->capacity <= buffers->retain && !chunk->failed) {
+        if (buffers->spare_count == buffers->spare_capacity) {
+            const size_t capacity = buffers->spare_capacity != 0 ? buffers->spare_capacity * 2 : 16;
+            json_buffer** spare = realloc(buffers->spare, capacity * sizeof(json_buffer*));
+            if (spare != NULL) {
+                buffers->spare = spare;
+                buffers->spare_capacity = capacity;
+            }
+        }
+
+        if (buffers->spare_count < buffers->spare_capacity) {
+            *retained += chunk->capacity;
+            chunk->size = 0;
+            buffers->spare[buffers->spare_count++] = chunk;
+            return;
+        }
+    }
+
+    free(chunk->data);
+    free(chunk);
+}
+
+json_writer_buffers* json_writer_buffers_create(size_t retain) {
+    json_writer_buffers* buffers = calloc(1, sizeof(json_writer_buffers));
+    if (buffers != NULL) {
+        buffers->retain = retain;
+    }
+
+    return buffers;
+}
+
+void json_writer_buffers_destroy(json_writer_buffers* buffers) {
+    if (buffers == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < buffers->spare_count; i++) {
+        free(buffers->spare[i]->data);
+        free(buffers->spare[i]);
+    }
+
+    free(buffers->spare);
+    free(buffers);
+}
+
+static bool json_writer_push_task(json_writer* w, const json_task* task) {
+    if (w->task_count == w->task_capacity) {
+        const size_t capacity = w->task_capacity != 0 ? w->task_capacity * 2 : 16;
+        json_task* tasks = realloc(w->tasks, capacity * sizeof(json_task));
+        if (tasks == NULL) {
+            w->failed = true;
+            return false;
+        }
+
+        w->tasks = tasks;
+        w->task_capacity = capacity;
+    }
+
+    w->tasks[w->task_count++] = *task;
+
+    return true;
+}
+
+static void json_writer_newline(json_writer* w, int depth) {
+    static const char spaces[] = "                                                                ";
+
+    if (w->indent == 0) {
+        return;
+    }
+
+    json_buffer_append_char(w->current, '\n');
+
+    size_t remaining = (size_t)depth * (size_t)w->indent;
+    while (remaining > 0) {
+        const size_t count = remaining < sizeof(spaces) - 1 ? remaining : sizeof(spaces) - 1;
+        json_buffer_append(w->current, spaces, count);
+        remaining -= count;
+    }
+}
+
+static void json_writer_print_string(json_writer* w, const char* str) {
+    static const char hex[] = "0123456789abcdef";
+    json_buffer* const b = w->current;
+    const char* run = str;
+
+    json_buffer_append_char(b, '"');
+
+    for (const char* p = str; *p != '\0'; p++) {
+        const unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        json_buffer_append(b, run, (size_t)(p - run));
+        run = p + 1;
+
+        switch (c) {
+        case '"': json_buffer_append(b, "\\\"", 2); break;
+        case '\\': json_buffer_append(b, "\\\\", 2); break;
+        case '\b': json_buffer_append(b, "\\b", 2); break;
+        case '\f': json_buffer_append(b, "\\f", 2); break;
+        case '\n': json_buffer_append(b, "\\n", 2); break;
+        case '\r': json_buffer_append(b, "\\r", 2); break;
+        case '\t': json_buffer_append(b, "\\t", 2); break;
+        default: {
+            const char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+            json_buffer_append(b, escape, sizeof(escape));
+            break;
+        }
+        }
+    }
+
+    json_buffer_append(b, run, strlen(run));
+    json_buffer_append_char(b, '"');
+}
+
+static void json_writer_print_number(json_writer* w, double value) {
+    char buffer[NUMBER_FORMAT_F64_MAX];
+    size_t length;
+
+    if (value == floor(value) && fabs(value) < 9007199254740992.0) {
+        length = (size_t)snprintf(buffer, sizeof(buffer), "%" PRId64, (int64_t)value);
+    } else {
+        length = number_format_f64(buffer, value);
+    }
+
+    if (length == 0) {
+        json_buffer_append(w->current, "null", 4);
+    } else {
+        json_buffer_append(w->current, buffer, length);
+    }
+}
+
+// While nothing has been split off, the only chunk is a prefix of the document and can go to
+// the compression thread as soon as a block worth of it is printed
+static void json_writer_stream_flush(json_writer* w) {
+    if (w->stream == NULL || w->chunk_count != 1 || w->current->size < FILE_STREAM_BLOCK_SIZE) {
+        return;
+    }
+
+    file_stream_write(w->stream, w->current->data, w->current->size);
+    w->current->size = 0;
+}
+
+// Prints count members starting at first, index is the position of first in its container
+static void json_writer_print_members(json_writer* w, const cJSON* first, size_t count, size_t index, int depth, bool is_object) {
+    const cJSON* item = first;
+
+    for (size_t i = 0; i < count && item != NULL; i++, item = item->next) {
+        if (index + i != 0) {
+            json_buffer_append_char(w->current, ',');
+        }
+
+        json_writer_newline(w, depth);
+
+        if (is_object) {
+            json_writer_print_string(w, item->string != NULL ? item->string : "");
+            json_buffer_append(w->current, ": ", w->indent != 0 ? 2 : 1);
+        }
+
+        json_writer_print_value(w, item, depth);
+        json_writer_stream_flush(w);
+    }
+}
+
+// Hands the members of a large container to worker threads, each range gets its own chunk
+static bool json_writer_split(json_writer* w, const cJSON* first, size_t count, int depth, bool is_object) {
+    size_t task_count = count / JSON_WRITER_TASK_MIN_MEMBERS;
+    const size_t max_tasks = (size_t)w->thread_count * JSON_WRITER_TASKS_PER_THREAD;
+    if (task_count > max_tasks) {
+        task_count = max_tasks;
+    }
+
+    if (task_count < 2) {
+        return false;
+    }
+
+    const cJSON* item = first;
+    size_t index = 0;
+    for (size_t i = 0; i < task_count; i++) {
+        const size_t members = count / task_count + (i < count % task_count ? 1 : 0);
+
+        json_task task = {
+            .first = item,
+            .count = members,
+            .index = index,
+            .depth = depth,
+            .is_object = is_object,
+            .output = json_writer_push_chunk(w),
+        };
+
+        if (task.output == NULL || !json_writer_push_task(w, &task)) {
+            return true;
+        }
+
+        for (size_t j = 0; j < members; j++) {
+            item = item->next;
+        }
+        index += members;
+    }
+
+    // Whatever follows the container goes into a new chunk after the tasks
+    w->current = json_writer_push_chunk(w);
+
+    return true;
+}
+
+static void json_writer_print_container(json_writer* w, const cJSON* item, int depth) {
+    const bool is_object = cJSON_IsObject(item);
+
+    json_buffer_append_char(w->current, is_object ? '{' : '[');
+
+    if (item->child == NULL) {
+        json_buffer_append_char(w->current, is_object ? '}' : ']');
+        return;
+    }
+
+    size_t count = 0;
+    if (w->can_split) {
+        for (const cJSON* child = item->child; child != NULL; child = child->next) {
+            count++;
+        }
+    }
+
+    if (count < JSON_WRITER_SPLIT_THRESHOLD || !json_writer_split(w, item->child, count, depth + 1, is_object)) {
+        json_writer_print_members(w, item->child, SIZE_MAX, 0, depth + 1, is_object);
+    }
+
+    if (w->current == NULL) {
+        return;
+    }
+
+    json_writer_newline(w, depth);
+    json_buffer_append_char(w->current, is_object ? '}' : ']');
+}
+
+void json_writer_print_value(json_writer* w, const cJSON* item, int depth) {
+    if (w->current == NULL) {
+        return;
+    }
+
+    switch (item->type & 0xFF) {
+    case cJSON_False:
+        json_buffer_append(w->current, "false", 5);
+        break;
+    case cJSON_True:
+        json_buffer_append(w->current, "true", 4);
+        break;
+    case cJSON_NULL:
+        json_buffer_append(w->current, "null", 4);
+        break;
+    case cJSON_Number:
+        json_writer_print_number(w, item->valuedouble);
+        break;
+    case cJSON_Raw:
+        json_buffer_append(w->current, item->valuestring, strlen(item->valuestring));
+        break;
+    case cJSON_String:
+        json_writer_print_string(w, item->valuestring != NULL ? item->valuestring : "");
+        break;
+    case cJSON_Array:
+    case cJSON_Object:
+        json_writer_print_container(w, item, depth);
+        break;
+    default:
+        break;
+    }
+}
+
+static void json_writer_run_tasks(void* arg) {
+    const json_worker* worker = (const json_worker*)arg;
+    const json_writer* parent = worker->writer;
+
+    for (size_t i = worker->first_task; i < parent->task_count; i += worker->task_stride) {
+        const json_task* task = &parent->tasks[i];
+
+        // Tasks print sequentially, only the top-level walk splits containers
+        json_writer w = {
+            .indent = parent->indent,
+            .thread_count = 1,
+            .current = task->output,
+            .can_split = false,
+        };
+
+        json_writer_print_members(&w, task->first, task->count, task->index, task->depth, task->is_object);
+    }
+}
+
+static bool json_writer_run(json_writer* w) {
+    if (w->task_count == 0) {
+        return true;
+    }
+
+    const size_t thread_count = w->task_count < (size_t)w->thread_count ? w->task_count : (size_t)w->thread_count;
+    json_worker* workers = calloc(thread_count, sizeof(json_worker));
+    thread** threads = calloc(thread_count, sizeof(thread*));
+    if (workers == NULL || threads == NULL) {
+        free(workers);
+        free(threads);
+        return false;
+    }
+
+    for (size_t i = 0; i < thread_count; i++) {
+        workers[i].writer = w;
+        workers[i].first_task = i;
+        workers[i].task_stride = thread_count;
+    }
+
+    // The calling thread takes the first share itself, if a thread can't be started it does that share too
+    for (size_t i = 1; i < thread_count; i++) {
+        threads[i] = thread_create(json_writer_run_tasks, &workers[i]);
+    }
+
+    json_writer_run_tasks(&workers[0]);
+
+    for (size_t i = 1; i < thread_count; i++) {
+        if (threads[i] != NULL) {
+            thread_join(threads[i]);
+        } else {
+            json_writer_run_tasks(&workers[i]);
+        }
+    }
+
+    free(workers);
+    free(threads);
+
+    return true;
+}
+
+#if defined(_WIN32)
+static bool json_writer_write_chunks(const char* path, json_buffer* const* chunks, size_t count) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open output file: %s\n", path);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (fwrite(chunks[i]->data, 1, chunks[i]->size, file) != chunks[i]->size) {
+            fprintf(stderr, "Failed to write to output file: %s\n", path);
+            fclose(file);
+            return false;
+        }
+    }
+
+    return fclose(file) == 0;
+}
+#else
+static bool json_writer_write_chunks(const char* path, json_buffer* const* chunks, size_t count) {
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open output file: %s\n", path);
+        return false;
+    }
+
+    struct iovec iov[IOV_MAX < 1024 ? IOV_MAX : 1024];
+    size_t next = 0;
+
+    while (next < count) {
+        int iov_count = 0;
+        while (next < count && iov_count < (int)(sizeof(iov) / sizeof(iov[0]))) {
+            if (chunks[next]->size != 0) {
+                iov[iov_count].iov_base = chunks[next]->data;
+                iov[iov_count].iov_len = chunks[next]->size;
+                iov_count++;
+            }
+            next++;
+        }
+
+        // writev may stop early, continue where it left off
+        struct iovec* pending = iov;
+        while (iov_count > 0) {
+            const ssize_t written = writev(fd, pending, iov_count);
+            if (written < 0) {
+                fprintf(stderr, "Failed to write to output file: %s\n", path);
+                close(fd);
+                return false;
+            }
+
+            size_t remaining = (size_t)written;
+            while (iov_count > 0 && remaining >= pending->iov_len) {
+                remaining -= pending->iov_len;
+                pending++;
+                iov_count--;
+            }
+
+            if (iov_count > 0) {
+                pending->iov_base = (char*)pending->iov_base + remaining;
+                pending->iov_len -= remaining;
+            }
+        }
+    }
+
+    return close(fd) == 0;
+}
+#endif
+
+// Whether the file at path holds exactly the chunks. Files of another size aren't read.
+static bool json_writer_matches_file(const char* path, json_buffer* const* chunks, size_t count) {
+    file_map* const map = file_map_create(path);
+    if (map == NULL) {
+        return false;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += chunks[i]->size;
+    }
+
+    bool matches = total == map->size;
+    size_t offset = 0;
+    for (size_t i = 0; i < count && matches; i++) {
+        matches = chunks[i]->size == 0 || memcmp(map->data + offset, chunks[i]->data, chunks[i]->size) == 0;
+        offset += chunks[i]->size;
+    }
+
+    file_map_destroy(map);
+
+    return matches;
+}
+
+bool json_writer_write_file(const char* path, const cJSON* json, const json_writer_options* options) {
+    if (path == NULL || json == NULL || options == NULL) {
+        return false;
+    }
+
+    json_writer w = {
+        .indent = options->indent > 0 ? options->indent : 0,
+        .thread_count = options->thread_count > 0 ? options->thread_count : 1,
+        .can_split = options->thread_count > 1,
+        .buffers = options->buffers,
+    };
+
+    // Compressed output is only known once it's written, it goes next to the file and is compared afterwards
+    char* stream_path = NULL;
+    if (options->compression != FILE_COMPRESSION_NONE) {
+        stream_path = options->keep_unchanged ? util_fs_temp_path(path) : (char*)path;
+        w.stream = stream_path != NULL ? file_stream_create(stream_path, options->compression) : NULL;
+        if (w.stream == NULL) {
+            if (stream_path != path) {
+                free(stream_path);
+            }
+
+            return false;
+        }
+    }
+
+    w.current = json_writer_push_chunk(&w);
+    json_writer_print_value(&w, json, 0);
+
+    bool result = !w.failed && json_writer_run(&w);
+
+    for (size_t i = 0; i < w.chunk_count && result; i++) {
+        result = !w.chunks[i]->failed;
+    }
+
+    if (!result) {
+        fprintf(stderr, "Failed to allocate memory for JSON output\n");
+    } else if (w.stream == NULL) {
+        result = (options->keep_unchanged && json_writer_matches_file(path, w.chunks, w.chunk_count))
+            || json_writer_write_chunks(path, w.chunks, w.chunk_count);
+    } else {
+        for (size_t i = 0; i < w.chunk_count; i++) {
+            file_stream_write(w.stream, w.chunks[i]->data, w.chunks[i]->size);
+        }
+    }
+
+    if (w.stream != NULL && !file_stream_close(w.stream) && result) {
+        fprintf(stderr, "Failed to write to output file: %s\n", path);
+        result = false;
+    }
+
+    if (stream_path != NULL && stream_path != path) {
+        if (result && !util_fs_replace_if_changed(stream_path, path)) {
+            fprintf(stderr, "Failed to replace output file: %s\n", path);
+            result = false;
+        }
+
+        if (!result) {
+            remove(stream_path);
+        }
+
+        free(stream_path);
+    }
+
+    size_t retained = 0;
+    for (size_t i = 0; w.buffers != NULL && i < w.buffers->spare_count; i++) {
+        retained += w.buffers->spare[i]->capacity;
+    }
+
+    for (size_t i = 0; i < w.chunk_count; i++) {
+        json_writer_release_chunk(w.buffers, w.chunks[i], &retained);
+    }
+
+    free(w.chunks);
+    free(w.tasks);
+
+    return result;
+}
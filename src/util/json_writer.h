@@ -0,0 +1,32 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include "file_stream.h"
+
+#include <stdbool.h>
+#include <cJSON.h>
+
+// Print buffers kept from one document to the next, so printing many documents doesn't grow and
+// free them for every one of them. Buffers beyond retain bytes are freed after each document.
+// Only one document can be printed with them at a time.
+typedef struct json_writer_buffers json_writer_buffers;
+
+json_writer_buffers* json_writer_buffers_create(size_t retain);
+void json_writer_buffers_destroy(json_writer_buffers* buffers);
+
+typedef struct json_writer_options {
+    int indent; //< Spaces per nesting level, 0 writes minified JSON on a single line
+    int thread_count; //< Threads to print large arrays and objects with, 1 prints everything on the calling thread
+    file_compression compression; //< Compresses the output on a background thread while it is printed
+    json_writer_buffers* buffers; //< Print buffers to reuse, NULL allocates them for this document only
+    bool keep_unchanged; //< Leaves the file alone, modification time included, if it already holds exactly the output
+} json_writer_options;
+
+// Prints a cJSON tree to a file, replacing cJSON_Print + fwrite.
+// The document is printed into separate chunks instead of one contiguous string: arrays and
+// objects with many members are split into ranges that are printed on multiple threads, and
+// the chunks are then written in order with a single gathered write.
+// The output for a given indent is the same regardless of the thread count.
+bool json_writer_write_file(const char* path, const cJSON* json, const json_writer_options* options);
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,364 @@
+#include "msgpack_reader.h"
+#include "msgpack_writer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Same limit json_reader uses
+#define MSGPACK_READER_NESTING_LIMIT 1000
+
+
+typedef struct msgpack_reader {
+    const uint8_t* cur;
+    const uint8_t* end;
+    char* strings;
+    int depth;
+} msgpack_reader;
+
+static cJSON* msgpack_reader_parse_value(msgpack_reader* r);
+
+static cJSON* msgpack_reader_new_item(int type) {
+    cJSON* item = cJSON_malloc(sizeof(cJSON));
+    if (item == NULL) {
+        return NULL;
+    }
+
+    memset(item, 0, sizeof(cJSON));
+    item->type = type;
+
+    return item;
+}
+
+static bool msgpack_reader_read_be(msgpack_reader* r, int size, uint64_t* value) {
+    if (r->end - r->cur < size) {
+        return false;
+    }
+
+    *value = 0;
+    for (int i = 0; i < size; i++) {
+        *value = (*value << 8) | r->cur[i];
+    }
+
+    r->cur += size;
+    return true;
+}
+
+static char* msgpack_reader_read_str(msgpack_reader* r, uint64_t length) {
+    if ((uint64_t)(r->end - r->cur) < length) {
+        return NULL;
+    }
+
+    // Every string is preceded by at least one header byte, so the copies never outgrow the input
+    char* str = r->strings;
+    memcpy(str, r->cur, (size_t)length);
+    str[length] = '\0';
+
+    r->strings += length + 1;
+    r->cur += length;
+
+    return str;
+}
+
+// Reads the string at the current position, used for map keys
+static char* msgpack_reader_parse_str(msgpack_reader* r) {
+    uint64_t length;
+
+    if (r->cur >= r->end) {
+        return NULL;
+    }
+
+    const uint8_t tag = *r->cur++;
+    if ((tag & 0xE0) == 0xA0) {
+        length = tag & 0x1F;
+    } else if (tag >= 0xD9 && tag <= 0xDB) {
+        if (!msgpack_reader_read_be(r, 1 << (tag - 0xD9), &length)) {
+            return NULL;
+        }
+    } else {
+        return NULL;
+    }
+
+    return msgpack_reader_read_str(r, length);
+}
+
+static cJSON* msgpack_reader_new_number(double value) {
+    cJSON* item = msgpack_reader_new_item(cJSON_Number);
+    if (item == NULL) {
+        return NULL;
+    }
+
+    item->valuedouble = value;
+    if (value >= INT32_MAX) {
+        item->valueint = INT32_MAX;
+    } else if (value <= (double)INT32_MIN) {
+        item->valueint = INT32_MIN;
+    } else {
+        item->valueint = (int)value;
+    }
+
+    return item;
+}
+
+static cJSON* msgpack_reader_new_integer(uint64_t value, bool is_signed) {
+    const bool negative = is_signed && (int64_t)value < 0;
+    cJSON* item = msgpack_reader_new_number(negative ? (double)(int64_t)value : (double)value);
+    if (item == NULL) {
+        return NULL;
+    }
+
+    // Values above 2^53 don't survive the double, keep their text for exact conversions
+    const uint64_t magnitude = negative ? (uint64_t)0 - value : value;
+    if (magnitude > (UINT64_C(1) << 53)) {
+        char buffer[24];
+        if (negative) {
+            snprintf(buffer, sizeof(buffer), "%" PRId64, (int64_t)value);
+        } else {
+            snprintf(buffer, sizeof(buffer), "%" PRIu64, value);
+        }
+
+        item->valuestring = cJSON_malloc(strlen(buffer) + 1);
+        if (item->valuestring == NULL) {
+            cJSON_Delete(item);
+            return NULL;
+        }
+        strcpy(item->valuestring, buffer);
+    }
+
+    return item;
+}
+
+static float msgpack_reader_to_f32(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void msgpack_reader_append(cJSON* container, cJSON** last, cJSON* item) {
+    // Same linkage cJSON uses: child->prev points at the last element
+    if (*last == NULL) {
+        container->child = item;
+    } else {
+        (*last)->next = item;
+        item->prev = *last;
+    }
+    *last = item;
+    container->child->prev = item;
+}
+
+static cJSON* msgpack_reader_parse_container(msgpack_reader* r, uint64_t count, bool is_object) {
+    if (++r->depth > MSGPACK_READER_NESTING_LIMIT) {
+        return NULL;
+    }
+
+    cJSON* container = msgpack_reader_new_item(is_object ? cJSON_Object : cJSON_Array);
+    if (container == NULL) {
+        return NULL;
+    }
+
+    cJSON* last = NULL;
+    for (uint64_t i = 0; i < count; i++) {
+        char* key = NULL;
+
+        if (is_object) {
+            key = msgpack_reader_parse_str(r);
+            if (key == NULL) {
+                cJSON_Delete(container);
+                return NULL;
+            }
+        }
+
+        cJSON* item = msgpack_reader_parse_value(r);
+        if (item == NULL) {
+            cJSON_Delete(container);
+            return NULL;
+        }
+
+        if (key != NULL) {
+            item->string = key;
+            item->type |= cJSON_StringIsConst;
+        }
+
+        msgpack_reader_append(container, &last, item);
+    }
+
+    r->depth--;
+
+    return container;
+}
+
+static cJSON* msgpack_reader_parse_ext(msgpack_reader* r, uint64_t length) {
+    if (r->cur >= r->end) {
+        return NULL;
+    }
+
+    const uint8_t type = *r->cur++;
+    if (type != MSGPACK_EXT_F32_ARRAY || length % sizeof(float) != 0 || (uint64_t)(r->end - r->cur) < length) {
+        return NULL;
+    }
+
+    cJSON* array = msgpack_reader_new_item(cJSON_Array);
+    if (array == NULL) {
+        return NULL;
+    }
+
+    // Tells them apart from regular arrays, and writes them as typed arrays again
+    array->valueint = MSGPACK_HINT_F32_ARRAY;
+
+    cJSON* last = NULL;
+    for (uint64_t i = 0; i < length; i += sizeof(float)) {
+        const uint8_t* p = r->cur + i;
+        const uint32_t bits = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+
+        cJSON* item = msgpack_reader_new_number(msgpack_reader_to_f32(bits));
+        if (item == NULL) {
+            cJSON_Delete(array);
+            return NULL;
+        }
+
+        msgpack_reader_append(array, &last, item);
+    }
+
+    r->cur += length;
+
+    return array;
+}
+
+static cJSON* msgpack_reader_parse_value(msgpack_reader* r) {
+    cJSON* item = NULL;
+    uint64_t value;
+
+    if (r->cur >= r->end) {
+        return NULL;
+    }
+
+    const uint8_t tag = *r->cur++;
+
+    if (tag <= 0x7F) {
+        return msgpack_reader_new_integer(tag, false);
+    }
+    if (tag >= 0xE0) {
+        return msgpack_reader_new_integer((uint64_t)(int64_t)(int8_t)tag, true);
+    }
+    if ((tag & 0xF0) == 0x80) {
+        return msgpack_reader_parse_container(r, tag & 0x0F, true);
+    }
+    if ((tag & 0xF0) == 0x90) {
+        return msgpack_reader_parse_container(r, tag & 0x0F, false);
+    }
+    if ((tag & 0xE0) == 0xA0 || (tag >= 0xD9 && tag <= 0xDB)) {
+        r->cur--;
+
+        item = msgpack_reader_new_item(cJSON_String | cJSON_IsReference);
+        if (item == NULL) {
+            return NULL;
+        }
+
+        item->valuestring = msgpack_reader_parse_str(r);
+        if (item->valuestring == NULL) {
+            cJSON_free(item);
+            return NULL;
+        }
+        return item;
+    }
+
+    switch (tag) {
+    case 0xC0:
+        return msgpack_reader_new_item(cJSON_NULL);
+    case 0xC2:
+        return msgpack_reader_new_item(cJSON_False);
+    case 0xC3:
+        return msgpack_reader_new_item(cJSON_True);
+    case 0xC7:
+    case 0xC8:
+    case 0xC9:
+        if (!msgpack_reader_read_be(r, 1 << (tag - 0xC7), &value)) {
+            return NULL;
+        }
+        return msgpack_reader_parse_ext(r, value);
+    case 0xCA:
+        if (!msgpack_reader_read_be(r, 4, &value)) {
+            return NULL;
+        }
+        return msgpack_reader_new_number(msgpack_reader_to_f32((uint32_t)value));
+    case 0xCB: {
+        if (!msgpack_reader_read_be(r, 8, &value)) {
+            return NULL;
+        }
+
+        double f64;
+        memcpy(&f64, &value, sizeof(f64));
+        return msgpack_reader_new_number(f64);
+    }
+    case 0xCC:
+    case 0xCD:
+    case 0xCE:
+    case 0xCF:
+        if (!msgpack_reader_read_be(r, 1 << (tag - 0xCC), &value)) {
+            return NULL;
+        }
+        return msgpack_reader_new_integer(value, false);
+    case 0xD0:
+    case 0xD1:
+    case 0xD2:
+    case 0xD3: {
+        const int size = 1 << (tag - 0xD0);
+        if (!msgpack_reader_read_be(r, size, &value)) {
+            return NULL;
+        }
+
+        // Sign extend to 64 bits
+        const int shift = 64 - 8 * size;
+        return msgpack_reader_new_integer((uint64_t)((int64_t)(value << shift) >> shift), true);
+    }
+    case 0xD4:
+    case 0xD5:
+    case 0xD6:
+    case 0xD7:
+    case 0xD8:
+        return msgpack_reader_parse_ext(r, (uint64_t)1 << (tag - 0xD4));
+    case 0xDC:
+    case 0xDD:
+        if (!msgpack_reader_read_be(r, tag == 0xDC ? 2 : 4, &value)) {
+            return NULL;
+        }
+        return msgpack_reader_parse_container(r, value, false);
+    case 0xDE:
+    case 0xDF:
+        if (!msgpack_reader_read_be(r, tag == 0xDE ? 2 : 4, &value)) {
+            return NULL;
+        }
+        return msgpack_reader_parse_container(r, value, true);
+    default:
+        break;
+    }
+
+    // bin and the reserved tag have no JSON equivalent
+    return NULL;
+}
+
+cJSON* msgpack_reader_parse(const uint8_t* buffer, size_t size, char* strings) {
+    if (buffer == NULL || strings == NULL) {
+        return NULL;
+    }
+
+    msgpack_reader reader = {
+        .cur = buffer,
+        .end = buffer + size,
+        .strings = strings,
+        .depth = 0,
+    };
+
+    cJSON* root = msgpack_reader_parse_value(&reader);
+    if (root == NULL) {
+        return NULL;
+    }
+
+    if (reader.cur != reader.end) {
+        cJSON_Delete(root);
+        return NULL;
+    }
+
+    return root;
+}
@@ -0,0 +1,16 @@
+#ifndef MSGPACK_READER_H
+#define MSGPACK_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cJSON.h>
+
+// Parses a MessagePack document into a regular cJSON tree, which is freed with cJSON_Delete.
+// Strings and keys are copied null-terminated into strings and referenced from there, so it
+// must be at least size bytes large and outlive the returned tree.
+// Integers wider than 53 bits keep their decimal text in valuestring the same way json_reader
+// numbers do. MSGPACK_EXT_F32_ARRAY typed arrays become arrays of numbers with their valueint
+// set to MSGPACK_HINT_F32_ARRAY.
+cJSON* msgpack_reader_parse(const uint8_t* buffer, size_t size, char* strings);
+
+#endif // MSGPACK_READER_H
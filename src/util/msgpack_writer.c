@@ -0,0 +1,380 @@
+#include "msgpack_writer.h"
+#include "file_map.h"
+#include "fs.h"
+#include "number_parse.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MSGPACK_WRITER_BLOCK_SIZE (64 * 1024)
+
+
+typedef struct msgpack_output {
+    file_stream* stream; //< Written to in blocks, NULL collects the whole document in data
+    uint8_t* data; //< Free this
+    size_t size;
+    size_t capacity;
+    bool failed; //< Ran out of memory
+} msgpack_output;
+
+static bool msgpack_output_reserve(msgpack_output* out, size_t size) {
+    size_t capacity = out->capacity != 0 ? out->capacity : MSGPACK_WRITER_BLOCK_SIZE;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+    uint8_t* data = realloc(out->data, capacity);
+    if (data == NULL) {
+        return false;
+    }
+
+    out->data = data;
+    out->capacity = capacity;
+
+    return true;
+}
+
+static void msgpack_put(msgpack_output* out, const void* data, size_t size) {
+    if (out->size + size > out->capacity) {
+        if (out->stream != NULL) {
+            // Streamed output only holds a block, anything larger goes straight through
+            file_stream_write(out->stream, out->data, out->size);
+            out->size = 0;
+
+            if (size > out->capacity) {
+                file_stream_write(out->stream, data, size);
+                return;
+            }
+        } else if (out->failed || !msgpack_output_reserve(out, out->size + size)) {
+            out->failed = true;
+            return;
+        }
+    }
+
+    memcpy(out->data + out->size, data, size);
+    out->size += size;
+}
+
+static void msgpack_put_u8(msgpack_output* out, uint8_t value) {
+    msgpack_put(out, &value, 1);
+}
+
+static void msgpack_write_be(msgpack_output* out, uint8_t tag, uint64_t value, int size) {
+    uint8_t bytes[9];
+
+    bytes[0] = tag;
+    for (int i = 0; i < size; i++) {
+        bytes[1 + i] = (uint8_t)(value >> (8 * (size - 1 - i)));
+    }
+
+    msgpack_put(out, bytes, 1 + (size_t)size);
+}
+
+// Writes the smallest header of a family: fix format (if any), then 8/16/32 bit lengths.
+// tags holds the tags of the 8, 16 and 32 bit formats, 0 if the family doesn't have one.
+static void msgpack_write_header(msgpack_output* out, uint8_t fix_tag, uint32_t fix_max, const uint8_t tags[3], uint32_t length) {
+    if (fix_tag != 0 && length <= fix_max) {
+        msgpack_put_u8(out, (uint8_t)(fix_tag | length));
+    } else if (tags[0] != 0 && length <= UINT8_MAX) {
+        msgpack_write_be(out, tags[0], length, 1);
+    } else if (length <= UINT16_MAX) {
+        msgpack_write_be(out, tags[1], length, 2);
+    } else {
+        msgpack_write_be(out, tags[2], length, 4);
+    }
+}
+
+static void msgpack_write_str(msgpack_output* out, const char* str) {
+    static const uint8_t tags[3] = { 0xD9, 0xDA, 0xDB };
+    const size_t length = strlen(str);
+
+    msgpack_write_header(out, 0xA0, 31, tags, (uint32_t)length);
+    msgpack_put(out, str, length);
+}
+
+static void msgpack_write_uint(msgpack_output* out, uint64_t value) {
+    if (value <= 0x7F) {
+        msgpack_put_u8(out, (uint8_t)value);
+    } else if (value <= UINT8_MAX) {
+        msgpack_write_be(out, 0xCC, value, 1);
+    } else if (value <= UINT16_MAX) {
+        msgpack_write_be(out, 0xCD, value, 2);
+    } else if (value <= UINT32_MAX) {
+        msgpack_write_be(out, 0xCE, value, 4);
+    } else {
+        msgpack_write_be(out, 0xCF, value, 8);
+    }
+}
+
+static void msgpack_write_int(msgpack_output* out, int64_t value) {
+    if (value >= 0) {
+        msgpack_write_uint(out, (uint64_t)value);
+    } else if (value >= -32) {
+        msgpack_put_u8(out, (uint8_t)value);
+    } else if (value >= INT8_MIN) {
+        msgpack_write_be(out, 0xD0, (uint64_t)value, 1);
+    } else if (value >= INT16_MIN) {
+        msgpack_write_be(out, 0xD1, (uint64_t)value, 2);
+    } else if (value >= INT32_MIN) {
+        msgpack_write_be(out, 0xD2, (uint64_t)value, 4);
+    } else {
+        msgpack_write_be(out, 0xD3, (uint64_t)value, 8);
+    }
+}
+
+static void msgpack_write_f32(msgpack_output* out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    msgpack_write_be(out, 0xCA, bits, 4);
+}
+
+static void msgpack_write_f64(msgpack_output* out, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    msgpack_write_be(out, 0xCB, bits, 8);
+}
+
+static void msgpack_write_number(msgpack_output* out, double value) {
+    // Integral values are stored as integers, which is both smaller and what readers expect for counts
+    if (value == floor(value) && value >= -9223372036854775808.0 && value < 9223372036854775808.0) {
+        msgpack_write_int(out, (int64_t)value);
+    } else {
+        msgpack_write_f64(out, value);
+    }
+}
+
+static bool msgpack_write_raw(msgpack_output* out, const cJSON* json) {
+    const char* text = json->valuestring;
+
+    switch (json->valueint) {
+    case MSGPACK_HINT_F32:
+        msgpack_write_f32(out, (float)json->valuedouble);
+        return true;
+    case MSGPACK_HINT_F64:
+        msgpack_write_f64(out, json->valuedouble);
+        return true;
+    default:
+        break;
+    }
+
+    if (text == NULL) {
+        return false;
+    }
+
+    if (strcmp(text, "null") == 0) {
+        msgpack_put_u8(out, 0xC0);
+        return true;
+    }
+
+    if (strcmp(text, "true") == 0 || strcmp(text, "false") == 0) {
+        msgpack_put_u8(out, text[0] == 't' ? 0xC3 : 0xC2);
+        return true;
+    }
+
+    // Integer literals are converted directly, they may not fit into a double
+    if (strpbrk(text, ".eE") == NULL) {
+        if (text[0] == '-') {
+            int64_t value;
+            if (number_parse_s64(text, &value) != NULL) {
+                msgpack_write_int(out, value);
+                return true;
+            }
+        } else {
+            uint64_t value;
+            if (number_parse_u64(text, &value) != NULL) {
+                msgpack_write_uint(out, value);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    double value;
+    if (number_parse_f64(text, &value) == NULL) {
+        return false;
+    }
+
+    msgpack_write_f64(out, value);
+    return true;
+}
+
+static bool msgpack_write_f32_array(msgpack_output* out, const cJSON* json) {
+    static const uint8_t tags[3] = { 0xC7, 0xC8, 0xC9 };
+    uint32_t count = 0;
+
+    for (const cJSON* item = json->child; item != NULL; item = item->next) {
+        if (!cJSON_IsNumber(item) && !(cJSON_IsRaw(item) && item->valueint == MSGPACK_HINT_F32)) {
+            return false;
+        }
+        count++;
+    }
+
+    // fixext formats only exist for power of two sizes, the generic ext ones are good enough
+    msgpack_write_header(out, 0, 0, tags, count * sizeof(float));
+    msgpack_put_u8(out, MSGPACK_EXT_F32_ARRAY);
+
+    for (const cJSON* item = json->child; item != NULL; item = item->next) {
+        const float value = (float)item->valuedouble;
+        uint32_t bits;
+        uint8_t bytes[4];
+
+        memcpy(&bits, &value, sizeof(bits));
+        bytes[0] = (uint8_t)bits;
+        bytes[1] = (uint8_t)(bits >> 8);
+        bytes[2] = (uint8_t)(bits >> 16);
+        bytes[3] = (uint8_t)(bits >> 24);
+        msgpack_put(out, bytes, sizeof(bytes));
+    }
+
+    return true;
+}
+
+static bool msgpack_write_item(msgpack_output* out, const cJSON* json);
+
+static bool msgpack_write_container(msgpack_output* out, const cJSON* json) {
+    static const uint8_t array_tags[3] = { 0, 0xDC, 0xDD };
+    static const uint8_t map_tags[3] = { 0, 0xDE, 0xDF };
+    const bool is_object = cJSON_IsObject(json);
+    uint32_t count = 0;
+
+    for (const cJSON* item = json->child; item != NULL; item = item->next) {
+        count++;
+    }
+
+    if (is_object) {
+        msgpack_write_header(out, 0x80, 15, map_tags, count);
+    } else {
+        msgpack_write_header(out, 0x90, 15, array_tags, count);
+    }
+
+    for (const cJSON* item = json->child; item != NULL; item = item->next) {
+        if (is_object) {
+            msgpack_write_str(out, item->string != NULL ? item->string : "");
+        }
+
+        if (!msgpack_write_item(out, item)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool msgpack_write_item(msgpack_output* out, const cJSON* json) {
+    switch (json->type & 0xFF) {
+    case cJSON_False:
+        msgpack_put_u8(out, 0xC2);
+        return true;
+    case cJSON_True:
+        msgpack_put_u8(out, 0xC3);
+        return true;
+    case cJSON_NULL:
+        msgpack_put_u8(out, 0xC0);
+        return true;
+    case cJSON_Number:
+        msgpack_write_number(out, json->valuedouble);
+        return true;
+    case cJSON_String:
+        msgpack_write_str(out, json->valuestring != NULL ? json->valuestring : "");
+        return true;
+    case cJSON_Raw:
+        return msgpack_write_raw(out, json);
+    case cJSON_Array:
+    case cJSON_Object:
+        if (json->valueint == MSGPACK_HINT_F32_ARRAY && msgpack_write_f32_array(out, json)) {
+            return true;
+        }
+        return msgpack_write_container(out, json);
+    default:
+        return false;
+    }
+}
+
+// Whether the file at path holds exactly size bytes of data. Files of another size aren't read.
+static bool msgpack_writer_matches_file(const char* path, const uint8_t* data, size_t size) {
+    file_map* const map = file_map_create(path);
+    if (map == NULL) {
+        return false;
+    }
+
+    const bool matches = map->size == size && (size == 0 || memcmp(map->data, data, size) == 0);
+    file_map_destroy(map);
+
+    return matches;
+}
+
+bool msgpack_writer_write_file(const char* path, const cJSON* json, const msgpack_writer_options* options) {
+    if (path == NULL || json == NULL || options == NULL) {
+        return false;
+    }
+
+    // Plain output that may be left alone is collected in memory and compared before anything is
+    // opened for writing. Everything else is streamed, compressed output to a file next to path
+    // first when it may be left alone, which is only known once it is complete.
+    const bool compare = options->keep_unchanged && options->compression == FILE_COMPRESSION_NONE;
+    char* const stream_path = options->keep_unchanged && !compare ? util_fs_temp_path(path) : (char*)path;
+    if (stream_path == NULL) {
+        return false;
+    }
+
+    msgpack_output out = { 0 };
+    if (!compare) {
+        out.stream = file_stream_create(stream_path, options->compression);
+        if (out.stream == NULL || !msgpack_output_reserve(&out, MSGPACK_WRITER_BLOCK_SIZE)) {
+            fprintf(stderr, "Failed to open output file: %s\n", path);
+            file_stream_close(out.stream);
+            if (stream_path != path) {
+                remove(stream_path);
+                free(stream_path);
+            }
+
+            return false;
+        }
+    }
+
+    bool result = msgpack_write_item(&out, json);
+    if (!result) {
+        fprintf(stderr, "Failed to convert to MessagePack: %s\n", path);
+    } else if (out.failed) {
+        fprintf(stderr, "Failed to allocate memory for MessagePack output\n");
+        result = false;
+    } else if (compare && !msgpack_writer_matches_file(path, out.data, out.size)) {
+        out.stream = file_stream_create(path, FILE_COMPRESSION_NONE);
+        if (out.stream == NULL) {
+            fprintf(stderr, "Failed to open output file: %s\n", path);
+            result = false;
+        }
+    }
+
+    if (out.stream != NULL) {
+        if (result) {
+            file_stream_write(out.stream, out.data, out.size);
+        }
+
+        if (!file_stream_close(out.stream) && result) {
+            fprintf(stderr, "Failed to write to output file: %s\n", path);
+            result = false;
+        }
+    }
+
+    if (stream_path != path) {
+        if (result && !util_fs_replace_if_changed(stream_path, path)) {
+            fprintf(stderr, "Failed to replace output file: %s\n", path);
+            result = false;
+        }
+
+        if (!result) {
+            remove(stream_path);
+        }
+
+        free(stream_path);
+    }
+
+    free(out.data);
+
+    return result;
+}
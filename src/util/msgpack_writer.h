@@ -0,0 +1,33 @@
+#ifndef MSGPACK_WRITER_H
+#define MSGPACK_WRITER_H
+
+#include "file_stream.h"
+
+#include <stdbool.h>
+#include <cJSON.h>
+
+// Extension type of typed arrays, the payload is a packed array of little-endian IEEE floats
+#define MSGPACK_EXT_F32_ARRAY 1
+
+// Raw items are pre-formatted numbers whose precision can't be told from their text, and
+// objects may be better stored as a typed array. Since cJSON doesn't use valueint for either,
+// whoever creates them can store one of these there to choose the encoding.
+// Float hints also store the exact value in valuedouble.
+typedef enum msgpack_hint {
+    MSGPACK_HINT_NONE,
+    MSGPACK_HINT_F32,       //< Raw item, written as float32
+    MSGPACK_HINT_F64,       //< Raw item, written as float64
+    MSGPACK_HINT_F32_ARRAY, //< Object or array of F32 items, written as MSGPACK_EXT_F32_ARRAY
+} msgpack_hint;
+
+typedef struct msgpack_writer_options {
+    file_compression compression; //< Compresses the output on a background thread while it is written
+    bool keep_unchanged; //< Leaves the file alone, modification time included, if it already holds exactly the output
+} msgpack_writer_options;
+
+// Writes a cJSON tree as MessagePack with the same shape to a file, so it can be read back with
+// msgpack_reader_parse. Raw items without a hint are parsed as integer or double.
+// Returns false if an item can't be written or writing the file failed.
+bool msgpack_writer_write_file(const char* path, const cJSON* json, const msgpack_writer_options* options);
+
+#endif // MSGPACK_WRITER_H
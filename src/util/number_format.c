@@ -0,0 +1,321 @@
+#include "number_format.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Float to shortest decimal conversion based on Ryu by Ulf Adams (https://github.com/ulfjack/ryu),
+// restricted to 32-bit floats.
+
+#define F32_MANTISSA_BITS 23
+#define F32_EXPONENT_BITS 8
+#define F32_BIAS 127
+
+#define F32_POW5_INV_BITCOUNT 59
+#define F32_POW5_BITCOUNT 61
+
+static const uint64_t s_f32_pow5_inv_split[31] = {
+    576460752303423489u, 461168601842738791u, 368934881474191033u,
+    295147905179352826u, 472236648286964522u, 377789318629571618u,
+    302231454903657294u, 483570327845851670u, 386856262276681336u,
+    309485009821345069u, 495176015714152110u, 396140812571321688u,
+    316912650057057351u, 507060240091291761u, 405648192073033409u,
+    324518553658426727u, 519229685853482763u, 415383748682786211u,
+    332306998946228969u, 531691198313966350u, 425352958651173080u,
+    340282366920938464u, 544451787073501542u, 435561429658801234u,
+    348449143727040987u, 557518629963265579u, 446014903970612463u,
+    356811923176489971u, 570899077082383953u, 456719261665907162u,
+    365375409332725730u,
+};
+
+static const uint64_t s_f32_pow5_split[47] = {
+    1152921504606846976u, 1441151880758558720u, 1801439850948198400u,
+    2251799813685248000u, 1407374883553280000u, 1759218604441600000u,
+    2199023255552000000u, 1374389534720000000u, 1717986918400000000u,
+    2147483648000000000u, 1342177280000000000u, 1677721600000000000u,
+    2097152000000000000u, 1310720000000000000u, 1638400000000000000u,
+    2048000000000000000u, 1280000000000000000u, 1600000000000000000u,
+    2000000000000000000u, 1250000000000000000u, 1562500000000000000u,
+    1953125000000000000u, 1220703125000000000u, 1525878906250000000u,
+    1907348632812500000u, 1192092895507812500u, 1490116119384765625u,
+    1862645149230957031u, 1164153218269348144u, 1455191522836685180u,
+    1818989403545856475u, 2273736754432320594u, 1421085471520200371u,
+    1776356839400250464u, 2220446049250313080u, 1387778780781445675u,
+    1734723475976807094u, 2168404344971008868u, 1355252715606880542u,
+    1694065894508600678u, 2117582368135750847u, 1323488980084844279u,
+    1654361225106055349u, 2067951531382569187u, 1292469707114105741u,
+    1615587133892632177u, 2019483917365790221u,
+};
+
+// ceil(log2(5^e)) for 0 <= e <= 3528
+static int32_t pow5bits(int32_t e) {
+    return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) for 0 <= e <= 1650
+static uint32_t log10_pow2(int32_t e) {
+    return ((uint32_t)e * 78913) >> 18;
+}
+
+// floor(log10(5^e)) for 0 <= e <= 2620
+static uint32_t log10_pow5(int32_t e) {
+    return ((uint32_t)e * 732923) >> 20;
+}
+
+static uint32_t pow5_factor(uint32_t value) {
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+
+    return count;
+}
+
+static bool is_multiple_of_pow5(uint32_t value, uint32_t p) {
+    return pow5_factor(value) >= p;
+}
+
+static bool is_multiple_of_pow2(uint32_t value, uint32_t p) {
+    return (value & ((1u << p) - 1)) == 0;
+}
+
+static uint32_t mul_shift(uint32_t m, uint64_t factor, int32_t shift) {
+    const uint64_t bits0 = (uint64_t)m * (uint32_t)factor;
+    const uint64_t bits1 = (uint64_t)m * (uint32_t)(factor >> 32);
+    const uint64_t sum = (bits0 >> 32) + bits1;
+    return (uint32_t)(sum >> (shift - 32));
+}
+
+// Computes the shortest decimal mantissa/exponent pair that rounds to the given float.
+static void f32_to_decimal(uint32_t ieee_mantissa, uint32_t ieee_exponent, uint32_t* mantissa, int32_t* exponent) {
+    int32_t e2;
+    uint32_t m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - F32_BIAS - F32_MANTISSA_BITS - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = (int32_t)ieee_exponent - F32_BIAS - F32_MANTISSA_BITS - 2;
+        m2 = (1u << F32_MANTISSA_BITS) | ieee_mantissa;
+    }
+
+    const bool accept_bounds = (m2 & 1) == 0;
+
+    // Interval of valid decimal representations
+    const uint32_t mv = 4 * m2;
+    const uint32_t mp = 4 * m2 + 2;
+    const uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+    const uint32_t mm = 4 * m2 - 1 - mm_shift;
+
+    uint32_t vr, vp, vm;
+    int32_t e10;
+    bool vm_trailing_zeros = false;
+    bool vr_trailing_zeros = false;
+    uint8_t last_removed_digit = 0;
+
+    if (e2 >= 0) {
+        const uint32_t q = log10_pow2(e2);
+        const int32_t k = F32_POW5_INV_BITCOUNT + pow5bits((int32_t)q) - 1;
+        const int32_t i = -e2 + (int32_t)q + k;
+
+        e10 = (int32_t)q;
+        vr = mul_shift(mv, s_f32_pow5_inv_split[q], i);
+        vp = mul_shift(mp, s_f32_pow5_inv_split[q], i);
+        vm = mul_shift(mm, s_f32_pow5_inv_split[q], i);
+
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            // One removed digit is needed for rounding even if the loop below never runs
+            const int32_t l = F32_POW5_INV_BITCOUNT + pow5bits((int32_t)(q - 1)) - 1;
+            last_removed_digit = (uint8_t)(mul_shift(mv, s_f32_pow5_inv_split[q - 1], -e2 + (int32_t)q - 1 + l) % 10);
+        }
+
+        if (q <= 9) {
+            // Only one of mp, mv and mm can be a multiple of 5, if any
+            if (mv % 5 == 0) {
+                vr_trailing_zeros = is_multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = is_multiple_of_pow5(mm, q);
+            } else {
+                vp -= is_multiple_of_pow5(mp, q);
+            }
+        }
+    } else {
+        const uint32_t q = log10_pow5(-e2);
+        const int32_t i = -e2 - (int32_t)q;
+        const int32_t k = pow5bits(i) - F32_POW5_BITCOUNT;
+        int32_t j = (int32_t)q - k;
+
+        e10 = (int32_t)q + e2;
+        vr = mul_shift(mv, s_f32_pow5_split[i], j);
+        vp = mul_shift(mp, s_f32_pow5_split[i], j);
+        vm = mul_shift(mm, s_f32_pow5_split[i], j);
+
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            j = (int32_t)q - 1 - (pow5bits(i + 1) - F32_POW5_BITCOUNT);
+            last_removed_digit = (uint8_t)(mul_shift(mv, s_f32_pow5_split[i + 1], j) % 10);
+        }
+
+        if (q <= 1) {
+            // mv = 4 * m2 always has at least two trailing zero bits
+            vr_trailing_zeros = true;
+            if (accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 31) {
+            vr_trailing_zeros = is_multiple_of_pow2(mv, q - 1);
+        }
+    }
+
+    // Remove digits for as long as the interval still contains a shorter representation
+    int32_t removed = 0;
+    uint32_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = (uint8_t)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = (uint8_t)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+
+        if (vr_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) {
+            // Round to even if the exact number is .....50..0
+            last_removed_digit = 4;
+        }
+
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed_digit >= 5);
+    } else {
+        while (vp / 10 > vm / 10) {
+            last_removed_digit = (uint8_t)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+
+        output = vr + (vr == vm || last_removed_digit >= 5);
+    }
+
+    *mantissa = output;
+    *exponent = e10 + removed;
+}
+
+// Writes digits * 10^exponent, in fixed notation for moderate magnitudes and in scientific
+// notation otherwise (similar to %g, but without padding the exponent).
+static size_t write_decimal(char* buffer, bool negative, uint64_t digits, int32_t exponent) {
+    char digit_buffer[20];
+    int32_t digit_count = 0;
+    do {
+        digit_buffer[digit_count++] = (char)('0' + digits % 10);
+        digits /= 10;
+    } while (digits != 0);
+
+    // Position of the decimal point relative to the first digit
+    const int32_t point = digit_count + exponent;
+    const int32_t sci_exponent = point - 1;
+    const int32_t abs_sci_exponent = sci_exponent < 0 ? -sci_exponent : sci_exponent;
+
+    char* p = buffer;
+    if (negative) {
+        *p++ = '-';
+    }
+
+    if (sci_exponent >= -4 && sci_exponent < 9) {
+        if (point <= 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (int32_t i = 0; i < -point; i++) {
+                *p++ = '0';
+            }
+        }
+
+        for (int32_t i = 0; i < digit_count; i++) {
+            if (i == point && point > 0) {
+                *p++ = '.';
+            }
+            *p++ = digit_buffer[digit_count - 1 - i];
+        }
+
+        for (int32_t i = digit_count; i < point; i++) {
+            *p++ = '0';
+        }
+    } else {
+        *p++ = digit_buffer[digit_count - 1];
+        if (digit_count > 1) {
+            *p++ = '.';
+            for (int32_t i = digit_count - 2; i >= 0; i--) {
+                *p++ = digit_buffer[i];
+            }
+        }
+
+        *p++ = 'e';
+        if (sci_exponent < 0) {
+            *p++ = '-';
+        }
+        if (abs_sci_exponent >= 10) {
+            *p++ = (char)('0' + abs_sci_exponent / 10);
+        }
+        *p++ = (char)('0' + abs_sci_exponent % 10);
+    }
+
+    *p = '\0';
+
+    return (size_t)(p - buffer);
+}
+
+size_t number_format_f32(char* buffer, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const bool negative = (bits >> 31) != 0;
+    const uint32_t ieee_mantissa = bits & ((1u << F32_MANTISSA_BITS) - 1);
+    const uint32_t ieee_exponent = (bits >> F32_MANTISSA_BITS) & ((1u << F32_EXPONENT_BITS) - 1);
+
+    if (ieee_exponent == (1u << F32_EXPONENT_BITS) - 1) {
+        buffer[0] = '\0';
+        return 0;
+    }
+
+    if (ieee_exponent == 0 && ieee_mantissa == 0) {
+        return write_decimal(buffer, negative, 0, 0);
+    }
+
+    uint32_t mantissa;
+    int32_t exponent;
+    f32_to_decimal(ieee_mantissa, ieee_exponent, &mantissa, &exponent);
+
+    return write_decimal(buffer, negative, mantissa, exponent);
+}
+
+size_t number_format_f64(char* buffer, double value) {
+    if (value != value || value - value != 0.0) {
+        buffer[0] = '\0';
+        return 0;
+    }
+
+    int length = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        length = snprintf(buffer, NUMBER_FORMAT_F64_MAX, "%.*g", precision, value);
+        if (strtod(buffer, NULL) == value) {
+            break;
+        }
+    }
+
+    return (size_t)length;
+}
@@ -0,0 +1,21 @@
+#ifndef NUMBER_FORMAT_H
+#define NUMBER_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Enough for "-1.23456789e-45" plus the null terminator
+#define NUMBER_FORMAT_F32_MAX 24
+// Enough for "-1.2345678901234567e-308" plus the null terminator
+#define NUMBER_FORMAT_F64_MAX 32
+
+// Writes the shortest decimal representation of value that parses back to the exact same float.
+// Returns the number of characters written (excluding the null terminator), or 0 if value is
+// NaN or infinite, which JSON cannot represent.
+size_t number_format_f32(char* buffer, float value);
+
+// Same as number_format_f32 but for doubles. Doubles are rare in XFS files so this one
+// searches for the shortest precision that survives a round-trip instead of using Ryu.
+size_t number_format_f64(char* buffer, double value);
+
+#endif // NUMBER_FORMAT_H
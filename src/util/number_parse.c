@@ -0,0 +1,307 @@
+#include "number_parse.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Up to 19 decimal digits always fit into a uint64_t
+#define NUMBER_PARSE_MAX_DIGITS 19
+#define NUMBER_PARSE_MAX_EXPONENT 100000
+
+typedef struct number_literal {
+    const char* end;
+    uint64_t mantissa;
+    int32_t exponent;
+    bool negative;
+    bool truncated; //< More than NUMBER_PARSE_MAX_DIGITS significant digits
+} number_literal;
+
+// Powers of ten that are exactly representable as double/float
+static const double s_pow10_f64[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const float s_pow10_f32[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+};
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Splits a literal into sign, decimal mantissa and exponent
+static bool number_scan(const char* str, number_literal* lit) {
+    const char* p = str;
+    int digits = 0;
+
+    memset(lit, 0, sizeof(number_literal));
+
+    if (*p == '-') {
+        lit->negative = true;
+        p++;
+    }
+
+    if (!is_digit(*p)) {
+        return false;
+    }
+
+    while (is_digit(*p)) {
+        const uint32_t d = (uint32_t)(*p++ - '0');
+        if (digits < NUMBER_PARSE_MAX_DIGITS) {
+            lit->mantissa = lit->mantissa * 10 + d;
+            digits += lit->mantissa != 0;
+        } else {
+            lit->exponent++;
+            lit->truncated |= d != 0;
+        }
+    }
+
+    if (*p == '.') {
+        p++;
+
+        while (is_digit(*p)) {
+            const uint32_t d = (uint32_t)(*p++ - '0');
+            if (digits < NUMBER_PARSE_MAX_DIGITS) {
+                lit->mantissa = lit->mantissa * 10 + d;
+                digits += lit->mantissa != 0;
+                lit->exponent--;
+            } else {
+                lit->truncated |= d != 0;
+            }
+        }
+    }
+
+    if (*p == 'e' || *p == 'E') {
+        bool negative_exponent = false;
+        int32_t exponent = 0;
+
+        p++;
+
+        if (*p == '-' || *p == '+') {
+            negative_exponent = *p == '-';
+            p++;
+        }
+
+        if (!is_digit(*p)) {
+            return false;
+        }
+
+        while (is_digit(*p)) {
+            if (exponent < NUMBER_PARSE_MAX_EXPONENT) {
+                exponent = exponent * 10 + (*p - '0');
+            }
+            p++;
+        }
+
+        lit->exponent += negative_exponent ? -exponent : exponent;
+    }
+
+    lit->end = p;
+
+    return true;
+}
+
+// Whether narrowing a correctly rounded double to float could round in the wrong direction.
+// That is only possible if the double landed exactly between two floats (or at the overflow
+// threshold), because then the rounding direction depends on digits the double dropped.
+static bool is_f32_narrowing_ambiguous(double value, float narrowed) {
+    if ((double)narrowed == value || value != value) {
+        return false;
+    }
+
+    if (isinf(narrowed)) {
+        return true;
+    }
+
+    const float toward = nextafterf(narrowed, value > (double)narrowed ? INFINITY : -INFINITY);
+    return ((double)narrowed + (double)toward) / 2.0 == value;
+}
+
+// Slow path for literals the fast paths can't convert exactly
+static double number_strtod(const char* str, const char* end, bool single) {
+    char local_buffer[64];
+    const size_t length = (size_t)(end - str);
+    char* buffer = length < sizeof(local_buffer) ? local_buffer : malloc(length + 1);
+    if (buffer == NULL) {
+        return 0.0;
+    }
+
+    memcpy(buffer, str, length);
+    buffer[length] = '\0';
+
+    // The tool never calls setlocale, so strto* always sees the "C" locale here
+    const double value = single ? (double)strtof(buffer, NULL) : strtod(buffer, NULL);
+
+    if (buffer != local_buffer) {
+        free(buffer);
+    }
+
+    return value;
+}
+
+static double number_literal_to_f64(const char* str, const number_literal* lit) {
+    if (lit->mantissa == 0 && !lit->truncated) {
+        return lit->negative ? -0.0 : 0.0;
+    }
+
+    // Clinger's fast path: both operands are exact so the result is rounded only once
+    if (!lit->truncated && lit->mantissa <= (UINT64_C(1) << 53) && lit->exponent >= -22 && lit->exponent <= 22) {
+        double value = (double)lit->mantissa;
+        if (lit->exponent < 0) {
+            value /= s_pow10_f64[-lit->exponent];
+        } else {
+            value *= s_pow10_f64[lit->exponent];
+        }
+
+        return lit->negative ? -value : value;
+    }
+
+    return number_strtod(str, lit->end, false);
+}
+
+const char* number_parse_f64(const char* str, double* value) {
+    number_literal lit;
+    if (!number_scan(str, &lit)) {
+        return NULL;
+    }
+
+    *value = number_literal_to_f64(str, &lit);
+
+    return lit.end;
+}
+
+const char* number_parse_f32(const char* str, float* value) {
+    number_literal lit;
+    if (!number_scan(str, &lit)) {
+        return NULL;
+    }
+
+    if (!lit.truncated && lit.mantissa <= (UINT64_C(1) << 24) && lit.exponent >= -10 && lit.exponent <= 10) {
+        float result = (float)lit.mantissa;
+        if (lit.exponent < 0) {
+            result /= s_pow10_f32[-lit.exponent];
+        } else {
+            result *= s_pow10_f32[lit.exponent];
+        }
+
+        *value = lit.negative ? -result : result;
+        return lit.end;
+    }
+
+    const double result = number_literal_to_f64(str, &lit);
+    *value = (float)result;
+
+    if (is_f32_narrowing_ambiguous(result, *value)) {
+        *value = (float)number_strtod(str, lit.end, true);
+    }
+
+    return lit.end;
+}
+
+const char* number_parse_u64(const char* str, uint64_t* value) {
+    const char* p = str;
+    const bool negative = *p == '-';
+    uint64_t result = 0;
+    bool overflow = false;
+
+    if (negative) {
+        p++;
+    }
+
+    if (!is_digit(*p)) {
+        return NULL;
+    }
+
+    while (is_digit(*p)) {
+        const uint64_t d = (uint64_t)(*p++ - '0');
+        if (result > (UINT64_MAX - d) / 10) {
+            overflow = true;
+        } else {
+            result = result * 10 + d;
+        }
+    }
+
+    if (*p == '.' || *p == 'e' || *p == 'E') {
+        double d = 0.0;
+        p = number_parse_f64(str, &d);
+        if (d <= 0.0) {
+            *value = d <= -9223372036854775808.0 ? (uint64_t)INT64_MIN : (uint64_t)(int64_t)d;
+        } else {
+            *value = d >= 18446744073709551616.0 ? UINT64_MAX : (uint64_t)d;
+        }
+
+        return p;
+    }
+
+    if (overflow) {
+        *value = negative ? (uint64_t)INT64_MIN : UINT64_MAX;
+    } else {
+        // Negative values wrap around, the same way a negative integer converts to unsigned
+        *value = negative ? (uint64_t)0 - result : result;
+    }
+
+    return p;
+}
+
+const char* number_parse_s64(const char* str, int64_t* value) {
+    const char* p = str;
+    const bool negative = *p == '-';
+    const uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    uint64_t result = 0;
+    bool overflow = false;
+
+    if (negative) {
+        p++;
+    }
+
+    if (!is_digit(*p)) {
+        return NULL;
+    }
+
+    while (is_digit(*p)) {
+        const uint64_t d = (uint64_t)(*p++ - '0');
+        if (result > (limit - d) / 10) {
+            overflow = true;
+        } else {
+            result = result * 10 + d;
+        }
+    }
+
+    if (*p == '.' || *p == 'e' || *p == 'E') {
+        double d = 0.0;
+        p = number_parse_f64(str, &d);
+        if (d <= -9223372036854775808.0) {
+            *value = INT64_MIN;
+        } else if (d >= 9223372036854775808.0) {
+            *value = INT64_MAX;
+        } else {
+            *value = (int64_t)d;
+        }
+
+        return p;
+    }
+
+    if (overflow) {
+        result = limit;
+    }
+
+    *value = negative ? (int64_t)(0 - result) : (int64_t)result;
+
+    return p;
+}
+
+float number_narrow_f32(double value, const char* literal) {
+    const float narrowed = (float)value;
+    if (literal == NULL || !is_f32_narrowing_ambiguous(value, narrowed)) {
+        return narrowed;
+    }
+
+    float exact;
+    if (number_parse_f32(literal, &exact) == NULL) {
+        return narrowed;
+    }
+
+    return exact;
+}
@@ -0,0 +1,26 @@
+#ifndef NUMBER_PARSE_H
+#define NUMBER_PARSE_H
+
+#include <stdint.h>
+
+// Parsers for JSON number literals. They are locale independent and stop at the first
+// character that cannot be part of the literal, so str does not need to be null-terminated
+// right after the number, only somewhere after it.
+// Each function returns a pointer past the parsed literal, or NULL if str is not a number.
+
+// Correctly rounded decimal to double conversion
+const char* number_parse_f64(const char* str, double* value);
+
+// Correctly rounded decimal to float conversion (no double rounding through double)
+const char* number_parse_f32(const char* str, float* value);
+
+// Exact integer conversions. Out of range values saturate, literals with a fraction
+// or exponent are converted through double.
+const char* number_parse_u64(const char* str, uint64_t* value);
+const char* number_parse_s64(const char* str, int64_t* value);
+
+// Narrows an already correctly rounded double to float. literal is the text the double was
+// parsed from and is only re-parsed in the rare case where narrowing would round twice.
+float number_narrow_f32(double value, const char* literal);
+
+#endif // NUMBER_PARSE_H
@@ -0,0 +1,123 @@
+#include "queue.h"
+#include "thread.h"
+
+#include <stdlib.h>
+
+
+struct queue {
+    void** items; //< Free this. Ring buffer of capacity items
+    size_t capacity;
+    size_t head; //< Next item to take
+    size_t count;
+    bool closed;
+    mutex* lock;
+    condition* not_empty;
+    condition* not_full;
+};
+
+queue* queue_create(size_t capacity) {
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    queue* q = calloc(1, sizeof(queue));
+    if (q == NULL) {
+        return NULL;
+    }
+
+    q->items = calloc(capacity, sizeof(void*));
+    q->capacity = capacity;
+    q->lock = mutex_create();
+    q->not_empty = condition_create();
+    q->not_full = condition_create();
+    if (q->items == NULL || q->lock == NULL || q->not_empty == NULL || q->not_full == NULL) {
+        queue_destroy(q);
+        return NULL;
+    }
+
+    return q;
+}
+
+void queue_destroy(queue* queue) {
+    if (queue == NULL) {
+        return;
+    }
+
+    mutex_destroy(queue->lock);
+    condition_destroy(queue->not_empty);
+    condition_destroy(queue->not_full);
+
+    free(queue->items);
+    free(queue);
+}
+
+bool queue_push(queue* queue, void* item) {
+    mutex_lock(queue->lock);
+
+    while (queue->count == queue->capacity && !queue->closed) {
+        condition_wait(queue->not_full, queue->lock);
+    }
+
+    if (queue->closed) {
+        mutex_unlock(queue->lock);
+        return false;
+    }
+
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+
+    condition_signal(queue->not_empty);
+    mutex_unlock(queue->lock);
+
+    return true;
+}
+
+bool queue_pop(queue* queue, void** item) {
+    mutex_lock(queue->lock);
+
+    while (queue->count == 0 && !queue->closed) {
+        condition_wait(queue->not_empty, queue->lock);
+    }
+
+    if (queue->count == 0) {
+        mutex_unlock(queue->lock);
+        return false;
+    }
+
+    *item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+
+    condition_signal(queue->not_full);
+    mutex_unlock(queue->lock);
+
+    return true;
+}
+
+bool queue_try_pop(queue* queue, void** item) {
+    mutex_lock(queue->lock);
+
+    if (queue->count == 0) {
+        mutex_unlock(queue->lock);
+        return false;
+    }
+
+    *item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+
+    condition_signal(queue->not_full);
+    mutex_unlock(queue->lock);
+
+    return true;
+}
+
+void queue_close(queue* queue) {
+    mutex_lock(queue->lock);
+
+    queue->closed = true;
+    condition_broadcast(queue->not_empty);
+    condition_broadcast(queue->not_full);
+
+    mutex_unlock(queue->lock);
+}
@@ -0,0 +1,28 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+
+// Bounded first-in first-out queue of pointers shared between threads. Producers block while it
+// is full and consumers while it is empty, which keeps a fast stage from running ahead of a slow
+// one.
+typedef struct queue queue;
+
+queue* queue_create(size_t capacity);
+void queue_destroy(queue* queue);
+
+// Waits for a free slot. Returns false if the queue was closed.
+bool queue_push(queue* queue, void* item);
+
+// Waits for an item. Returns false once the queue is closed and every item was taken.
+bool queue_pop(queue* queue, void** item);
+
+// Takes an item if there is one without waiting. Returns false if the queue is empty.
+bool queue_try_pop(queue* queue, void** item);
+
+// Wakes up everyone waiting, pushing fails afterwards while the remaining items can still be taken
+void queue_close(queue* queue);
+
+#endif // QUEUE_H
@@ -0,0 +1,205 @@
+#include "thread.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+struct thread {
+#if defined(_WIN32)
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    thread_func func;
+    void* arg;
+};
+
+struct mutex {
+#if defined(_WIN32)
+    SRWLOCK lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+
+struct condition {
+#if defined(_WIN32)
+    CONDITION_VARIABLE cond;
+#else
+    pthread_cond_t cond;
+#endif
+};
+
+#if defined(_WIN32)
+static DWORD WINAPI thread_entry(LPVOID param) {
+    thread* t = (thread*)param;
+    t->func(t->arg);
+    return 0;
+}
+#else
+static void* thread_entry(void* param) {
+    thread* t = (thread*)param;
+    t->func(t->arg);
+    return NULL;
+}
+#endif
+
+thread* thread_create(thread_func func, void* arg) {
+    thread* t = malloc(sizeof(thread));
+    if (t == NULL) {
+        return NULL;
+    }
+
+    t->func = func;
+    t->arg = arg;
+
+#if defined(_WIN32)
+    t->handle = CreateThread(NULL, 0, thread_entry, t, 0, NULL);
+    if (t->handle == NULL) {
+        free(t);
+        return NULL;
+    }
+#else
+    if (pthread_create(&t->handle, NULL, thread_entry, t) != 0) {
+        free(t);
+        return NULL;
+    }
+#endif
+
+    return t;
+}
+
+void thread_join(thread* thread) {
+    if (thread == NULL) {
+        return;
+    }
+
+#if defined(_WIN32)
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+
+    free(thread);
+}
+
+int thread_hardware_concurrency(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const long count = (long)info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return count > 0 ? (int)count : 1;
+}
+
+mutex* mutex_create(void) {
+    mutex* m = malloc(sizeof(mutex));
+    if (m == NULL) {
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    InitializeSRWLock(&m->lock);
+#else
+    if (pthread_mutex_init(&m->lock, NULL) != 0) {
+        free(m);
+        return NULL;
+    }
+#endif
+
+    return m;
+}
+
+void mutex_destroy(mutex* mutex) {
+    if (mutex == NULL) {
+        return;
+    }
+
+#if !defined(_WIN32)
+    pthread_mutex_destroy(&mutex->lock);
+#endif
+
+    free(mutex);
+}
+
+void mutex_lock(mutex* mutex) {
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(&mutex->lock);
+#else
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void mutex_unlock(mutex* mutex) {
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(&mutex->lock);
+#else
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+condition* condition_create(void) {
+    condition* c = malloc(sizeof(condition));
+    if (c == NULL) {
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    InitializeConditionVariable(&c->cond);
+#else
+    if (pthread_cond_init(&c->cond, NULL) != 0) {
+        free(c);
+        return NULL;
+    }
+#endif
+
+    return c;
+}
+
+void condition_destroy(condition* condition) {
+    if (condition == NULL) {
+        return;
+    }
+
+#if !defined(_WIN32)
+    pthread_cond_destroy(&condition->cond);
+#endif
+
+    free(condition);
+}
+
+void condition_wait(condition* condition, mutex* mutex) {
+#if defined(_WIN32)
+    SleepConditionVariableSRW(&condition->cond, &mutex->lock, INFINITE, 0);
+#else
+    pthread_cond_wait(&condition->cond, &mutex->lock);
+#endif
+}
+
+void condition_signal(condition* condition) {
+#if defined(_WIN32)
+    WakeConditionVariable(&condition->cond);
+#else
+    pthread_cond_signal(&condition->cond);
+#endif
+}
+
+void condition_broadcast(condition* condition) {
+#if defined(_WIN32)
+    WakeAllConditionVariable(&condition->cond);
+#else
+    pthread_cond_broadcast(&condition->cond);
+#endif
+}
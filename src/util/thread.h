@@ -0,0 +1,42 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdbool.h>
+
+
+// Storage class for variables that have a separate instance on every thread
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef struct thread thread;
+typedef void (*thread_func)(void* arg);
+
+// Starts func(arg) on a new thread, returns NULL if the thread couldn't be created
+thread* thread_create(thread_func func, void* arg);
+
+// Waits for the thread to finish and frees it
+void thread_join(thread* thread);
+
+// Number of threads the machine can run at the same time, at least 1
+int thread_hardware_concurrency(void);
+
+typedef struct mutex mutex;
+typedef struct condition condition;
+
+mutex* mutex_create(void);
+void mutex_destroy(mutex* mutex);
+void mutex_lock(mutex* mutex);
+void mutex_unlock(mutex* mutex);
+
+condition* condition_create(void);
+void condition_destroy(condition* condition);
+// Atomically unlocks mutex and waits for a signal, mutex is locked again on return.
+// Wakeups can be spurious, so always wait in a loop that checks the actual condition.
+void condition_wait(condition* condition, mutex* mutex);
+void condition_signal(condition* condition);
+void condition_broadcast(condition* condition);
+
+#endif // THREAD_H
@@ -0,0 +1,10 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+// Set by CMake from the project version. Results of earlier runs that are reused (manifests of
+// incremental bulk runs) are only trusted if they were made by the same version.
+#ifndef XFS2JSON_VERSION
+#define XFS2JSON_VERSION "unknown"
+#endif
+
+#endif // VERSION_H
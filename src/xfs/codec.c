@@ -0,0 +1,55 @@
+#include "codec.h"
+#include "util/hash.h"
+
+#include <stddef.h>
+
+#if defined(XFS2JSON_HAS_GENERATED_CODECS)
+// Generated by xfs2json_codegen, sorted by dti hash and then signature
+extern const xfs_def_codec xfs_generated_codecs[];
+extern const size_t xfs_generated_codec_count;
+#else
+static const xfs_def_codec* const xfs_generated_codecs = NULL;
+static const size_t xfs_generated_codec_count = 0;
+#endif
+
+
+uint64_t xfs_def_codec_signature(const xfs_def* def) {
+    uint64_t hash = hash_fnv1a_u32(HASH_FNV_OFFSET_BASIS, def->dti_hash);
+    hash = hash_fnv1a_u32(hash, def->prop_count);
+    for (uint32_t i = 0; i < def->prop_count; i++) {
+        hash = hash_fnv1a_u32(hash, (uint32_t)def->props[i].type);
+    }
+
+    return hash;
+}
+
+const xfs_def_codec* xfs_def_codec_find(const xfs_def* def) {
+    if (xfs_generated_codec_count == 0) {
+        return NULL;
+    }
+
+    const uint64_t signature = xfs_def_codec_signature(def);
+    size_t low = 0;
+    size_t high = xfs_generated_codec_count;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        const xfs_def_codec* codec = &xfs_generated_codecs[mid];
+        if (codec->dti_hash == def->dti_hash && codec->signature == signature) {
+            return codec;
+        }
+
+        if (codec->dti_hash < def->dti_hash || (codec->dti_hash == def->dti_hash && codec->signature < signature)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return NULL;
+}
+
+void xfs_def_codec_attach(xfs* xfs) {
+    for (int32_t i = 0; i < xfs->header.def_count; i++) {
+        xfs->defs[i].codec = xfs_def_codec_find(&xfs->defs[i]);
+    }
+}
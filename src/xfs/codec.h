@@ -0,0 +1,100 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include "xfs.h"
+#include "xfs_pod.h"
+#include "util/binary_reader.h"
+#include "util/binary_writer.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Loading and saving code generated ahead of time for one definition by xfs2json_codegen
+// (src/tools/xfs_codegen.c), from schemas as written by bulk mode or the $defs of a converted file.
+// Its fields are unrolled with their types known at compile time, so plain values are read and
+// written directly instead of going through the type switches of xfs.c.
+//
+// Definitions of a loaded file get the codec generated for them, picked by dti hash and signature,
+// and everything else goes through the generic code. Without XFS2JSON_HAS_GENERATED_CODECS there
+// are no codecs and every definition is generic.
+typedef struct xfs_def_codec {
+    uint32_t dti_hash;
+    uint64_t signature; //< xfs_def_codec_signature of the definition the code was generated for
+    bool (*load)(xfs* xfs, xfs_object* obj, binary_reader* r); // Fills the fields of obj, false on failure
+    bool (*save)(const xfs* xfs, const xfs_object* obj, binary_writer* w); // Writes the fields of obj
+} xfs_def_codec;
+
+// Hash of everything the generated code depends on: the dti hash, the property count and the
+// property types. Definitions of different games can share a dti hash with different properties.
+uint64_t xfs_def_codec_signature(const xfs_def* def);
+
+// Codec generated for def, NULL if there is none
+const xfs_def_codec* xfs_def_codec_find(const xfs_def* def);
+
+// Sets the codec of every definition of xfs
+void xfs_def_codec_attach(xfs* xfs);
+
+
+// Used by the generated code, implemented in xfs.c
+
+// Loads the count values of a field following its count, the way the generic code does
+bool xfs_codec_load_values(xfs* xfs, const xfs_object* obj, xfs_field* field, uint32_t count, binary_reader* r);
+// Writes the count and the values of a field, the way the generic code does
+bool xfs_codec_save_values(const xfs* xfs, const xfs_field* field, binary_writer* w);
+// Zeroed array entries from the allocator of xfs, NULL (with a message) on failure
+xfs_data* xfs_codec_alloc_entries(xfs* xfs, uint32_t count);
+
+// Loads field index of obj, which the generated code calls with a constant type. Plain values
+// are read inline, everything else is handed to the generic code.
+static inline bool xfs_codec_load_field(xfs* xfs, xfs_object* obj, uint32_t index, xfs_type_t type, binary_reader* r) {
+    xfs_field* const field = &obj->fields[index];
+    field->name = obj->def->props[index].name;
+    field->type = type;
+
+    const uint32_t count = binary_reader_read_u32(r);
+    if (!xfs_pod_is_type(type)) {
+        return xfs_codec_load_values(xfs, obj, field, count, r);
+    }
+
+    if (count == 1) {
+        field->is_array = false;
+        xfs_pod_read(type, &field->data, r);
+        return true;
+    }
+
+    field->is_array = true;
+    field->data.array.count = count;
+    field->data.array.entries = xfs_codec_alloc_entries(xfs, count);
+    if (field->data.array.entries == NULL) {
+        return false;
+    }
+
+    for (uint32_t j = 0; j < count; j++) {
+        xfs_pod_read(type, &field->data.array.entries[j], r);
+    }
+
+    return true;
+}
+
+// Saves field index of obj, the counterpart of xfs_codec_load_field
+static inline bool xfs_codec_save_field(const xfs* xfs, const xfs_object* obj, uint32_t index, xfs_type_t type, binary_writer* w) {
+    const xfs_field* const field = &obj->fields[index];
+    if (!xfs_pod_is_type(type)) {
+        return xfs_codec_save_values(xfs, field, w);
+    }
+
+    if (field->is_array) {
+        binary_writer_write_s32(w, field->data.array.count);
+        for (uint32_t j = 0; j < field->data.array.count; j++) {
+            xfs_pod_write(&field->data.array.entries[j], type, w);
+        }
+    } else {
+        binary_writer_write_s32(w, 1);
+        xfs_pod_write(&field->data, type, w);
+    }
+
+    return true;
+}
+
+#endif // CODEC_H
@@ -1,150 +1,1133 @@
 #include "convert.h"
+#include "def_cache.h"
+#include "manifest.h"
+#include "result_cache.h"
+#include "schema.h"
+#include "shard.h"
+#include "table.h"
 #include "xfs.h"
+#include "util/json_reader.h"
+#include "util/json_writer.h"
+#include "util/arena.h"
+#include "util/file_map.h"
+#include "util/file_reader.h"
+#include "util/file_stream.h"
+#include "util/fs.h"
+#include "util/hash.h"
+#include "util/msgpack_reader.h"
+#include "util/msgpack_writer.h"
+#include "util/queue.h"
+#include "util/thread.h"
+#include "version.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <cJSON.h>
 #include <string.h>
 
+// Threads reading and writing files in bulk mode, next to the ones converting them. Reading ahead
+// and writing behind pays off most on network storage, where a file access is mostly waiting.
+#define CONVERT_IO_THREADS 4
 
-static bool xfs2json(const char* input, const char* output);
-static bool json2xfs(const char* input, const char* output);
-static bool convert_files(const char* input, const char* output);
-static bool str_endswith(const char* str, const char* suffix);
+// Spare arena blocks all jobs of a bulk run share, so the trees of a file are mostly built in
+// memory the previous files already faulted in
+#define CONVERT_ARENA_RETAIN_SIZE (64 * 1024 * 1024)
+
+// Print buffers a writing thread keeps from one file to the next
+#define CONVERT_PRINT_RETAIN_SIZE (16 * 1024 * 1024)
+
+// Files a reading thread reads together, up to as many as there are jobs free to take them
+#define CONVERT_READ_BATCH 8
+
+
+// A single file on its way through the conversion. In bulk mode jobs are handed from the reading
+// to the converting and on to the writing threads, and reused for another file afterwards.
+// The input buffer and the arenas the xfs and cJSON trees come out of are kept for the next file.
+typedef struct convert_job {
+    char* input; //< Free this
+    char* output; //< Free this
+    char* data; //< Free this. Contents of input, the buffer is kept for the next file
+    size_t data_size;
+    size_t data_capacity;
+    file_map* map; //< Destroy this. A single XFS file is mapped instead of read into data
+    util_fs_info input_info; //< State of input from before it was read, for the manifest
+    uint64_t input_hash; //< Contents of input as read, for the manifest
+
+    // XFS to JSON or MessagePack
+    xfs xfs;
+    bool has_xfs; //< xfs was loaded and has to be freed
+    arena* xfs_arena; //< Destroy this. Objects, fields and strings of xfs come out of it
+    arena* json_arena; //< Destroy this. Every node of json comes out of it
+    cJSON* json;
+    cJSON* defs; //< Part of json, written to a schema file in bulk mode
+    const cJSON* shards; //< Part of json, written to separate files
+    char schema_hash[XFS_SCHEMA_HASH_LENGTH + 1];
+
+    // JSON or MessagePack to XFS
+    xfs* result; //< Free this
+
+    uint64_t result_key; //< Key of the output in the result cache, if has_result_key
+    bool has_result_key; //< The output can be taken from and stored in the result cache
+    bool is_cached; //< The output was copied from the result cache, there's nothing to write
+} convert_job;
+
+static bool convert_job_read(convert_job* job);
+static bool convert_job_run(convert_job* job, const Args* args, int thread_count);
+static bool convert_job_write(convert_job* job, const Args* args, int thread_count, json_writer_buffers* buffers);
+static void convert_job_reset(convert_job* job);
+static void convert_job_destroy(convert_job* job);
+
+static bool xfs2json(convert_job* job, const Args* args);
+static bool json2xfs(convert_job* job, int thread_count);
+static bool msgpack2xfs(convert_job* job, int thread_count);
+static bool xfs2ndjson(const file_map* map, const char* input, const char* output, const Args* args);
+static bool xfs2tables(const file_map* map, const char* input, const char* output, const Args* args);
+static bool write_json(const cJSON* json, const char* output, const Args* args, int thread_count, json_writer_buffers* buffers);
+static bool write_msgpack(const cJSON* json, const char* output, const Args* args);
+static bool convert_files(const char* input, const char* output, const Args* args);
+static bool convert_directory(const Args* args);
+static bool resolve_schema(cJSON* json, const char* input);
+
+typedef struct ndjson_context {
+    file_stream* stream;
+    xfs_json_options options;
+} ndjson_context;
+
+static bool ndjson_write_line(file_stream* stream, cJSON* json);
+static bool ndjson_on_defs(const xfs* xfs, void* user_data);
+static bool ndjson_on_object(const xfs* xfs, const xfs_object* obj, const xfs_object_location* location, void* user_data);
+
+// Bulk conversion as three stages connected by queues: reading files ahead, converting them and
+// writing the results. A fixed set of jobs goes around, which bounds how far reading can get ahead.
+typedef struct convert_pipeline {
+    const Args* args;
+    char** names;
+    size_t name_count;
+    int thread_count; //< Threads a single conversion may use
+    mutex* lock;
+    size_t next_name; //< Guarded by lock
+    size_t failed; //< Guarded by lock
+    size_t readers_left; //< Guarded by lock, the last reader closes read_jobs
+    size_t converters_left; //< Guarded by lock, the last converter closes converted_jobs
+    queue* free_jobs;
+    queue* read_jobs;
+    queue* converted_jobs;
+    arena_pool* arenas; //< Blocks of the job arenas
+    xfs_manifest* manifest; //< Inputs of the last run, NULL unless the run is incremental
+    size_t unchanged; //< Guarded by lock
+} convert_pipeline;
+
+static void convert_pipeline_read(void* arg);
+static void convert_pipeline_convert(void* arg);
+static void convert_pipeline_write(void* arg);
+static void convert_pipeline_serial(convert_pipeline* pipeline, convert_job* job);
+
+static void json_arena_install(void);
+static void json_arena_uninstall(void);
+static void json_arena_begin(arena* arena);
+static void json_arena_end(void);
+
+// Definitions shared through schema files, loaded or written once per run
+static xfs_schema_cache* s_schema_cache = NULL;
+// Conversions running in parallel share the schema cache
+static mutex* s_schema_lock = NULL;
+// Parsed definitions shared by the XFS files of a bulk run or kept in the cache directory
+static xfs_def_cache* s_def_cache = NULL;
+// Outputs of earlier conversions, NULL unless a result cache directory was given
+static xfs_result_cache* s_result_cache = NULL;
 
 bool xfs_converter_run(const Args* args) {
     if (args == NULL) {
         return false;
     }
 
-    if (!args->is_bulk) {
-        return convert_files(args->input, args->output);
+    s_schema_cache = xfs_schema_cache_create();
+    s_schema_lock = mutex_create();
+    if (s_schema_cache == NULL || s_schema_lock == NULL) {
+        fprintf(stderr, "Failed to allocate memory for schema cache\n");
+        xfs_schema_cache_destroy(s_schema_cache);
+        mutex_destroy(s_schema_lock);
+        return false;
+    }
+
+    json_arena_install();
+
+    // Without the cache every file just parses its own definitions. A single file only gains
+    // from it when there's a cache directory from earlier runs.
+    s_def_cache = args->is_bulk || args->cache_dir != NULL ? xfs_def_cache_create(args->cache_dir) : NULL;
+    // Without it every file is converted, as usual
+    s_result_cache = args->result_cache_dir != NULL ? xfs_result_cache_create(args->result_cache_dir) : NULL;
+
+    const bool result = !args->is_bulk
+        ? convert_files(args->input, args->output, args)
+        : convert_directory(args);
+
+    json_arena_uninstall();
+
+    // Every job that could have shared definitions is gone by now
+    xfs_def_cache_destroy(s_def_cache);
+    s_def_cache = NULL;
+    xfs_result_cache_destroy(s_result_cache);
+    s_result_cache = NULL;
+
+    xfs_schema_cache_destroy(s_schema_cache);
+    mutex_destroy(s_schema_lock);
+    s_schema_cache = NULL;
+    s_schema_lock = NULL;
+
+    return result;
+}
+
+// Takes the next file of the directory that could be converted for job, without reading it yet.
+// Returns false once every file was taken.
+static bool convert_pipeline_take(convert_pipeline* pipeline, convert_job* job) {
+    const Args* args = pipeline->args;
+
+    for (;;) {
+        mutex_lock(pipeline->lock);
+        const size_t index = pipeline->next_name;
+        if (index < pipeline->name_count) {
+            pipeline->next_name++;
+        }
+        mutex_unlock(pipeline->lock);
+
+        if (index >= pipeline->name_count) {
+            return false;
+        }
+
+        const char* name = pipeline->names[index];
+        if (strcmp(name, XFS_MANIFEST_NAME) == 0) {
+            continue;
+        }
+
+        // Anything that isn't JSON or MessagePack might be XFS, which is only known once it is read
+        const char* output_extension = util_fs_has_extension(name, ".json") || util_fs_has_extension(name, ".msgpack")
+            ? "xfs"
+            : "json";
+
+        job->input = util_fs_join(args->input, name);
+        const int length = snprintf(NULL, 0, "%s/%s.%s", args->output, name, output_extension);
+        job->output = malloc(length + 1);
+        if (job->input != NULL && job->output != NULL) {
+            snprintf(job->output, length + 1, "%s/%s.%s", args->output, name, output_extension);
+            if (pipeline->manifest == NULL) {
+                return true;
+            }
+
+            // Inputs that can't be looked at are left to fail when they are read
+            if (!util_fs_get_info(job->input, &job->input_info)
+                || !xfs_manifest_is_unchanged(pipeline->manifest, name, job->input, job->output, &job->input_info)) {
+                return true;
+            }
+
+            mutex_lock(pipeline->lock);
+            pipeline->unchanged++;
+            mutex_unlock(pipeline->lock);
+            convert_job_reset(job);
+            continue;
+        }
+
+        mutex_lock(pipeline->lock);
+        pipeline->failed++;
+        mutex_unlock(pipeline->lock);
+        convert_job_reset(job);
+    }
+}
+
+// Fills the count jobs with the next files of the directory that can be converted, reading them
+// all in one batch. Returns how many jobs were filled, fewer than count once every file was taken.
+// The filled jobs are moved to the front, the others are left empty.
+static size_t convert_pipeline_next(convert_pipeline* pipeline, file_reader* reader, convert_job** jobs, size_t count) {
+    file_read_request requests[CONVERT_READ_BATCH];
+    size_t filled = 0;
+
+    while (filled < count) {
+        size_t taken = filled;
+        while (taken < count && taken - filled < CONVERT_READ_BATCH && convert_pipeline_take(pipeline, jobs[taken])) {
+            taken++;
+        }
+
+        if (taken == filled) {
+            break;
+        }
+
+        for (size_t i = filled; i < taken; i++) {
+            convert_job* job = jobs[i];
+            requests[i - filled] = (file_read_request){
+                .path = job->input,
+                .buffer = &job->data,
+                .capacity = &job->data_capacity,
+                .size = &job->data_size,
+            };
+        }
+
+        file_reader_read(reader, requests, taken - filled);
+
+        const size_t first = filled;
+        for (size_t i = first; i < taken; i++) {
+            convert_job* job = jobs[i];
+            if (!requests[i - first].result) {
+                mutex_lock(pipeline->lock);
+                pipeline->failed++;
+                mutex_unlock(pipeline->lock);
+                convert_job_reset(job);
+                continue;
+            }
+
+            // Converting may change the data in place, JSON is parsed in situ
+            if (pipeline->manifest != NULL) {
+                job->input_hash = xfs_manifest_hash(job->data, job->data_size);
+            }
+
+            // Files that turn out not to be XFS either are skipped, like they always were
+            const bool is_xfs_output = util_fs_has_extension(job->output, ".xfs");
+            if (!is_xfs_output && !is_xfs_buffer(job->data, job->data_size)) {
+                convert_job_reset(job);
+                continue;
+            }
+
+            jobs[i] = jobs[filled];
+            jobs[filled++] = job;
+        }
+    }
+
+    return filled;
+}
+
+// Counts a finished stage thread, the last one of a stage closes the queue it feeds
+static void convert_pipeline_leave(convert_pipeline* pipeline, size_t* threads_left, queue* output) {
+    mutex_lock(pipeline->lock);
+    const bool is_last = --*threads_left == 0;
+    mutex_unlock(pipeline->lock);
+
+    if (is_last) {
+        queue_close(output);
+    }
+}
+
+// Reports a converted file and records its input for the next run
+static void convert_pipeline_done(convert_pipeline* pipeline, const convert_job* job) {
+    fprintf(stdout, "Converted %s to %s\n", job->input, job->output);
+    if (pipeline->manifest != NULL) {
+        xfs_manifest_record(pipeline->manifest, util_fs_get_filename(job->input), &job->input_info, job->input_hash);
+    }
+}
+
+static void convert_pipeline_fail(convert_pipeline* pipeline, convert_job* job) {
+    mutex_lock(pipeline->lock);
+    pipeline->failed++;
+    mutex_unlock(pipeline->lock);
+
+    convert_job_reset(job);
+    queue_push(pipeline->free_jobs, job);
+}
+
+void convert_pipeline_read(void* arg) {
+    convert_pipeline* pipeline = (convert_pipeline*)arg;
+    file_reader* reader = file_reader_create(CONVERT_READ_BATCH);
+
+    // Takes every free job there is, up to a batch, so their files are read together
+    convert_job* batch[CONVERT_READ_BATCH];
+    void* item = NULL;
+    while (queue_pop(pipeline->free_jobs, &item)) {
+        size_t count = 0;
+        batch[count++] = (convert_job*)item;
+        while (count < CONVERT_READ_BATCH && queue_try_pop(pipeline->free_jobs, &item)) {
+            batch[count++] = (convert_job*)item;
+        }
+
+        const size_t filled = convert_pipeline_next(pipeline, reader, batch, count);
+        for (size_t i = 0; i < filled; i++) {
+            queue_push(pipeline->read_jobs, batch[i]);
+        }
+
+        if (filled < count) {
+            // Wakes up the other readers waiting for a job as well, there's nothing left for them
+            queue_close(pipeline->free_jobs);
+            break;
+        }
+    }
+
+    file_reader_destroy(reader);
+    convert_pipeline_leave(pipeline, &pipeline->readers_left, pipeline->read_jobs);
+}
+
+void convert_pipeline_convert(void* arg) {
+    convert_pipeline* pipeline = (convert_pipeline*)arg;
+
+    void* item = NULL;
+    while (queue_pop(pipeline->read_jobs, &item)) {
+        convert_job* job = (convert_job*)item;
+        if (convert_job_run(job, pipeline->args, pipeline->thread_count)) {
+            queue_push(pipeline->converted_jobs, job);
+        } else {
+            convert_pipeline_fail(pipeline, job);
+        }
+    }
+
+    convert_pipeline_leave(pipeline, &pipeline->converters_left, pipeline->converted_jobs);
+}
+
+void convert_pipeline_write(void* arg) {
+    convert_pipeline* pipeline = (convert_pipeline*)arg;
+    // Without them every file is printed into freshly allocated buffers
+    json_writer_buffers* buffers = json_writer_buffers_create(CONVERT_PRINT_RETAIN_SIZE);
+
+    void* item = NULL;
+    while (queue_pop(pipeline->converted_jobs, &item)) {
+        convert_job* job = (convert_job*)item;
+        if (!convert_job_write(job, pipeline->args, pipeline->thread_count, buffers)) {
+            convert_pipeline_fail(pipeline, job);
+            continue;
+        }
+
+        convert_pipeline_done(pipeline, job);
+        convert_job_reset(job);
+        queue_push(pipeline->free_jobs, job);
+    }
+
+    json_writer_buffers_destroy(buffers);
+}
+
+// Fallback for when the stage threads can't be started, converts the remaining files one by one
+void convert_pipeline_serial(convert_pipeline* pipeline, convert_job* job) {
+    file_reader* reader = file_reader_create(1);
+    json_writer_buffers* buffers = json_writer_buffers_create(CONVERT_PRINT_RETAIN_SIZE);
+    while (convert_pipeline_next(pipeline, reader, &job, 1) != 0) {
+        if (convert_job_run(job, pipeline->args, pipeline->args->jobs) && convert_job_write(job, pipeline->args, pipeline->args->jobs, buffers)) {
+            convert_pipeline_done(pipeline, job);
+        } else {
+            mutex_lock(pipeline->lock);
+            pipeline->failed++;
+            mutex_unlock(pipeline->lock);
+        }
+
+        convert_job_reset(job);
+    }
+
+    json_writer_buffers_destroy(buffers);
+    file_reader_destroy(reader);
+}
+
+// Starts count threads running func, returns how many of them could be started
+static size_t convert_pipeline_start(thread** threads, size_t count, thread_func func, convert_pipeline* pipeline) {
+    size_t started = 0;
+    for (size_t i = 0; i < count; i++) {
+        threads[i] = thread_create(func, pipeline);
+        started += threads[i] != NULL ? 1 : 0;
+    }
+
+    return started;
+}
+
+static void convert_pipeline_join(thread** threads, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (threads[i] != NULL) {
+            thread_join(threads[i]);
+        }
+    }
+}
+
+// Hash of everything about a run that changes the files it writes
+static uint64_t convert_options_hash(const Args* args) {
+    uint64_t hash = hash_fnv1a_u32(HASH_FNV_OFFSET_BASIS, args->minify ? 1 : 0);
+    hash = hash_fnv1a_u32(hash, args->pack_min_count);
+    hash = hash_fnv1a_u32(hash, args->dedup ? 1 : 0);
+    return hash_fnv1a_u32(hash, args->shard_count > 1 ? args->shard_count : 1);
+}
+
+bool convert_directory(const Args* args) {
+    // The list is taken before converting anything, so files written here aren't picked up again
+    size_t count = 0;
+    char** names = util_fs_list_files(args->input, &count);
+    if (names == NULL) {
+        fprintf(stderr, "Failed to read input directory: %s\n", args->input);
+        return false;
+    }
+
+    // Files are converted in parallel, so a conversion only gets the threads nobody else uses
+    const size_t file_count = count != 0 ? count : 1;
+    const size_t reader_count = file_count < CONVERT_IO_THREADS ? file_count : CONVERT_IO_THREADS;
+    const size_t writer_count = reader_count;
+    const size_t converter_count = file_count < (size_t)args->jobs ? file_count : (size_t)args->jobs;
+    const size_t job_count = reader_count + 2 * converter_count + writer_count;
+
+    convert_pipeline pipeline = {
+        .args = args,
+        .names = names,
+        .name_count = count,
+        .thread_count = args->jobs / (int)converter_count > 1 ? args->jobs / (int)converter_count : 1,
+        .lock = mutex_create(),
+        .readers_left = reader_count,
+        .converters_left = converter_count,
+        .free_jobs = queue_create(job_count),
+        .read_jobs = queue_create(job_count),
+        .converted_jobs = queue_create(job_count),
+        .arenas = arena_pool_create(ARENA_BLOCK_SIZE, CONVERT_ARENA_RETAIN_SIZE),
+        .manifest = args->incremental ? xfs_manifest_load(args->output, XFS2JSON_VERSION, convert_options_hash(args)) : NULL,
+    };
+
+    convert_job* jobs = calloc(job_count, sizeof(convert_job));
+    thread** threads = calloc(reader_count + converter_count + writer_count, sizeof(thread*));
+
+    bool has_arenas = jobs != NULL && pipeline.arenas != NULL;
+    for (size_t i = 0; has_arenas && i < job_count; i++) {
+        jobs[i].xfs_arena = arena_create_pooled(pipeline.arenas);
+        jobs[i].json_arena = arena_create_pooled(pipeline.arenas);
+        has_arenas = jobs[i].xfs_arena != NULL && jobs[i].json_arena != NULL;
+    }
+
+    if (pipeline.lock == NULL || pipeline.free_jobs == NULL || pipeline.read_jobs == NULL || pipeline.converted_jobs == NULL || jobs == NULL || threads == NULL || !has_arenas
+        || (args->incremental && pipeline.manifest == NULL)) {
+        fprintf(stderr, "Failed to allocate memory for converting %s\n", args->input);
+        pipeline.failed = count;
     } else {
-        // Walk directory, convert each file
+        for (size_t i = 0; i < job_count; i++) {
+            queue_push(pipeline.free_jobs, &jobs[i]);
+        }
+
+        thread** const readers = threads;
+        thread** const converters = threads + reader_count;
+        thread** const writers = converters + converter_count;
+
+        // Stages are started from the end, so every stage has someone to hand its jobs to
+        const size_t started_writers = convert_pipeline_start(writers, writer_count, convert_pipeline_write, &pipeline);
+        const size_t started_converters = started_writers != 0
+            ? convert_pipeline_start(converters, converter_count, convert_pipeline_convert, &pipeline)
+            : 0;
+
+        if (started_converters == 0) {
+            queue_close(pipeline.converted_jobs);
+            convert_pipeline_join(writers, writer_count);
+            convert_pipeline_serial(&pipeline, &jobs[0]);
+        } else {
+            for (size_t i = started_converters; i < converter_count; i++) {
+                convert_pipeline_leave(&pipeline, &pipeline.converters_left, pipeline.converted_jobs);
+            }
+
+            // The calling thread reads as well, which also covers readers that couldn't be started
+            const size_t started_readers = convert_pipeline_start(readers + 1, reader_count - 1, convert_pipeline_read, &pipeline);
+            for (size_t i = started_readers; i < reader_count - 1; i++) {
+                convert_pipeline_leave(&pipeline, &pipeline.readers_left, pipeline.read_jobs);
+            }
+
+            convert_pipeline_read(&pipeline);
+
+            convert_pipeline_join(readers + 1, reader_count - 1);
+            convert_pipeline_join(converters, converter_count);
+            convert_pipeline_join(writers, writer_count);
+        }
+    }
+
+    for (size_t i = 0; jobs != NULL && i < job_count; i++) {
+        convert_job_destroy(&jobs[i]);
+    }
+
+    // Failed inputs aren't recorded, the next run tries them again
+    if (pipeline.manifest != NULL && !xfs_manifest_save(pipeline.manifest)) {
+        fprintf(stderr, "Failed to write the manifest to %s\n", args->output);
+    }
+
+    if (pipeline.unchanged != 0) {
+        fprintf(stdout, "Skipped %zu unchanged files\n", pipeline.unchanged);
+    }
+
+    xfs_manifest_destroy(pipeline.manifest);
+    free(jobs);
+    free(threads);
+    arena_pool_destroy(pipeline.arenas);
+    queue_destroy(pipeline.free_jobs);
+    queue_destroy(pipeline.read_jobs);
+    queue_destroy(pipeline.converted_jobs);
+    mutex_destroy(pipeline.lock);
+    util_fs_free_list(names, count);
+
+    if (pipeline.failed != 0) {
+        fprintf(stderr, "Failed to convert %zu of %zu files in %s\n", pipeline.failed, count, args->input);
+        return false;
     }
 
     return true;
 }
 
-bool xfs2json(const char* input, const char* output) {
-    xfs xfs;
-    if (xfs_load(input, &xfs) != XFS_RESULT_OK) {
-        fprintf(stderr, "Failed to load XFS file: %s\n", input);
+bool convert_job_read(convert_job* job) {
+    // Compressed input is decompressed here already
+    return file_read_into(job->input, &job->data, &job->data_capacity, &job->data_size);
+}
+
+// Everything the output of job depends on besides the options, for the result cache
+static uint64_t convert_result_key(const convert_job* job, const Args* args) {
+    const uint8_t* const data = job->map != NULL ? job->map->data : (const uint8_t*)job->data;
+    const size_t size = job->map != NULL ? job->map->size : job->data_size;
+
+    uint64_t hash = hash_fnv1a(HASH_FNV_OFFSET_BASIS, XFS2JSON_VERSION, strlen(XFS2JSON_VERSION));
+    hash = hash_fnv1a_u64(hash, convert_options_hash(args));
+    // JSON written in bulk mode refers to a schema instead of holding the definitions
+    hash = hash_fnv1a_u32(hash, args->is_bulk ? 1 : 0);
+    hash = hash_fnv1a_u32(hash, util_fs_has_extension(job->output, ".msgpack") ? 1 : 0);
+    hash = hash_fnv1a_u32(hash, (uint32_t)file_compression_from_path(job->output));
+    hash = hash_fnv1a_u64(hash, size);
+    return hash_fnv1a(hash, data, size);
+}
+
+// Stores the output that was just written in the result cache
+static void convert_job_store(const convert_job* job, const Args* args) {
+    if (job->has_result_key) {
+        xfs_result_cache_store(s_result_cache, job->result_key, job->output, args->output, job->defs != NULL ? job->schema_hash : NULL);
+    }
+}
+
+// Path to write output to. With --keep-unchanged that's a file next to it, which convert_finish_output
+// only moves over output if they differ. NULL if out of memory.
+static char* convert_begin_output(const char* output, const Args* args) {
+    return args->keep_unchanged ? util_fs_temp_path(output) : (char*)output;
+}
+
+// Finishes writing to the path from convert_begin_output, written tells whether that succeeded
+static bool convert_finish_output(char* path, const char* output, bool written) {
+    if (path == output) {
+        return written;
+    }
+
+    if (written && !util_fs_replace_if_changed(path, output)) {
+        fprintf(stderr, "Failed to replace output file: %s\n", output);
+        written = false;
+    }
+
+    if (!written && path != NULL) {
+        remove(path);
+    }
+
+    free(path);
+
+    return written;
+}
+
+bool convert_job_run(convert_job* job, const Args* args, int thread_count) {
+    // Sharded output is more than one file. The key is taken before converting, JSON is parsed in place.
+    if (s_result_cache != NULL && args->shard_count <= 1) {
+        job->result_key = convert_result_key(job, args);
+        job->has_result_key = true;
+
+        char* const path = convert_begin_output(job->output, args);
+        const bool fetched = path != NULL
+            && xfs_result_cache_fetch(s_result_cache, job->result_key, path, args->is_bulk ? args->output : NULL);
+        if (convert_finish_output(path, job->output, fetched)) {
+            job->is_cached = true;
+            return true;
+        }
+    }
+
+    if (util_fs_has_extension(job->input, ".json")) {
+        return json2xfs(job, thread_count);
+    }
+
+    if (util_fs_has_extension(job->input, ".msgpack")) {
+        return msgpack2xfs(job, thread_count);
+    }
+
+    return xfs2json(job, args);
+}
+
+// buffers are the print buffers of the calling thread, NULL if it only writes this one file
+bool convert_job_write(convert_job* job, const Args* args, int thread_count, json_writer_buffers* buffers) {
+    if (job->is_cached) {
+        return true;
+    }
+
+    if (job->result != NULL) {
+        char* const path = convert_begin_output(job->output, args);
+        if (!convert_finish_output(path, job->output, path != NULL && xfs_save(path, job->result) == XFS_RESULT_OK)) {
+            fprintf(stderr, "Failed to save XFS file: %s\n", job->output);
+            return false;
+        }
+
+        convert_job_store(job, args);
+        return true;
+    }
+
+    bool written = true;
+    if (job->defs != NULL) {
+        const json_writer_options options = {
+            .indent = args->minify ? 0 : 2,
+            .thread_count = 1,
+            .buffers = buffers,
+        };
+
+        mutex_lock(s_schema_lock);
+        written = xfs_schema_cache_store(s_schema_cache, args->output, job->schema_hash, job->defs, &options);
+        mutex_unlock(s_schema_lock);
+        if (!written) {
+            fprintf(stderr, "Failed to write schema %s to %s\n", job->schema_hash, args->output);
+        }
+    }
+
+    if (written && job->shards != NULL) {
+        const json_writer_options options = {
+            .indent = args->minify ? 0 : 2,
+            .thread_count = thread_count,
+            .compression = file_compression_from_path(job->output),
+            .buffers = buffers,
+            .keep_unchanged = args->keep_unchanged,
+        };
+
+        written = xfs_shard_write(job->shards, job->output, &options);
+    }
+
+    if (written) {
+        written = util_fs_has_extension(job->output, ".msgpack")
+            ? write_msgpack(job->json, job->output, args)
+            : write_json(job->json, job->output, args, thread_count, buffers);
+    }
+
+    if (written) {
+        convert_job_store(job, args);
+    }
+
+    return written;
+}
+
+// Frees everything that belongs to the file of the job, except for the buffer it was read into and the arenas
+void convert_job_reset(convert_job* job) {
+    // The tree references names and strings of the xfs, so it goes first
+    arena_reset(job->json_arena);
+
+    if (job->has_xfs) {
+        xfs_free(&job->xfs);
+        arena_reset(job->xfs_arena);
+    }
+
+    if (job->result != NULL) {
+        xfs_free(job->result);
+        free(job->result);
+    }
+
+    file_map_destroy(job->map);
+    free(job->input);
+    free(job->output);
+
+    const convert_job kept = {
+        .data = job->data,
+        .data_capacity = job->data_capacity,
+        .xfs_arena = job->xfs_arena,
+        .json_arena = job->json_arena,
+    };
+
+    *job = kept;
+}
+
+// Frees what the job kept for the next file as well
+void convert_job_destroy(convert_job* job) {
+    convert_job_reset(job);
+
+    free(job->data);
+    arena_destroy(job->xfs_arena);
+    arena_destroy(job->json_arena);
+    memset(job, 0, sizeof(convert_job));
+}
+
+// XFS output other than plain JSON can only be written for a single file
+static bool xfs_output_is_supported(const char* output, const Args* args) {
+    if (args->shard_count > 1 && !util_fs_has_extension(output, ".json")) {
+        fprintf(stderr, "Sharded output is only supported for JSON: %s\n", output);
         return false;
     }
 
-    cJSON* const json = xfs_to_json(&xfs);
-    char* const json_str = cJSON_Print(json, 2);
+    return true;
+}
 
-    FILE* const file = fopen(output, "w");
-    if (file == NULL) {
-        fprintf(stderr, "Failed to open output file: %s\n", output);
-        cJSON_Delete(json);
-        free(json_str);
-        xfs_free(&xfs);
+bool xfs2json(convert_job* job, const Args* args) {
+    const uint8_t* const data = job->map != NULL ? job->map->data : (const uint8_t*)job->data;
+    const size_t size = job->map != NULL ? job->map->size : job->data_size;
+    // Both trees come out of arenas that are reset instead of freeing them node by node.
+    // The cJSON tree references names and strings of the xfs tree, so that has to outlive it.
+    // Bulk jobs get theirs from the pipeline, a single file only needs them once.
+    if (job->xfs_arena == NULL) {
+        job->xfs_arena = arena_create(ARENA_BLOCK_SIZE);
+    }
+
+    if (job->json_arena == NULL) {
+        job->json_arena = arena_create(ARENA_BLOCK_SIZE);
+    }
+
+    if (job->xfs_arena == NULL || job->json_arena == NULL) {
+        fprintf(stderr, "Failed to allocate memory for XFS and JSON trees\n");
         return false;
     }
 
-    if (fwrite(json_str, sizeof(char), strlen(json_str), file) != strlen(json_str)) {
-        fprintf(stderr, "Failed to write to output file: %s\n", output);
-        fclose(file);
-        cJSON_Delete(json);
-        free(json_str);
-        xfs_free(&xfs);
+    if (xfs_load_buffer_arena(data, size, job->input, job->xfs_arena, s_def_cache, &job->xfs) != XFS_RESULT_OK) {
+        fprintf(stderr, "Failed to load XFS file: %s\n", job->input);
+        arena_reset(job->xfs_arena);
         return false;
     }
 
-    fclose(file);
+    job->has_xfs = true;
+
+    json_arena_begin(job->json_arena);
+    const xfs_json_options json_options = {
+        .pack_min_count = args->pack_min_count,
+        .dedup = args->dedup,
+    };
+
+    job->json = xfs_to_json(&job->xfs, &json_options);
+
+    // In bulk mode the definitions go to a schema file shared by every file that has the same ones
+    if (args->is_bulk) {
+        xfs_schema_hash(&job->xfs, job->schema_hash);
+        job->defs = cJSON_DetachItemFromObjectCaseSensitive(job->json, "$defs");
+        cJSON_AddStringToObject(job->json, "$schema", job->schema_hash);
+    }
+
+    // The largest array of objects in the root goes to separate files, json becomes their manifest
+    if (args->shard_count > 1) {
+        job->shards = xfs_shard_split(&job->xfs, job->json, args->shard_count, job->output);
+        if (job->shards == NULL) {
+            fprintf(stderr, "%s has no array of objects to shard, writing a single file\n", job->input);
+        }
+    }
+
+    json_arena_end();
+
+    return true;
+}
+
+bool write_json(const cJSON* json, const char* output, const Args* args, int thread_count, json_writer_buffers* buffers) {
+    const json_writer_options options = {
+        .indent = args->minify ? 0 : 2,
+        .thread_count = thread_count,
+        .compression = file_compression_from_path(output),
+        .buffers = buffers,
+        .keep_unchanged = args->keep_unchanged,
+    };
+
+    return json_writer_write_file(output, json, &options);
+}
+
+bool write_msgpack(const cJSON* json, const char* output, const Args* args) {
+    const msgpack_writer_options options = {
+        .compression = file_compression_from_path(output),
+        .keep_unchanged = args->keep_unchanged,
+    };
+
+    return msgpack_writer_write_file(output, json, &options);
+}
+
+bool ndjson_write_line(file_stream* stream, cJSON* json) {
+    char* const line = cJSON_PrintUnformatted(json);
     cJSON_Delete(json);
-    free(json_str);
+    if (line == NULL) {
+        return false;
+    }
+
+    // Write errors are reported once the stream is closed
+    file_stream_write(stream, line, strlen(line));
+    file_stream_write(stream, "\n", 1);
+    free(line);
+
+    return true;
+}
+
+bool ndjson_on_defs(const xfs* xfs, void* user_data) {
+    const ndjson_context* context = (const ndjson_context*)user_data;
+    return ndjson_write_line(context->stream, xfs_defs_to_json(xfs));
+}
+
+bool ndjson_on_object(const xfs* xfs, const xfs_object* obj, const xfs_object_location* location, void* user_data) {
+    (void)xfs;
+    const ndjson_context* context = (const ndjson_context*)user_data;
+    return ndjson_write_line(context->stream, xfs_stream_object_to_json(obj, location, &context->options));
+}
+
+bool xfs2ndjson(const file_map* map, const char* input, const char* output, const Args* args) {
+    char* const path = convert_begin_output(output, args);
+    file_stream* const stream = path != NULL ? file_stream_create(path, file_compression_from_path(output)) : NULL;
+    if (stream == NULL) {
+        convert_finish_output(path, output, false);
+        return false;
+    }
+
+    ndjson_context context = {
+        .stream = stream,
+        .options = {
+            .pack_min_count = args->pack_min_count,
+        },
+    };
+
+    // One line with the definitions, then one per object in the order they finish decoding
+    const xfs_load_visitor visitor = {
+        .on_defs = ndjson_on_defs,
+        .on_object = ndjson_on_object,
+        .user_data = &context,
+    };
+
+    xfs xfs;
+    if (xfs_load_stream_buffer(map->data, map->size, input, &xfs, &visitor) != XFS_RESULT_OK) {
+        fprintf(stderr, "Failed to convert XFS file: %s\n", input);
+        file_stream_close(stream);
+        convert_finish_output(path, output, false);
+        return false;
+    }
+
     xfs_free(&xfs);
 
+    if (!file_stream_close(stream)) {
+        fprintf(stderr, "Failed to write to output file: %s\n", output);
+        convert_finish_output(path, output, false);
+        return false;
+    }
+
+    if (!convert_finish_output(path, output, true)) {
+        return false;
+    }
+
     fprintf(stdout, "Converted %s to %s\n", input, output);
 
     return true;
 }
 
-bool json2xfs(const char* input, const char* output) {
-    FILE* file = fopen(input, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Failed to open input file: %s\n", input);
+bool xfs2tables(const file_map* map, const char* input, const char* output, const Args* args) {
+    xfs_table_set* const tables = xfs_table_set_create();
+    if (tables == NULL) {
+        fprintf(stderr, "Failed to allocate memory for tables\n");
         return false;
     }
 
-    fseek(file, 0, SEEK_END);
-    const size_t file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    // Rows are filled while the file is being read, the objects themselves aren't kept
+    const xfs_load_visitor visitor = {
+        .on_defs = xfs_table_on_defs,
+        .on_object = xfs_table_on_object,
+        .user_data = tables,
+    };
 
-    char* data = (char*)malloc(file_size + 1);
-    if (data == NULL) {
-        fprintf(stderr, "Failed to allocate memory for input file data\n");
-        fclose(file);
+    xfs xfs;
+    if (xfs_load_stream_buffer(map->data, map->size, input, &xfs, &visitor) != XFS_RESULT_OK) {
+        fprintf(stderr, "Failed to convert XFS file: %s\n", input);
+        xfs_table_set_destroy(tables);
         return false;
     }
 
-    fread(data, sizeof(char), file_size, file);
+    xfs_free(&xfs);
 
-    cJSON* json = cJSON_ParseWithLength(data, file_size);
+    const bool written = xfs_table_set_write(tables, output, args->keep_unchanged);
+    xfs_table_set_destroy(tables);
+    if (!written) {
+        return false;
+    }
+
+    fprintf(stdout, "Converted %s to %s\n", input, output);
+
+    return true;
+}
+
+bool json2xfs(convert_job* job, int thread_count) {
+    // Strings and numbers in json point into the input data, so it has to outlive json
+    cJSON* json = json_reader_parse(job->data, job->data_size);
     if (json == NULL) {
-        fprintf(stderr, "Failed to parse JSON file: %s\n", input);
-        free(data);
-        fclose(file);
+        fprintf(stderr, "Failed to parse JSON file: %s\n", job->input);
         return false;
     }
 
-    xfs* xfs = xfs_from_json(json);
-    if (xfs == NULL) {
-        fprintf(stderr, "Failed to convert JSON to XFS\n");
+    if (!resolve_schema(json, job->input)) {
         cJSON_Delete(json);
-        free(data);
-        fclose(file);
         return false;
     }
 
-    if (xfs_save(output, xfs) != XFS_RESULT_OK) {
-        fprintf(stderr, "Failed to save XFS file: %s\n", output);
-        xfs_free(xfs);
-        free(xfs);
+    // Elements of sharded arrays are moved into json, their strings stay in the shard set
+    xfs_shard_set* shards = xfs_shard_join(json, job->input, thread_count);
+    if (shards == NULL) {
+        fprintf(stderr, "Failed to read the shards of %s\n", job->input);
         cJSON_Delete(json);
-        free(data);
-        fclose(file);
         return false;
     }
 
-    xfs_free(xfs);
-    free(xfs);
+    // The output depends on the shard files as well, which the key doesn't cover
+    if (xfs_shard_set_count(shards) != 0) {
+        job->has_result_key = false;
+    }
+
+    const xfs_json_options json_options = {
+        .thread_count = thread_count,
+    };
+
+    // The xfs borrows its strings from the input data and takes ownership of it, the tree isn't needed after this
+    job->result = xfs_from_json_buffer(json, job->data, job->data_size, &json_options);
     cJSON_Delete(json);
-    free(data);
-    fclose(file);
+    xfs_shard_set_destroy(shards);
+    if (job->result == NULL) {
+        // The data went with the failed xfs
+        job->data = NULL;
+        job->data_capacity = 0;
+        fprintf(stderr, "Failed to convert JSON to XFS\n");
+        return false;
+    }
 
-    fprintf(stdout, "Converted %s to %s\n", input, output);
+    // The job hands the data on to the next file once the xfs is written, so it keeps ownership
+    job->result->owns_string_buffer = false;
+
+    return true;
+}
+
+bool msgpack2xfs(convert_job* job, int thread_count) {
+    // Decoded strings never take more space than the encoded document
+    char* strings = (char*)malloc(job->data_size + 1);
+    if (strings == NULL) {
+        fprintf(stderr, "Failed to allocate memory for input file data\n");
+        return false;
+    }
+
+    cJSON* json = msgpack_reader_parse((const uint8_t*)job->data, job->data_size, strings);
+    if (json == NULL) {
+        fprintf(stderr, "Failed to parse MessagePack file: %s\n", job->input);
+        free(strings);
+        return false;
+    }
+
+    if (!resolve_schema(json, job->input)) {
+        cJSON_Delete(json);
+        free(strings);
+        return false;
+    }
+
+    const xfs_json_options json_options = {
+        .thread_count = thread_count,
+    };
+
+    // Same as for JSON, the xfs borrows its strings and takes ownership of them
+    job->result = xfs_from_json_buffer(json, strings, job->data_size + 1, &json_options);
+    cJSON_Delete(json);
+    if (job->result == NULL) {
+        fprintf(stderr, "Failed to convert MessagePack to XFS\n");
+        return false;
+    }
 
     return true;
 }
 
-bool convert_files(const char* input, const char* output) {
-    if (str_endswith(input, ".json")) {
-        return json2xfs(input, output);
+bool convert_files(const char* input, const char* output, const Args* args) {
+    const bool is_xfs_output = util_fs_has_extension(input, ".json") || util_fs_has_extension(input, ".msgpack");
+    if (is_xfs_output && file_compression_from_path(output) != FILE_COMPRESSION_NONE) {
+        // xfs_save seeks back to patch sizes, which a compressed stream can't do
+        fprintf(stderr, "Compressed XFS output is not supported: %s\n", output);
+        return false;
     }
 
-    if (is_xfs_file(input)) {
-        return xfs2json(input, output);
+    // The file is opened once, its format is told from the mapping it is loaded from afterwards
+    file_map* map = NULL;
+    if (!is_xfs_output) {
+        map = file_map_create(input);
+        if (map == NULL) {
+            fprintf(stderr, "Failed to open input file: %s\n", input);
+            return false;
+        }
+
+        if (!is_xfs_buffer(map->data, map->size)) {
+            fprintf(stderr, "Input file %s is neither JSON, MessagePack nor XFS.", input);
+            file_map_destroy(map);
+            return false;
+        }
+
+        if (!xfs_output_is_supported(output, args)) {
+            file_map_destroy(map);
+            return false;
+        }
+
+        // Both are written while the file is being read instead of going through a JSON tree
+        const bool is_ndjson = util_fs_has_extension(output, ".ndjson");
+        if (is_ndjson || util_fs_has_extension(output, XFS_TABLE_DIR_EXTENSION)) {
+            const bool converted = is_ndjson
+                ? xfs2ndjson(map, input, output, args)
+                : xfs2tables(map, input, output, args);
+            file_map_destroy(map);
+            return converted;
+        }
     }
 
-    fprintf(stderr, "Input file %s is neither JSON nor XFS.", input);
-    return false;
+    convert_job job = { 0 };
+    job.input = strdup(input);
+    job.output = strdup(output);
+    job.map = map;
+
+    const bool result = job.input != NULL && job.output != NULL
+        && (job.map != NULL || convert_job_read(&job))
+        && convert_job_run(&job, args, args->jobs)
+        && convert_job_write(&job, args, args->jobs, NULL);
+
+    if (result) {
+        fprintf(stdout, "Converted %s to %s\n", input, output);
+    }
+
+    convert_job_destroy(&job);
+
+    return result;
 }
 
-static bool str_endswith(const char* str, const char* suffix) {
-    if (str == NULL || suffix == NULL) {
+// Files written with a shared schema get the "$defs" of the schema file next to them
+bool resolve_schema(cJSON* json, const char* input) {
+    const cJSON* schema = cJSON_GetObjectItem(json, "$schema");
+    if (schema == NULL || cJSON_HasObjectItem(json, "$defs")) {
+        return true;
+    }
+
+    if (!cJSON_IsString(schema)) {
+        fprintf(stderr, "Invalid $schema in %s\n", input);
         return false;
     }
 
-    const size_t str_len = strlen(str);
-    const size_t suffix_len = strlen(suffix);
-    if (str_len < suffix_len) {
+    char* dir = util_fs_get_dir(input);
+    if (dir == NULL) {
         return false;
     }
 
-    return strcmp(str + str_len - suffix_len, suffix) == 0;
+    mutex_lock(s_schema_lock);
+    const cJSON* defs = xfs_schema_cache_load(s_schema_cache, dir, cJSON_GetStringValue(schema));
+    mutex_unlock(s_schema_lock);
+    free(dir);
+
+    if (defs == NULL) {
+        fprintf(stderr, "Failed to load schema %s for %s\n", cJSON_GetStringValue(schema), input);
+        return false;
+    }
+
+    // Only referenced, the cache keeps the schema alive for the whole run
+    cJSON_AddItemReferenceToObject(json, "$defs", (cJSON*)defs);
+
+    return true;
+}
+
+// Arena the cJSON nodes of the calling thread come from, NULL while nodes are allocated normally
+static THREAD_LOCAL arena* s_json_arena = NULL;
+
+static void* json_arena_malloc(size_t size) {
+    return s_json_arena != NULL ? arena_alloc(s_json_arena, size) : malloc(size);
+}
+
+static void json_arena_free(void* ptr) {
+    // Nodes of an arena are released all at once with it
+    if (s_json_arena == NULL) {
+        free(ptr);
+    }
+}
+
+void json_arena_install(void) {
+    // The hooks are shared by every thread, so they stay for the whole run and each thread picks
+    // its own arena. Nodes are only ever freed on the thread and in the mode they were allocated in.
+    cJSON_Hooks hooks = {
+        .malloc_fn = json_arena_malloc,
+        .free_fn = json_arena_free,
+    };
+
+    cJSON_InitHooks(&hooks);
+}
+
+void json_arena_uninstall(void) {
+    cJSON_InitHooks(NULL);
+}
+
+void json_arena_begin(arena* arena) {
+    s_json_arena = arena;
+}
+
+void json_arena_end(void) {
+    // Printing allocates normally again, its buffer is handed to the caller
+    s_json_arena = NULL;
 }
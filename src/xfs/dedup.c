@@ -0,0 +1,283 @@
+#include "dedup.h"
+#include "util/hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+typedef struct xfs_dedup_group {
+    uint64_t hash;
+    uint32_t count; //< Subtrees with this hash, 0 for an empty slot
+    uint32_t index;
+    const xfs_object* first; //< The one written with "$index", NULL until it is visited
+} xfs_dedup_group;
+
+typedef struct xfs_dedup_entry {
+    const xfs_object* obj; //< NULL for an empty slot
+    size_t group;
+} xfs_dedup_entry;
+
+struct xfs_dedup {
+    // Both are open addressing tables with a power of two size, at most half full
+    xfs_dedup_entry* entries;
+    xfs_dedup_group* groups;
+    size_t mask;
+    uint32_t next_index;
+};
+
+static size_t xfs_dedup_count_objects(const xfs_object* obj);
+static uint64_t xfs_dedup_hash_object(xfs_dedup* dedup, const xfs_object* obj, uint32_t* value_count);
+static bool xfs_dedup_equals(const xfs_object* a, const xfs_object* b);
+
+static bool xfs_dedup_is_object_type(xfs_type_t type) {
+    return type == XFS_TYPE_CLASS || type == XFS_TYPE_CLASSREF;
+}
+
+static size_t xfs_dedup_pointer_slot(const xfs_dedup* dedup, const xfs_object* obj) {
+    // Fibonacci hashing, the low bits of an allocation are mostly zero
+    return (size_t)(((uint64_t)(uintptr_t)obj * 0x9E3779B97F4A7C15ull) >> 32) & dedup->mask;
+}
+
+xfs_dedup* xfs_dedup_create(const xfs_object* root) {
+    xfs_dedup* dedup = calloc(1, sizeof(xfs_dedup));
+    if (dedup == NULL) {
+        return NULL;
+    }
+
+    size_t capacity = 16;
+    const size_t object_count = xfs_dedup_count_objects(root);
+    while (capacity < object_count * 2) {
+        capacity *= 2;
+    }
+
+    dedup->entries = calloc(capacity, sizeof(xfs_dedup_entry));
+    dedup->groups = calloc(capacity, sizeof(xfs_dedup_group));
+    dedup->mask = capacity - 1;
+    if (dedup->entries == NULL || dedup->groups == NULL) {
+        xfs_dedup_destroy(dedup);
+        return NULL;
+    }
+
+    if (root != NULL) {
+        uint32_t value_count = 0;
+        xfs_dedup_hash_object(dedup, root, &value_count);
+    }
+
+    return dedup;
+}
+
+void xfs_dedup_destroy(xfs_dedup* dedup) {
+    if (dedup == NULL) {
+        return;
+    }
+
+    free(dedup->entries);
+    free(dedup->groups);
+    free(dedup);
+}
+
+xfs_dedup_action xfs_dedup_visit(xfs_dedup* dedup, const xfs_object* obj, uint32_t* index) {
+    size_t slot = xfs_dedup_pointer_slot(dedup, obj);
+    while (dedup->entries[slot].obj != NULL && dedup->entries[slot].obj != obj) {
+        slot = (slot + 1) & dedup->mask;
+    }
+
+    if (dedup->entries[slot].obj == NULL) {
+        return XFS_DEDUP_WRITE;
+    }
+
+    xfs_dedup_group* group = &dedup->groups[dedup->entries[slot].group];
+    if (group->count < 2) {
+        return XFS_DEDUP_WRITE;
+    }
+
+    if (group->first == NULL) {
+        group->first = obj;
+        group->index = dedup->next_index++;
+        *index = group->index;
+        return XFS_DEDUP_WRITE_INDEXED;
+    }
+
+    // Equal hashes only make a reference likely, a collision is written out in full
+    if (group->first != obj && xfs_dedup_equals(group->first, obj)) {
+        *index = group->index;
+        return XFS_DEDUP_REFERENCE;
+    }
+
+    return XFS_DEDUP_WRITE;
+}
+
+static size_t xfs_dedup_count_data(xfs_type_t type, const xfs_data* data) {
+    return xfs_dedup_is_object_type(type) ? xfs_dedup_count_objects(data->obj) : 0;
+}
+
+size_t xfs_dedup_count_objects(const xfs_object* obj) {
+    if (obj == NULL || obj->fields == NULL) {
+        return 0;
+    }
+
+    size_t count = 1;
+    for (uint32_t i = 0; i < obj->def->prop_count; i++) {
+        const xfs_field* field = &obj->fields[i];
+        if (!xfs_dedup_is_object_type(field->type)) {
+            continue;
+        }
+
+        if (field->is_array) {
+            for (uint32_t j = 0; j < field->data.array.count; j++) {
+                count += xfs_dedup_count_data(field->type, &field->data.array.entries[j]);
+            }
+        } else {
+            count += xfs_dedup_count_data(field->type, &field->data);
+        }
+    }
+
+    return count;
+}
+
+static uint64_t xfs_dedup_hash_string(uint64_t hash, const char* str) {
+    if (str == NULL) {
+        return hash_fnv1a_u32(hash, UINT32_MAX);
+    }
+
+    // Including the terminator keeps "ab" + "c" apart from "a" + "bc"
+    return hash_fnv1a(hash, str, strlen(str) + 1);
+}
+
+static uint64_t xfs_dedup_hash_data(xfs_dedup* dedup, uint64_t hash, xfs_type_t type, const xfs_data* data, uint32_t* value_count) {
+    switch (type) {
+    case XFS_TYPE_CLASS:
+    case XFS_TYPE_CLASSREF:
+        if (data->obj == NULL) {
+            return hash_fnv1a_u32(hash, UINT32_MAX);
+        }
+        return hash_fnv1a_u64(hash, xfs_dedup_hash_object(dedup, data->obj, value_count));
+    case XFS_TYPE_STRING:
+    case XFS_TYPE_CSTRING:
+        return xfs_dedup_hash_string(hash, data->str);
+    case XFS_TYPE_CUSTOM:
+        hash = hash_fnv1a_u32(hash, data->custom.count);
+        for (uint8_t i = 0; i < data->custom.count; i++) {
+            hash = xfs_dedup_hash_string(hash, data->custom.values[i]);
+        }
+        return hash;
+    default:
+        return hash_fnv1a(hash, &data->value, xfs_pod_size(type));
+    }
+}
+
+static void xfs_dedup_insert(xfs_dedup* dedup, const xfs_object* obj, uint64_t hash) {
+    size_t group = (size_t)hash & dedup->mask;
+    while (dedup->groups[group].count != 0 && dedup->groups[group].hash != hash) {
+        group = (group + 1) & dedup->mask;
+    }
+
+    dedup->groups[group].hash = hash;
+    dedup->groups[group].count++;
+
+    size_t slot = xfs_dedup_pointer_slot(dedup, obj);
+    while (dedup->entries[slot].obj != NULL) {
+        slot = (slot + 1) & dedup->mask;
+    }
+
+    dedup->entries[slot].obj = obj;
+    dedup->entries[slot].group = group;
+}
+
+// Hashes obj and everything below it, children are inserted before their parent.
+// value_count is increased by the number of values in the subtree.
+uint64_t xfs_dedup_hash_object(xfs_dedup* dedup, const xfs_object* obj, uint32_t* value_count) {
+    if (obj->fields == NULL) {
+        // Shells left by xfs_load_stream can't be compared
+        return hash_fnv1a_u32(HASH_FNV_OFFSET_BASIS, obj->index);
+    }
+
+    uint64_t hash = hash_fnv1a_u64(HASH_FNV_OFFSET_BASIS, obj->def_id);
+    uint32_t values = 0;
+
+    for (uint32_t i = 0; i < obj->def->prop_count; i++) {
+        const xfs_field* field = &obj->fields[i];
+
+        if (field->is_array) {
+            hash = hash_fnv1a_u32(hash, field->data.array.count);
+            for (uint32_t j = 0; j < field->data.array.count; j++) {
+                hash = xfs_dedup_hash_data(dedup, hash, field->type, &field->data.array.entries[j], &values);
+            }
+            values += field->data.array.count;
+        } else {
+            hash = hash_fnv1a_u32(hash, UINT32_MAX);
+            hash = xfs_dedup_hash_data(dedup, hash, field->type, &field->data, &values);
+            values++;
+        }
+    }
+
+    if (values >= XFS_DEDUP_MIN_VALUES) {
+        xfs_dedup_insert(dedup, obj, hash);
+    }
+
+    *value_count += values;
+
+    return hash;
+}
+
+static bool xfs_dedup_strings_equal(const char* a, const char* b) {
+    return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+static bool xfs_dedup_data_equals(xfs_type_t type, const xfs_data* a, const xfs_data* b) {
+    switch (type) {
+    case XFS_TYPE_CLASS:
+    case XFS_TYPE_CLASSREF:
+        if (a->obj == NULL || b->obj == NULL) {
+            return a->obj == b->obj;
+        }
+        return xfs_dedup_equals(a->obj, b->obj);
+    case XFS_TYPE_STRING:
+    case XFS_TYPE_CSTRING:
+        return xfs_dedup_strings_equal(a->str, b->str);
+    case XFS_TYPE_CUSTOM:
+        if (a->custom.count != b->custom.count) {
+            return false;
+        }
+        for (uint8_t i = 0; i < a->custom.count; i++) {
+            if (!xfs_dedup_strings_equal(a->custom.values[i], b->custom.values[i])) {
+                return false;
+            }
+        }
+        return true;
+    default:
+        // Every component of the value struct, so floats are equal exactly when they have the same bits
+        return memcmp(&a->value, &b->value, xfs_pod_size(type)) == 0;
+    }
+}
+
+bool xfs_dedup_equals(const xfs_object* a, const xfs_object* b) {
+    if (a->def_id != b->def_id || a->fields == NULL || b->fields == NULL) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < a->def->prop_count; i++) {
+        const xfs_field* field_a = &a->fields[i];
+        const xfs_field* field_b = &b->fields[i];
+
+        if (field_a->is_array != field_b->is_array) {
+            return false;
+        }
+
+        if (field_a->is_array) {
+            if (field_a->data.array.count != field_b->data.array.count) {
+                return false;
+            }
+
+            for (uint32_t j = 0; j < field_a->data.array.count; j++) {
+                if (!xfs_dedup_data_equals(field_a->type, &field_a->data.array.entries[j], &field_b->data.array.entries[j])) {
+                    return false;
+                }
+            }
+        } else if (!xfs_dedup_data_equals(field_a->type, &field_a->data, &field_b->data)) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "xfs.h"
+
+#include <stdint.h>
+
+// Subtrees holding fewer values than this are always written out, a reference wouldn't be shorter
+#define XFS_DEDUP_MIN_VALUES 4
+
+
+typedef enum xfs_dedup_action {
+    XFS_DEDUP_WRITE, // Write the object as usual
+    XFS_DEDUP_WRITE_INDEXED, // First of several equal subtrees, write it with "$index"
+    XFS_DEDUP_REFERENCE, // Equal to a subtree written before, write {"$ref": index}
+} xfs_dedup_action;
+
+// Finds subtrees of an object tree that occur more than once
+typedef struct xfs_dedup xfs_dedup;
+
+// Hashes every subtree below root, returns NULL if out of memory
+xfs_dedup* xfs_dedup_create(const xfs_object* root);
+void xfs_dedup_destroy(xfs_dedup* dedup);
+
+// Decides how to write obj. Objects have to be visited in the order they are written, and
+// subtrees that were written as a reference aren't visited. index receives the index to write
+// for XFS_DEDUP_WRITE_INDEXED and XFS_DEDUP_REFERENCE.
+xfs_dedup_action xfs_dedup_visit(xfs_dedup* dedup, const xfs_object* obj, uint32_t* index);
+
+#endif // DEDUP_H
@@ -0,0 +1,392 @@
+#include "def_cache.h"
+#include "codec.h"
+#include "util/file_map.h"
+#include "util/file_stream.h"
+#include "util/fs.h"
+#include "util/hash.h"
+#include "util/thread.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define XFS_DEF_CACHE_MAGIC 0x31434458 // "XDC1"
+
+// Struct sizes the image was written with, files from a build with another layout are ignored
+#define XFS_DEF_CACHE_LAYOUT ((uint32_t)(sizeof(xfs_def) << 16 | sizeof(xfs_property_def) << 8 | sizeof(void*)))
+
+
+// Start of a cache file. It's followed by the definition block it was parsed from, which a file
+// has to match before it is used, and the image of the parsed definitions: the xfs_def array,
+// then every property and then every name, with pointers stored as offsets into the image.
+typedef struct xfs_def_cache_file {
+    uint32_t magic;
+    uint32_t layout;
+    uint16_t major_version;
+    uint16_t actual_structure;
+    int32_t def_count;
+    uint64_t block_size;
+    uint64_t image_size;
+    uint64_t image_hash; //< Images are trusted once they match, so damaged ones have to be told apart
+} xfs_def_cache_file;
+
+
+typedef struct xfs_def_cache_entry {
+    uint64_t hash;
+    uint16_t major_version;
+    int32_t def_count;
+    uint8_t* block; //< Free this. Compared on a matching hash, so collisions can't mix up definitions
+    size_t size;
+    xfs_def* defs; //< Free this
+    bool is_image; //< defs is a single allocation read from a cache file
+    xfs_structure_type actual_structure;
+} xfs_def_cache_entry;
+
+struct xfs_def_cache {
+    char* dir; //< Free this. NULL if nothing is kept on disk
+    mutex* lock;
+    xfs_def_cache_entry* entries; //< Guarded by lock
+    size_t count; //< Guarded by lock
+    size_t capacity;
+};
+
+static uint64_t xfs_def_cache_hash(const xfs* xfs, const uint8_t* block, size_t size) {
+    uint64_t h = hash_fnv1a_u32(HASH_FNV_OFFSET_BASIS, xfs->header.major_version);
+    h = hash_fnv1a_u32(h, (uint32_t)xfs->header.def_count);
+    return hash_fnv1a(h, block, size);
+}
+
+static xfs_def_cache_entry* xfs_def_cache_lookup(xfs_def_cache* cache, uint64_t hash, const uint8_t* block, size_t size, const xfs* xfs) {
+    // Only a handful of different definition blocks exist per game, a linear search is fine
+    for (size_t i = 0; i < cache->count; i++) {
+        xfs_def_cache_entry* entry = &cache->entries[i];
+        if (entry->hash == hash
+            && entry->size == size
+            && entry->major_version == xfs->header.major_version
+            && entry->def_count == xfs->header.def_count
+            && memcmp(entry->block, block, size) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+// Adds an entry without definitions for block, NULL if the cache is full. Call with the lock held.
+static xfs_def_cache_entry* xfs_def_cache_insert(xfs_def_cache* cache, uint64_t hash, const uint8_t* block, size_t size, const xfs* xfs) {
+    if (cache->count == XFS_DEF_CACHE_MAX_ENTRIES) {
+        return NULL;
+    }
+
+    if (cache->count == cache->capacity) {
+        const size_t capacity = cache->capacity != 0 ? cache->capacity * 2 : 8;
+        xfs_def_cache_entry* entries = realloc(cache->entries, capacity * sizeof(xfs_def_cache_entry));
+        if (entries == NULL) {
+            return NULL;
+        }
+
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+
+    uint8_t* copy = malloc(size != 0 ? size : 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    memcpy(copy, block, size);
+
+    xfs_def_cache_entry* entry = &cache->entries[cache->count++];
+    *entry = (xfs_def_cache_entry){
+        .hash = hash,
+        .major_version = xfs->header.major_version,
+        .def_count = xfs->header.def_count,
+        .block = copy,
+        .size = size,
+    };
+
+    return entry;
+}
+
+// <dir>/<hash>.defs, free the result with free
+static char* xfs_def_cache_path(const xfs_def_cache* cache, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.defs", (unsigned long long)hash);
+    return util_fs_join(cache->dir, name);
+}
+
+// Turns the offsets of an image into pointers, checking that each of them stays inside it
+static bool xfs_def_cache_relocate(uint8_t* image, size_t size, int32_t def_count) {
+    if (def_count < 0 || (size_t)def_count > size / sizeof(xfs_def)) {
+        return false;
+    }
+
+    xfs_def* defs = (xfs_def*)image;
+    for (int32_t i = 0; i < def_count; i++) {
+        xfs_def* def = &defs[i];
+        const uintptr_t props = (uintptr_t)def->props;
+        if (props == 0) {
+            def->props = NULL;
+            if (def->prop_count != 0) {
+                return false;
+            }
+
+            continue;
+        }
+
+        if (props > size || (size - props) / sizeof(xfs_property_def) < def->prop_count || props % sizeof(void*) != 0) {
+            return false;
+        }
+
+        def->props = (xfs_property_def*)(image + props);
+        for (uint32_t j = 0; j < def->prop_count; j++) {
+            const uintptr_t name = (uintptr_t)def->props[j].name;
+            if (name >= size || memchr(image + name, '\0', size - name) == NULL) {
+                return false;
+            }
+
+            def->props[j].name = (char*)(image + name);
+        }
+
+        // Codecs are linked into the build, the image only has room for the pointer
+        def->codec = xfs_def_codec_find(def);
+    }
+
+    return true;
+}
+
+// Reads the definitions for block from the cache directory, copied and relocated in one go
+static xfs_def_cache_entry* xfs_def_cache_load(xfs_def_cache* cache, uint64_t hash, const uint8_t* block, size_t size, const xfs* xfs) {
+    char* path = xfs_def_cache_path(cache, hash);
+    file_map* map = path != NULL ? file_map_create(path) : NULL;
+    free(path);
+    if (map == NULL) {
+        return NULL;
+    }
+
+    // A file another process is still writing is too short and just skipped
+    xfs_def_cache_file file;
+    uint8_t* image = NULL;
+    if (map->size >= sizeof(file)) {
+        memcpy(&file, map->data, sizeof(file));
+
+        const bool matches = file.magic == XFS_DEF_CACHE_MAGIC
+            && file.layout == XFS_DEF_CACHE_LAYOUT
+            && file.major_version == xfs->header.major_version
+            && file.def_count == xfs->header.def_count
+            && file.block_size == size
+            && file.image_size != 0
+            && map->size - sizeof(file) >= size
+            && map->size - sizeof(file) - size == file.image_size
+            && memcmp(map->data + sizeof(file), block, size) == 0;
+
+        const uint8_t* data = map->data + sizeof(file) + size;
+        image = matches && hash_fnv1a(HASH_FNV_OFFSET_BASIS, data, file.image_size) == file.image_hash
+            ? malloc(file.image_size)
+            : NULL;
+
+        if (image != NULL) {
+            memcpy(image, data, file.image_size);
+            if (!xfs_def_cache_relocate(image, file.image_size, file.def_count)) {
+                free(image);
+                image = NULL;
+            }
+        }
+    }
+
+    file_map_destroy(map);
+    if (image == NULL) {
+        return NULL;
+    }
+
+    xfs_def_cache_entry* entry = xfs_def_cache_insert(cache, hash, block, size, xfs);
+    if (entry == NULL) {
+        free(image);
+        return NULL;
+    }
+
+    entry->defs = (xfs_def*)image;
+    entry->is_image = true;
+    entry->actual_structure = (xfs_structure_type)file.actual_structure;
+
+    return entry;
+}
+
+// Writes the definitions of entry to the cache directory for later runs
+static void xfs_def_cache_save(const xfs_def_cache* cache, const xfs_def_cache_entry* entry) {
+    // Image layout: definitions, properties, names
+    size_t prop_count = 0;
+    size_t names_size = 0;
+    for (int32_t i = 0; i < entry->def_count; i++) {
+        prop_count += entry->defs[i].prop_count;
+        for (uint32_t j = 0; j < entry->defs[i].prop_count; j++) {
+            names_size += strlen(entry->defs[i].props[j].name) + 1;
+        }
+    }
+
+    const size_t props_offset = entry->def_count * sizeof(xfs_def);
+    const size_t names_offset = props_offset + prop_count * sizeof(xfs_property_def);
+    const size_t image_size = names_offset + names_size;
+    if (image_size == 0) {
+        return;
+    }
+
+    uint8_t* image = calloc(1, image_size);
+    if (image == NULL) {
+        return;
+    }
+
+    xfs_def* defs = (xfs_def*)image;
+    xfs_property_def* props = (xfs_property_def*)(image + props_offset);
+    size_t name = names_offset;
+    for (int32_t i = 0; i < entry->def_count; i++) {
+        defs[i] = entry->defs[i];
+        defs[i].props = defs[i].prop_count != 0 ? (xfs_property_def*)((uint8_t*)props - image) : NULL;
+        defs[i].codec = NULL;
+
+        for (uint32_t j = 0; j < entry->defs[i].prop_count; j++) {
+            const xfs_property_def* prop = &entry->defs[i].props[j];
+            const size_t length = strlen(prop->name) + 1;
+            memcpy(image + name, prop->name, length);
+
+            *props = *prop;
+            props->name = (char*)(uintptr_t)name;
+            props++;
+            name += length;
+        }
+    }
+
+    const xfs_def_cache_file file = {
+        .magic = XFS_DEF_CACHE_MAGIC,
+        .layout = XFS_DEF_CACHE_LAYOUT,
+        .major_version = entry->major_version,
+        .actual_structure = (uint16_t)entry->actual_structure,
+        .def_count = entry->def_count,
+        .block_size = entry->size,
+        .image_size = image_size,
+        .image_hash = hash_fnv1a(HASH_FNV_OFFSET_BASIS, image, image_size),
+    };
+
+    // Failing to write only means the next run parses the definitions again. Written next to it
+    // and moved into place, so runs sharing the directory only ever see complete files.
+    char* path = xfs_def_cache_path(cache, entry->hash);
+    char* temp_path = path != NULL ? util_fs_temp_path(path) : NULL;
+    file_stream* stream = temp_path != NULL ? file_stream_create(temp_path, FILE_COMPRESSION_NONE) : NULL;
+    if (stream != NULL) {
+        file_stream_write(stream, &file, sizeof(file));
+        file_stream_write(stream, entry->block, entry->size);
+        file_stream_write(stream, image, image_size);
+        if (!file_stream_close(stream) || !util_fs_replace(temp_path, path)) {
+            remove(temp_path);
+        }
+    }
+
+    free(temp_path);
+    free(path);
+    free(image);
+}
+
+xfs_def_cache* xfs_def_cache_create(const char* dir) {
+    xfs_def_cache* cache = calloc(1, sizeof(xfs_def_cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->lock = mutex_create();
+    cache->dir = dir != NULL ? strdup(dir) : NULL;
+    if (cache->lock == NULL || (dir != NULL && cache->dir == NULL)) {
+        mutex_destroy(cache->lock);
+        free(cache->dir);
+        free(cache);
+        return NULL;
+    }
+
+    // Without its directory the cache still works for the current run
+    if (cache->dir != NULL && !util_fs_make_dir(cache->dir)) {
+        fprintf(stderr, "Failed to create cache directory: %s\n", cache->dir);
+        free(cache->dir);
+        cache->dir = NULL;
+    }
+
+    return cache;
+}
+
+void xfs_def_cache_destroy(xfs_def_cache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < cache->count; i++) {
+        xfs_def_cache_entry* entry = &cache->entries[i];
+
+        // The loaders allocate every name separately
+        for (int32_t j = 0; !entry->is_image && j < entry->def_count; j++) {
+            for (uint32_t k = 0; k < entry->defs[j].prop_count; k++) {
+                free(entry->defs[j].props[k].name);
+            }
+
+            free(entry->defs[j].props);
+        }
+
+        free(entry->defs);
+        free(entry->block);
+    }
+
+    free(cache->entries);
+    free(cache->dir);
+    mutex_destroy(cache->lock);
+    free(cache);
+}
+
+bool xfs_def_cache_find(xfs_def_cache* cache, const uint8_t* block, size_t size, xfs* xfs) {
+    if (cache == NULL || block == NULL) {
+        return false;
+    }
+
+    const uint64_t hash = xfs_def_cache_hash(xfs, block, size);
+
+    mutex_lock(cache->lock);
+    const xfs_def_cache_entry* entry = xfs_def_cache_lookup(cache, hash, block, size, xfs);
+    if (entry == NULL && cache->dir != NULL) {
+        entry = xfs_def_cache_load(cache, hash, block, size, xfs);
+    }
+
+    if (entry != NULL) {
+        xfs->defs = entry->defs;
+        xfs->actual_structure = entry->actual_structure;
+        xfs->shares_defs = true;
+    }
+    mutex_unlock(cache->lock);
+
+    return entry != NULL;
+}
+
+void xfs_def_cache_add(xfs_def_cache* cache, const uint8_t* block, size_t size, xfs* xfs) {
+    if (cache == NULL || block == NULL || xfs->defs == NULL || xfs->shares_defs) {
+        return;
+    }
+
+    const uint64_t hash = xfs_def_cache_hash(xfs, block, size);
+
+    mutex_lock(cache->lock);
+
+    // Another thread may have parsed the same block in the meantime, this xfs keeps its own copy then
+    xfs_def_cache_entry* entry = xfs_def_cache_lookup(cache, hash, block, size, xfs) == NULL
+        ? xfs_def_cache_insert(cache, hash, block, size, xfs)
+        : NULL;
+
+    xfs_def_cache_entry added = { 0 };
+    if (entry != NULL) {
+        entry->defs = xfs->defs;
+        entry->actual_structure = xfs->actual_structure;
+        xfs->shares_defs = true;
+        added = *entry;
+    }
+
+    mutex_unlock(cache->lock);
+
+    // The entry doesn't change anymore, but the array may move, so its copy is saved without the lock
+    if (added.defs != NULL && cache->dir != NULL) {
+        xfs_def_cache_save(cache, &added);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef DEF_CACHE_H
+#define DEF_CACHE_H
+
+#include "xfs.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Definition blocks the cache keeps at most, files beyond that many different ones parse their own
+#define XFS_DEF_CACHE_MAX_ENTRIES 256
+
+
+// Definitions parsed once and shared by every file whose definition block is byte for byte the
+// same, which files of the same game version usually are. An xfs loaded with a cache points to
+// the cached definitions and their names instead of its own copy. Entries are immutable and kept
+// until the cache is destroyed. The cache can be used from several threads at once.
+//
+// With a directory, definitions are also kept on disk for later runs, as <dir>/<hash>.defs holding
+// the definition block and an image of the parsed definitions. A block seen in an earlier run is
+// then mapped, compared and copied in one go instead of being parsed name by name.
+typedef struct xfs_def_cache xfs_def_cache;
+
+// dir is created if needed, NULL keeps the cache in memory only
+xfs_def_cache* xfs_def_cache_create(const char* dir);
+// Every xfs that got its definitions from the cache has to be freed before
+void xfs_def_cache_destroy(xfs_def_cache* cache);
+
+// Looks up the definition block following the header of xfs, size bytes at block. On a hit the
+// xfs gets the cached definitions along with the structure detected for them and true is returned.
+bool xfs_def_cache_find(xfs_def_cache* cache, const uint8_t* block, size_t size, xfs* xfs);
+
+// Hands the definitions xfs parsed from block over to the cache, the xfs shares them afterwards.
+// Does nothing if the cache is full or has the block already.
+void xfs_def_cache_add(xfs_def_cache* cache, const uint8_t* block, size_t size, xfs* xfs);
+
+#endif // DEF_CACHE_H
@@ -0,0 +1,290 @@
+#include "manifest.h"
+#include "util/file_stream.h"
+#include "util/hash.h"
+#include "util/thread.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define XFS_MANIFEST_HEADER "xfs2json-manifest 1"
+
+// Modification times this close to the start of the run that recorded them don't tell a later
+// change apart on file systems that keep them coarsely, FAT keeps 2 seconds
+#define XFS_MANIFEST_TIME_MARGIN (2 * 1000000000ll)
+
+
+typedef struct xfs_manifest_entry {
+    char* name; //< Free this
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+} xfs_manifest_entry;
+
+typedef struct xfs_manifest_list {
+    xfs_manifest_entry* entries; //< Free this
+    size_t count;
+    size_t capacity;
+} xfs_manifest_list;
+
+struct xfs_manifest {
+    char* path; //< Free this
+    char* version; //< Free this
+    uint64_t options;
+    int64_t started; //< When this run started, in nanoseconds since the epoch
+    int64_t last_started; //< When the run that wrote last started, minus the margin
+    xfs_manifest_list last; //< Sorted by name, only read after loading
+    mutex* lock;
+    xfs_manifest_list next; //< Guarded by lock
+};
+
+static bool xfs_manifest_list_add(xfs_manifest_list* list, const xfs_manifest_entry* entry) {
+    if (list->count == list->capacity) {
+        const size_t capacity = list->capacity != 0 ? list->capacity * 2 : 256;
+        xfs_manifest_entry* entries = realloc(list->entries, capacity * sizeof(xfs_manifest_entry));
+        if (entries == NULL) {
+            return false;
+        }
+
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+
+    char* name = strdup(entry->name);
+    if (name == NULL) {
+        return false;
+    }
+
+    list->entries[list->count] = *entry;
+    list->entries[list->count++].name = name;
+
+    return true;
+}
+
+static void xfs_manifest_list_free(xfs_manifest_list* list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->entries[i].name);
+    }
+
+    free(list->entries);
+    memset(list, 0, sizeof(xfs_manifest_list));
+}
+
+static int xfs_manifest_compare(const void* a, const void* b) {
+    return strcmp(((const xfs_manifest_entry*)a)->name, ((const xfs_manifest_entry*)b)->name);
+}
+
+// Parses "<size> <mtime> <hash> <name>", entry->name points into line afterwards
+static bool xfs_manifest_parse_entry(char* line, xfs_manifest_entry* entry) {
+    char* end = NULL;
+    entry->size = strtoull(line, &end, 10);
+    if (end == line || *end != ' ') {
+        return false;
+    }
+
+    line = end + 1;
+    entry->mtime = strtoll(line, &end, 10);
+    if (end == line || *end != ' ') {
+        return false;
+    }
+
+    line = end + 1;
+    entry->hash = strtoull(line, &end, 16);
+    if (end == line || *end != ' ' || end[1] == '\0') {
+        return false;
+    }
+
+    entry->name = end + 1;
+
+    return true;
+}
+
+// Takes the entries of the file at path if it was written by the same version with the same options
+static void xfs_manifest_read(xfs_manifest* manifest) {
+    if (!util_fs_exists(manifest->path)) {
+        return;
+    }
+
+    size_t size = 0;
+    char* data = file_read_all(manifest->path, &size);
+    if (data == NULL) {
+        return;
+    }
+
+    char* line = data;
+    char* end = strchr(line, '\n');
+    if (end == NULL) {
+        free(data);
+        return;
+    }
+
+    *end = '\0';
+
+    // "<header> <started> <options> <version>"
+    const size_t header_length = strlen(XFS_MANIFEST_HEADER);
+    char* field = line + header_length;
+    bool usable = strncmp(line, XFS_MANIFEST_HEADER, header_length) == 0 && *field == ' ';
+    int64_t started = 0;
+    if (usable) {
+        started = strtoll(field + 1, &field, 10);
+        usable = *field == ' ';
+    }
+
+    if (usable) {
+        const uint64_t options = strtoull(field + 1, &field, 16);
+        usable = *field == ' ' && options == manifest->options && strcmp(field + 1, manifest->version) == 0;
+    }
+
+    for (line = end + 1; usable && *line != '\0'; line = end + 1) {
+        end = strchr(line, '\n');
+        if (end == NULL) {
+            break; // Cut off while it was written
+        }
+
+        *end = '\0';
+
+        xfs_manifest_entry entry;
+        if (xfs_manifest_parse_entry(line, &entry) && !xfs_manifest_list_add(&manifest->last, &entry)) {
+            break;
+        }
+    }
+
+    free(data);
+
+    manifest->last_started = started - XFS_MANIFEST_TIME_MARGIN;
+    qsort(manifest->last.entries, manifest->last.count, sizeof(xfs_manifest_entry), xfs_manifest_compare);
+}
+
+xfs_manifest* xfs_manifest_load(const char* dir, const char* version, uint64_t options) {
+    xfs_manifest* manifest = calloc(1, sizeof(xfs_manifest));
+    if (manifest == NULL) {
+        return NULL;
+    }
+
+    manifest->path = util_fs_join(dir, XFS_MANIFEST_NAME);
+    manifest->version = strdup(version);
+    manifest->options = options;
+    manifest->started = (int64_t)time(NULL) * 1000000000ll;
+    manifest->lock = mutex_create();
+    if (manifest->path == NULL || manifest->version == NULL || manifest->lock == NULL) {
+        xfs_manifest_destroy(manifest);
+        return NULL;
+    }
+
+    xfs_manifest_read(manifest);
+
+    return manifest;
+}
+
+void xfs_manifest_destroy(xfs_manifest* manifest) {
+    if (manifest == NULL) {
+        return;
+    }
+
+    xfs_manifest_list_free(&manifest->last);
+    xfs_manifest_list_free(&manifest->next);
+    mutex_destroy(manifest->lock);
+    free(manifest->path);
+    free(manifest->version);
+    free(manifest);
+}
+
+static void xfs_manifest_add(xfs_manifest* manifest, const xfs_manifest_entry* entry) {
+    // Names with line breaks can't be written, those inputs are converted every time
+    if (strchr(entry->name, '\n') != NULL || strchr(entry->name, '\r') != NULL) {
+        return;
+    }
+
+    mutex_lock(manifest->lock);
+    xfs_manifest_list_add(&manifest->next, entry);
+    mutex_unlock(manifest->lock);
+}
+
+bool xfs_manifest_is_unchanged(xfs_manifest* manifest, const char* name, const char* path, const char* output, const util_fs_info* info) {
+    const xfs_manifest_entry key = { .name = (char*)name };
+    const xfs_manifest_entry* entry = manifest->last.count != 0
+        ? bsearch(&key, manifest->last.entries, manifest->last.count, sizeof(xfs_manifest_entry), xfs_manifest_compare)
+        : NULL;
+
+    if (entry == NULL || entry->size != info->size || !util_fs_exists(output)) {
+        return false;
+    }
+
+    xfs_manifest_entry kept = *entry;
+    if (entry->mtime != info->mtime || entry->mtime >= manifest->last_started) {
+        size_t size = 0;
+        char* data = file_read_all(path, &size);
+        if (data == NULL) {
+            return false;
+        }
+
+        const uint64_t hash = xfs_manifest_hash(data, size);
+        free(data);
+        if (hash != entry->hash) {
+            return false;
+        }
+
+        kept.mtime = info->mtime;
+    }
+
+    xfs_manifest_add(manifest, &kept);
+
+    return true;
+}
+
+uint64_t xfs_manifest_hash(const void* data, size_t size) {
+    return hash_fnv1a(HASH_FNV_OFFSET_BASIS, data, size);
+}
+
+void xfs_manifest_record(xfs_manifest* manifest, const char* name, const util_fs_info* info, uint64_t hash) {
+    const xfs_manifest_entry entry = {
+        .name = (char*)name,
+        .size = info->size,
+        .mtime = info->mtime,
+        .hash = hash,
+    };
+
+    xfs_manifest_add(manifest, &entry);
+}
+
+bool xfs_manifest_save(xfs_manifest* manifest) {
+    mutex_lock(manifest->lock);
+    xfs_manifest_list* list = &manifest->next;
+    qsort(list->entries, list->count, sizeof(xfs_manifest_entry), xfs_manifest_compare);
+
+    // Written next to it and moved over, so an interrupted run leaves the last manifest intact
+    char* temp_path = util_fs_temp_path(manifest->path);
+    file_stream* stream = temp_path != NULL ? file_stream_create(temp_path, FILE_COMPRESSION_NONE) : NULL;
+
+    if (stream == NULL) {
+        mutex_unlock(manifest->lock);
+        free(temp_path);
+        return false;
+    }
+
+    char line[512];
+    snprintf(line, sizeof(line), "%s %lld %016llx %s\n", XFS_MANIFEST_HEADER,
+        (long long)manifest->started, (unsigned long long)manifest->options, manifest->version);
+    file_stream_write(stream, line, strlen(line));
+
+    for (size_t i = 0; i < list->count; i++) {
+        const xfs_manifest_entry* entry = &list->entries[i];
+        snprintf(line, sizeof(line), "%llu %lld %016llx ",
+            (unsigned long long)entry->size, (long long)entry->mtime, (unsigned long long)entry->hash);
+        file_stream_write(stream, line, strlen(line));
+        file_stream_write(stream, entry->name, strlen(entry->name));
+        file_stream_write(stream, "\n", 1);
+    }
+
+    mutex_unlock(manifest->lock);
+
+    const bool saved = file_stream_close(stream) && util_fs_replace(temp_path, manifest->path);
+    if (!saved) {
+        remove(temp_path);
+    }
+
+    free(temp_path);
+
+    return saved;
+}
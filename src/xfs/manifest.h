@@ -0,0 +1,46 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "util/fs.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Name of the manifest inside the output directory
+#define XFS_MANIFEST_NAME ".xfs2json.manifest"
+
+
+// Inputs of an incremental bulk run, so the next run can skip the ones that haven't changed since
+// their output was written. For every input it records the size and modification time it had when
+// it was read, and a hash of its contents.
+//
+// An input whose size and modification time still match is skipped without being opened. If only
+// the time differs (the file was touched or copied), or the time is too close to the run that
+// recorded it to tell a later change apart, the input is read and its hash decides. Manifests
+// written by another version or with other options are ignored as a whole.
+//
+// The manifest is a text file, a header line followed by "<size> <mtime> <hash> <name>" per input.
+// It can be used from several threads at once.
+typedef struct xfs_manifest xfs_manifest;
+
+// Reads the manifest of the last run from dir, if there is a usable one. options is a hash of
+// everything that changes the output. Returns NULL only if out of memory.
+xfs_manifest* xfs_manifest_load(const char* dir, const char* version, uint64_t options);
+void xfs_manifest_destroy(xfs_manifest* manifest);
+
+// Whether the input at path, recorded as name, is still the one output was converted from and
+// output still exists. info is the current state of the input. An unchanged input is carried
+// over to the next manifest.
+bool xfs_manifest_is_unchanged(xfs_manifest* manifest, const char* name, const char* path, const char* output, const util_fs_info* info);
+
+// Hash of the contents of an input, taken right after reading it since conversions may change the data
+uint64_t xfs_manifest_hash(const void* data, size_t size);
+
+// Records an input that was just converted. info is its state from before it was read.
+void xfs_manifest_record(xfs_manifest* manifest, const char* name, const util_fs_info* info, uint64_t hash);
+
+// Replaces the manifest of the last run with the inputs recorded or carried over in this one
+bool xfs_manifest_save(xfs_manifest* manifest);
+
+#endif // MANIFEST_H
@@ -0,0 +1,202 @@
+#include "result_cache.h"
+#include "schema.h"
+#include "util/file_stream.h"
+#include "util/fs.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Next to an entry, names the schema the stored output refers to
+#define XFS_RESULT_CACHE_SCHEMA_SUFFIX ".schema"
+
+
+struct xfs_result_cache {
+    char* dir; //< Free this
+};
+
+xfs_result_cache* xfs_result_cache_create(const char* dir) {
+    if (!util_fs_make_dir(dir)) {
+        fprintf(stderr, "Failed to create result cache directory: %s\n", dir);
+        return NULL;
+    }
+
+    xfs_result_cache* cache = calloc(1, sizeof(xfs_result_cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->dir = strdup(dir);
+    if (cache->dir == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void xfs_result_cache_destroy(xfs_result_cache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    free(cache->dir);
+    free(cache);
+}
+
+// <dir>/<xx>/<key><suffix>, free the result with free
+static char* xfs_result_cache_path(const char* dir, uint64_t key, const char* suffix) {
+    const unsigned long long k = (unsigned long long)key;
+    const int length = snprintf(NULL, 0, "%s/%02llx/%016llx%s", dir, k >> 56, k, suffix);
+    char* path = malloc(length + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    snprintf(path, length + 1, "%s/%02llx/%016llx%s", dir, k >> 56, k, suffix);
+
+    return path;
+}
+
+// <dir>/schemas/<hash>.json, free the result with free
+static char* xfs_result_cache_schema_path(const char* dir, const char* hash) {
+    const int length = snprintf(NULL, 0, "%s/%s/%s.json", dir, XFS_SCHEMA_DIR, hash);
+    char* path = malloc(length + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    snprintf(path, length + 1, "%s/%s/%s.json", dir, XFS_SCHEMA_DIR, hash);
+
+    return path;
+}
+
+// Copies from to to through a file next to it, so to is either missing or complete
+static bool xfs_result_cache_copy(const char* from, const char* to) {
+    char* temp_path = util_fs_temp_path(to);
+    if (temp_path == NULL) {
+        return false;
+    }
+
+    const bool copied = util_fs_copy_file(from, temp_path) && util_fs_replace(temp_path, to);
+    if (!copied) {
+        remove(temp_path);
+    }
+
+    free(temp_path);
+
+    return copied;
+}
+
+// Copies the schema called hash from the schemas directory of from_dir to the one of to_dir,
+// unless to_dir has it already
+static bool xfs_result_cache_copy_schema(const char* from_dir, const char* to_dir, const char* hash) {
+    char* from = xfs_result_cache_schema_path(from_dir, hash);
+    char* to = xfs_result_cache_schema_path(to_dir, hash);
+    char* schema_dir = util_fs_join(to_dir, XFS_SCHEMA_DIR);
+
+    // Same hash means same content, like for schemas written by a conversion
+    const bool copied = from != NULL && to != NULL && schema_dir != NULL
+        && (util_fs_exists(to) || (util_fs_make_dir(schema_dir) && xfs_result_cache_copy(from, to)));
+
+    free(from);
+    free(to);
+    free(schema_dir);
+
+    return copied;
+}
+
+// Reads the name of the schema stored next to an entry into hash, leaving it empty if there is
+// none. Returns false if it can't be read or is invalid.
+static bool xfs_result_cache_read_schema(const char* entry_path, char hash[XFS_SCHEMA_HASH_LENGTH + 1]) {
+    hash[0] = '\0';
+
+    const int length = snprintf(NULL, 0, "%s%s", entry_path, XFS_RESULT_CACHE_SCHEMA_SUFFIX);
+    char* path = malloc(length + 1);
+    if (path == NULL) {
+        return false;
+    }
+
+    snprintf(path, length + 1, "%s%s", entry_path, XFS_RESULT_CACHE_SCHEMA_SUFFIX);
+
+    if (!util_fs_exists(path)) {
+        free(path);
+        return true;
+    }
+
+    size_t size = 0;
+    char* data = file_read_all(path, &size);
+    free(path);
+    if (data == NULL) {
+        return false;
+    }
+
+    // The hash ends up in a path, so only what xfs_schema_hash produces is accepted
+    bool valid = size == XFS_SCHEMA_HASH_LENGTH;
+    for (size_t i = 0; valid && i < size; i++) {
+        valid = (data[i] >= '0' && data[i] <= '9') || (data[i] >= 'a' && data[i] <= 'f');
+    }
+
+    if (valid) {
+        memcpy(hash, data, XFS_SCHEMA_HASH_LENGTH);
+        hash[XFS_SCHEMA_HASH_LENGTH] = '\0';
+    }
+
+    free(data);
+
+    return valid;
+}
+
+bool xfs_result_cache_fetch(xfs_result_cache* cache, uint64_t key, const char* output, const char* schema_dir) {
+    char* path = xfs_result_cache_path(cache->dir, key, "");
+    if (path == NULL || !util_fs_exists(path)) {
+        free(path);
+        return false;
+    }
+
+    // An output without its schema is of no use, the file is converted then
+    char hash[XFS_SCHEMA_HASH_LENGTH + 1];
+    const bool fetched = xfs_result_cache_read_schema(path, hash)
+        && (hash[0] == '\0' || (schema_dir != NULL && xfs_result_cache_copy_schema(cache->dir, schema_dir, hash)))
+        && util_fs_copy_file(path, output);
+
+    free(path);
+
+    return fetched;
+}
+
+void xfs_result_cache_store(xfs_result_cache* cache, uint64_t key, const char* output, const char* schema_dir, const char* schema_hash) {
+    char* path = xfs_result_cache_path(cache->dir, key, "");
+    char* schema_path = xfs_result_cache_path(cache->dir, key, XFS_RESULT_CACHE_SCHEMA_SUFFIX);
+    char* entry_dir = path != NULL ? util_fs_get_dir(path) : NULL;
+
+    bool stored = path != NULL && schema_path != NULL && entry_dir != NULL && util_fs_make_dir(entry_dir);
+
+    // The entry goes last, once it can be found everything it refers to is in place
+    if (stored && schema_hash != NULL) {
+        stored = xfs_result_cache_copy_schema(schema_dir, cache->dir, schema_hash);
+
+        char* temp_path = stored ? util_fs_temp_path(schema_path) : NULL;
+        file_stream* stream = temp_path != NULL ? file_stream_create(temp_path, FILE_COMPRESSION_NONE) : NULL;
+        if (stream != NULL) {
+            file_stream_write(stream, schema_hash, strlen(schema_hash));
+            stored = file_stream_close(stream) && util_fs_replace(temp_path, schema_path);
+        } else {
+            stored = false;
+        }
+
+        if (!stored && temp_path != NULL) {
+            remove(temp_path);
+        }
+
+        free(temp_path);
+    }
+
+    if (stored) {
+        xfs_result_cache_copy(output, path);
+    }
+
+    free(path);
+    free(schema_path);
+    free(entry_dir);
+}
@@ -0,0 +1,32 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Outputs of earlier conversions, stored under a key that covers everything they depend on: the
+// input bytes, the output format, the options and the tool version. Converting the same input
+// the same way again, in another checkout or run, copies the stored output instead. Copies are
+// reflinks where the file system supports them.
+//
+// Entries are <dir>/<first two digits of the key>/<key>, written next to their place and moved
+// there, so runs sharing the directory never see half of one. JSON written in bulk mode refers
+// to a schema instead of holding its definitions, that schema is kept in <dir>/schemas as well.
+// Nothing is ever removed from the directory, clear it by hand.
+typedef struct xfs_result_cache xfs_result_cache;
+
+// dir is created if needed
+xfs_result_cache* xfs_result_cache_create(const char* dir);
+void xfs_result_cache_destroy(xfs_result_cache* cache);
+
+// Copies the output stored under key to output. If it refers to a schema, the schema is copied
+// to the schemas directory of schema_dir unless it is there already. False if there is no such
+// entry or it can't be copied.
+bool xfs_result_cache_fetch(xfs_result_cache* cache, uint64_t key, const char* output, const char* schema_dir);
+
+// Stores the output that was just written for key. schema_hash is the schema it refers to (in the
+// schemas directory of schema_dir), NULL if it has none. Failing to store only loses the entry.
+void xfs_result_cache_store(xfs_result_cache* cache, uint64_t key, const char* output, const char* schema_dir, const char* schema_hash);
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,246 @@
+#include "schema.h"
+#include "util/file_stream.h"
+#include "util/fs.h"
+#include "util/hash.h"
+#include "util/json_reader.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+typedef struct xfs_schema {
+    char hash[XFS_SCHEMA_HASH_LENGTH + 1];
+    cJSON* json; //< Parsed schema file, NULL if it was only written
+    char* buffer; //< Strings of json point into this
+} xfs_schema;
+
+struct xfs_schema_cache {
+    xfs_schema* schemas;
+    size_t count;
+    size_t capacity;
+};
+
+void xfs_schema_hash(const xfs* xfs, char hash[XFS_SCHEMA_HASH_LENGTH + 1]) {
+    // Covers everything xfs_to_json writes for the definitions
+    uint64_t h = hash_fnv1a_u32(HASH_FNV_OFFSET_BASIS, (uint32_t)xfs->header.def_count);
+
+    for (int i = 0; i < xfs->header.def_count; i++) {
+        const xfs_def* def = &xfs->defs[i];
+
+        h = hash_fnv1a_u32(h, def->dti_hash);
+        h = hash_fnv1a(h, def->raw_header, sizeof(def->raw_header));
+        h = hash_fnv1a_u32(h, def->prop_count);
+
+        for (uint32_t j = 0; j < def->prop_count; j++) {
+            const xfs_property_def* prop = &def->props[j];
+
+            // Including the terminator keeps "ab" + "c" apart from "a" + "bc"
+            h = hash_fnv1a(h, prop->name, strlen(prop->name) + 1);
+            h = hash_fnv1a_u32(h, (uint32_t)prop->type);
+            h = hash_fnv1a_u32(h, prop->attr);
+            h = hash_fnv1a_u32(h, prop->bytes);
+            h = hash_fnv1a_u32(h, prop->disable);
+        }
+    }
+
+    snprintf(hash, XFS_SCHEMA_HASH_LENGTH + 1, "%016llx", (unsigned long long)h);
+}
+
+xfs_schema_cache* xfs_schema_cache_create(void) {
+    return calloc(1, sizeof(xfs_schema_cache));
+}
+
+void xfs_schema_cache_destroy(xfs_schema_cache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < cache->count; i++) {
+        cJSON_Delete(cache->schemas[i].json);
+        free(cache->schemas[i].buffer);
+    }
+
+    free(cache->schemas);
+    free(cache);
+}
+
+static bool xfs_schema_is_valid_hash(const char* hash) {
+    // The hash ends up in a path, so only what xfs_schema_hash produces is accepted
+    if (hash == NULL || strlen(hash) != XFS_SCHEMA_HASH_LENGTH) {
+        return false;
+    }
+
+    for (int i = 0; i < XFS_SCHEMA_HASH_LENGTH; i++) {
+        const char c = hash[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static xfs_schema* xfs_schema_cache_find(xfs_schema_cache* cache, const char* hash) {
+    // Only a handful of different schemas exist per game, a linear search is fine
+    for (size_t i = 0; i < cache->count; i++) {
+        if (strcmp(cache->schemas[i].hash, hash) == 0) {
+            return &cache->schemas[i];
+        }
+    }
+
+    return NULL;
+}
+
+static xfs_schema* xfs_schema_cache_add(xfs_schema_cache* cache, const char* hash) {
+    if (cache->count == cache->capacity) {
+        const size_t capacity = cache->capacity != 0 ? cache->capacity * 2 : 8;
+        xfs_schema* schemas = realloc(cache->schemas, capacity * sizeof(xfs_schema));
+        if (schemas == NULL) {
+            return NULL;
+        }
+
+        cache->schemas = schemas;
+        cache->capacity = capacity;
+    }
+
+    xfs_schema* schema = &cache->schemas[cache->count++];
+    memset(schema, 0, sizeof(xfs_schema));
+    memcpy(schema->hash, hash, XFS_SCHEMA_HASH_LENGTH + 1);
+
+    return schema;
+}
+
+// <dir>/schemas/<hash>.json, free the result with free
+static char* xfs_schema_path(const char* dir, const char* hash) {
+    const int length = snprintf(NULL, 0, "%s/%s/%s.json", dir, XFS_SCHEMA_DIR, hash);
+    char* path = malloc(length + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    snprintf(path, length + 1, "%s/%s/%s.json", dir, XFS_SCHEMA_DIR, hash);
+
+    return path;
+}
+
+// Parses a schema file, NULL if it's missing or isn't a complete schema. The strings of the
+// result point into *buffer, free it after the result.
+static cJSON* xfs_schema_read(const char* path, char** buffer) {
+    size_t size = 0;
+    *buffer = file_read_all(path, &size);
+    if (*buffer == NULL) {
+        return NULL;
+    }
+
+    cJSON* json = json_reader_parse(*buffer, size);
+    if (json == NULL || !cJSON_IsArray(cJSON_GetObjectItem(json, "$defs"))) {
+        cJSON_Delete(json);
+        free(*buffer);
+        *buffer = NULL;
+        return NULL;
+    }
+
+    return json;
+}
+
+bool xfs_schema_cache_store(xfs_schema_cache* cache, const char* dir, const char* hash, const cJSON* defs, const json_writer_options* options) {
+    if (cache == NULL || !xfs_schema_is_valid_hash(hash)) {
+        return false;
+    }
+
+    if (xfs_schema_cache_find(cache, hash) != NULL) {
+        return true;
+    }
+
+    char* schema_dir = util_fs_join(dir, XFS_SCHEMA_DIR);
+    char* path = xfs_schema_path(dir, hash);
+    if (schema_dir == NULL || path == NULL) {
+        free(schema_dir);
+        free(path);
+        return false;
+    }
+
+    // Same hash means same content, so a complete file left by an earlier run is kept as it is
+    char* buffer = NULL;
+    cJSON* json = xfs_schema_read(path, &buffer);
+    bool result = true;
+
+    if (json == NULL) {
+        cJSON* schema = cJSON_CreateObject();
+        cJSON_AddItemReferenceToObject(schema, "$defs", (cJSON*)defs);
+
+        // Written next to it and moved into place, so other runs never read a partial schema
+        char* temp_path = util_fs_temp_path(path);
+        if (!util_fs_make_dir(schema_dir)) {
+            fprintf(stderr, "Failed to create schema directory: %s\n", schema_dir);
+            result = false;
+        } else if (temp_path == NULL) {
+            result = false;
+        } else if (!json_writer_write_file(temp_path, schema, options) || !util_fs_replace(temp_path, path)) {
+            fprintf(stderr, "Failed to write schema file: %s\n", path);
+            remove(temp_path);
+            result = false;
+        }
+
+        free(temp_path);
+        cJSON_Delete(schema);
+    }
+
+    free(schema_dir);
+    free(path);
+
+    xfs_schema* schema = result ? xfs_schema_cache_add(cache, hash) : NULL;
+    if (schema == NULL) {
+        cJSON_Delete(json);
+        free(buffer);
+        return false;
+    }
+
+    schema->json = json;
+    schema->buffer = buffer;
+
+    return true;
+}
+
+const cJSON* xfs_schema_cache_load(xfs_schema_cache* cache, const char* dir, const char* hash) {
+    if (cache == NULL || !xfs_schema_is_valid_hash(hash)) {
+        fprintf(stderr, "Invalid schema hash: %s\n", hash != NULL ? hash : "(null)");
+        return NULL;
+    }
+
+    xfs_schema* schema = xfs_schema_cache_find(cache, hash);
+    if (schema != NULL && schema->json != NULL) {
+        return cJSON_GetObjectItem(schema->json, "$defs");
+    }
+
+    char* path = xfs_schema_path(dir, hash);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    char* buffer = NULL;
+    cJSON* json = xfs_schema_read(path, &buffer);
+    if (json == NULL) {
+        fprintf(stderr, "Invalid schema file: %s\n", path);
+        free(path);
+        return NULL;
+    }
+
+    free(path);
+
+    // Schemas this cache wrote are only known by hash until they are needed for reading
+    if (schema == NULL) {
+        schema = xfs_schema_cache_add(cache, hash);
+        if (schema == NULL) {
+            cJSON_Delete(json);
+            free(buffer);
+            return NULL;
+        }
+    }
+
+    schema->json = json;
+    schema->buffer = buffer;
+
+    return cJSON_GetObjectItem(json, "$defs");
+}
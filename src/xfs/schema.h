@@ -0,0 +1,34 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include "xfs.h"
+#include "util/json_writer.h"
+
+#include <stdbool.h>
+#include <cJSON.h>
+
+// Subdirectory of the output directory that shared definitions are written to
+#define XFS_SCHEMA_DIR "schemas"
+#define XFS_SCHEMA_HASH_LENGTH 16
+
+
+// Content hash of the definitions of an xfs, as lowercase hex digits.
+// Files with the same definitions get the same hash regardless of their objects.
+void xfs_schema_hash(const xfs* xfs, char hash[XFS_SCHEMA_HASH_LENGTH + 1]);
+
+// Definitions shared between files, written to and read from <dir>/schemas/<hash>.json.
+// A JSON file using one has "$schema": "<hash>" instead of a "$defs" array.
+typedef struct xfs_schema_cache xfs_schema_cache;
+
+xfs_schema_cache* xfs_schema_cache_create(void);
+void xfs_schema_cache_destroy(xfs_schema_cache* cache);
+
+// Writes defs (a "$defs" array) to <dir>/schemas/<hash>.json, unless the cache has written or
+// loaded that schema before or a complete one exists already. The file is replaced atomically.
+bool xfs_schema_cache_store(xfs_schema_cache* cache, const char* dir, const char* hash, const cJSON* defs, const json_writer_options* options);
+
+// Returns the "$defs" array of a schema, reading <dir>/schemas/<hash>.json the first time it is
+// requested. The array is owned by the cache. Returns NULL if the file is missing or invalid.
+const cJSON* xfs_schema_cache_load(xfs_schema_cache* cache, const char* dir, const char* hash);
+
+#endif // SCHEMA_H
@@ -0,0 +1,389 @@
+#include "shard.h"
+#include "util/file_stream.h"
+#include "util/fs.h"
+#include "util/json_reader.h"
+#include "util/thread.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+typedef struct xfs_shard {
+    char* path; //< Free this
+    uint32_t count; //< Elements the manifest expects
+    char* buffer; //< Free this. Strings and numbers of json point into it
+    cJSON* json; //< Free this. Empty once the elements are moved into the manifest
+} xfs_shard;
+
+struct xfs_shard_set {
+    xfs_shard* shards;
+    size_t count;
+};
+
+typedef struct xfs_shard_worker {
+    xfs_shard_set* set;
+    size_t first_shard;
+    size_t shard_stride;
+} xfs_shard_worker;
+
+// "<name>.shards" for an output path <dir>/<name>.json[.gz|.zst], free the result with free
+static char* xfs_shard_dir_name(const char* output) {
+    const char* filename = util_fs_get_filename(output);
+    size_t stem_length = strlen(filename) - strlen(file_compression_extension(file_compression_from_path(output)));
+    if (util_fs_has_extension(filename, ".json")) {
+        stem_length -= strlen(".json");
+    }
+
+    const int length = snprintf(NULL, 0, "%.*s%s", (int)stem_length, filename, XFS_SHARD_DIR_SUFFIX);
+    char* name = malloc(length + 1);
+    if (name == NULL) {
+        return NULL;
+    }
+
+    snprintf(name, length + 1, "%.*s%s", (int)stem_length, filename, XFS_SHARD_DIR_SUFFIX);
+
+    return name;
+}
+
+// "<dir_name>/<index>.json[.gz|.zst]", free the result with free
+static char* xfs_shard_file_name(const char* dir_name, uint32_t index, file_compression compression) {
+    const char* extension = file_compression_extension(compression);
+
+    const int length = snprintf(NULL, 0, "%s/%u.json%s", dir_name, index, extension);
+    char* name = malloc(length + 1);
+    if (name == NULL) {
+        return NULL;
+    }
+
+    snprintf(name, length + 1, "%s/%u.json%s", dir_name, index, extension);
+
+    return name;
+}
+
+cJSON* xfs_shard_split(const xfs* xfs, cJSON* json, uint32_t shard_count, const char* output) {
+    const xfs_object* root = xfs->root;
+    if (root == NULL || root->fields == NULL || shard_count < 2) {
+        return NULL;
+    }
+
+    const xfs_field* largest = NULL;
+    for (uint32_t i = 0; i < root->def->prop_count; i++) {
+        const xfs_field* field = &root->fields[i];
+        if (!field->is_array || (field->type != XFS_TYPE_CLASS && field->type != XFS_TYPE_CLASSREF)) {
+            continue;
+        }
+
+        if (largest == NULL || field->data.array.count > largest->data.array.count) {
+            largest = field;
+        }
+    }
+
+    cJSON* root_json = cJSON_GetObjectItemCaseSensitive(json, "root");
+    cJSON* items = largest != NULL ? cJSON_GetObjectItemCaseSensitive(root_json, largest->name) : NULL;
+    const int count = cJSON_GetArraySize(items);
+    if (!cJSON_IsArray(items) || count < 2) {
+        return NULL;
+    }
+
+    if (shard_count > (uint32_t)count) {
+        shard_count = (uint32_t)count;
+    }
+
+    char* dir_name = xfs_shard_dir_name(output);
+    if (dir_name == NULL) {
+        return NULL;
+    }
+
+    const file_compression compression = file_compression_from_path(output);
+    cJSON* shards = cJSON_CreateArray();
+    cJSON* files = cJSON_CreateArray();
+
+    for (uint32_t i = 0; i < shard_count; i++) {
+        // Sizes differ by at most one element
+        const uint32_t shard_size = (uint32_t)((uint64_t)count * (i + 1) / shard_count - (uint64_t)count * i / shard_count);
+
+        cJSON* shard = cJSON_CreateArray();
+        for (uint32_t j = 0; j < shard_size; j++) {
+            cJSON_AddItemToArray(shard, cJSON_DetachItemFromArray(items, 0));
+        }
+        cJSON_AddItemToArray(shards, shard);
+
+        char* name = xfs_shard_file_name(dir_name, i, compression);
+        cJSON* file = cJSON_CreateObject();
+        cJSON_AddStringToObject(file, "file", name != NULL ? name : "");
+        cJSON_AddNumberToObject(file, "count", shard_size);
+        cJSON_AddItemToArray(files, file);
+        free(name);
+    }
+
+    free(dir_name);
+
+    cJSON* manifest = cJSON_CreateObject();
+    cJSON_AddItemToObjectCS(manifest, "$shards", files);
+    cJSON_ReplaceItemInObjectCaseSensitive(root_json, largest->name, manifest);
+
+    return shards;
+}
+
+bool xfs_shard_write(const cJSON* shards, const char* output, const json_writer_options* options) {
+    char* dir = util_fs_get_dir(output);
+    char* dir_name = xfs_shard_dir_name(output);
+    char* shard_dir = dir != NULL && dir_name != NULL ? util_fs_join(dir, dir_name) : NULL;
+    if (shard_dir == NULL) {
+        free(dir);
+        free(dir_name);
+        return false;
+    }
+
+    bool result = util_fs_make_dir(shard_dir);
+    if (!result) {
+        fprintf(stderr, "Failed to create shard directory: %s\n", shard_dir);
+    }
+
+    uint32_t index = 0;
+    const cJSON* shard = NULL;
+    cJSON_ArrayForEach(shard, shards) {
+        if (!result) {
+            break;
+        }
+
+        char* name = xfs_shard_file_name(dir_name, index++, options->compression);
+        char* path = name != NULL ? util_fs_join(dir, name) : NULL;
+
+        result = path != NULL && json_writer_write_file(path, shard, options);
+        if (!result) {
+            fprintf(stderr, "Failed to write shard: %s\n", path != NULL ? path : output);
+        }
+
+        free(name);
+        free(path);
+    }
+
+    free(dir);
+    free(dir_name);
+    free(shard_dir);
+
+    return result;
+}
+
+static bool xfs_shard_is_manifest(const cJSON* item) {
+    return cJSON_IsObject(item) && cJSON_IsArray(cJSON_GetObjectItemCaseSensitive(item, "$shards"));
+}
+
+static bool xfs_shard_is_valid_file(const char* file) {
+    // Shards have to stay below the manifest's directory
+    if (file == NULL || file[0] == '\0' || file[0] == '/' || file[0] == '\\' || strchr(file, ':') != NULL) {
+        return false;
+    }
+
+    for (const char* part = file; part != NULL; part = strpbrk(part, "/\\")) {
+        if (part != file) {
+            part++;
+        }
+
+        if (strncmp(part, "..", 2) == 0 && (part[2] == '\0' || part[2] == '/' || part[2] == '\\')) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void xfs_shard_load(void* arg) {
+    const xfs_shard_worker* worker = (const xfs_shard_worker*)arg;
+    xfs_shard_set* set = worker->set;
+
+    for (size_t i = worker->first_shard; i < set->count; i += worker->shard_stride) {
+        xfs_shard* shard = &set->shards[i];
+
+        size_t size = 0;
+        shard->buffer = file_read_all(shard->path, &size);
+        if (shard->buffer != NULL) {
+            shard->json = json_reader_parse(shard->buffer, size);
+        }
+    }
+}
+
+static bool xfs_shard_load_all(xfs_shard_set* set, int thread_count) {
+    const size_t count = set->count < (size_t)thread_count ? set->count : (size_t)thread_count;
+    xfs_shard_worker* workers = calloc(count, sizeof(xfs_shard_worker));
+    thread** threads = calloc(count, sizeof(thread*));
+    if (workers == NULL || threads == NULL) {
+        free(workers);
+        free(threads);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        workers[i].set = set;
+        workers[i].first_shard = i;
+        workers[i].shard_stride = count;
+    }
+
+    // Same as for printing, the calling thread loads the first share and any share whose thread didn't start
+    for (size_t i = 1; i < count; i++) {
+        threads[i] = thread_create(xfs_shard_load, &workers[i]);
+    }
+
+    xfs_shard_load(&workers[0]);
+
+    for (size_t i = 1; i < count; i++) {
+        if (threads[i] != NULL) {
+            thread_join(threads[i]);
+        } else {
+            xfs_shard_load(&workers[i]);
+        }
+    }
+
+    free(workers);
+    free(threads);
+
+    return true;
+}
+
+// Collects the shards of every manifest in the root, in order
+static bool xfs_shard_collect(xfs_shard_set* set, const cJSON* root, const char* dir) {
+    const cJSON* item = NULL;
+    cJSON_ArrayForEach(item, root) {
+        if (xfs_shard_is_manifest(item)) {
+            set->count += (size_t)cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(item, "$shards"));
+        }
+    }
+
+    if (set->count == 0) {
+        return true;
+    }
+
+    set->shards = calloc(set->count, sizeof(xfs_shard));
+    if (set->shards == NULL) {
+        set->count = 0;
+        return false;
+    }
+
+    size_t index = 0;
+    cJSON_ArrayForEach(item, root) {
+        if (!xfs_shard_is_manifest(item)) {
+            continue;
+        }
+
+        const cJSON* entry = NULL;
+        cJSON_ArrayForEach(entry, cJSON_GetObjectItemCaseSensitive(item, "$shards")) {
+            xfs_shard* shard = &set->shards[index++];
+
+            const char* file = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(entry, "file"));
+            const cJSON* count = cJSON_GetObjectItemCaseSensitive(entry, "count");
+            const double value = cJSON_GetNumberValue(count);
+            if (!xfs_shard_is_valid_file(file) || !cJSON_IsNumber(count) || !(value >= 0 && value <= UINT32_MAX)) {
+                fprintf(stderr, "Invalid shard in %s: %s\n", item->string, file != NULL ? file : "(no file)");
+                return false;
+            }
+
+            shard->count = (uint32_t)value;
+            shard->path = util_fs_join(dir, file);
+            if (shard->path == NULL) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Replaces every manifest in the root with an array of its shards' elements
+static bool xfs_shard_splice(xfs_shard_set* set, cJSON* root) {
+    size_t index = 0;
+    cJSON* item = root->child;
+
+    while (item != NULL) {
+        cJSON* next = item->next;
+        if (!xfs_shard_is_manifest(item)) {
+            item = next;
+            continue;
+        }
+
+        cJSON* items = cJSON_CreateArray();
+        const int shard_count = cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(item, "$shards"));
+
+        for (int i = 0; i < shard_count; i++) {
+            xfs_shard* shard = &set->shards[index++];
+            if (!cJSON_IsArray(shard->json) || (uint32_t)cJSON_GetArraySize(shard->json) != shard->count) {
+                fprintf(stderr, "Shard %s doesn't hold the %u elements its manifest expects\n", shard->path, shard->count);
+                cJSON_Delete(items);
+                return false;
+            }
+
+            while (shard->json->child != NULL) {
+                cJSON_AddItemToArray(items, cJSON_DetachItemFromArray(shard->json, 0));
+            }
+        }
+
+        cJSON_ReplaceItemInObjectCaseSensitive(root, item->string, items);
+        item = next;
+    }
+
+    return true;
+}
+
+xfs_shard_set* xfs_shard_join(cJSON* json, const char* input, int thread_count) {
+    xfs_shard_set* set = calloc(1, sizeof(xfs_shard_set));
+    if (set == NULL) {
+        return NULL;
+    }
+
+    cJSON* root = cJSON_GetObjectItemCaseSensitive(json, "root");
+    if (!cJSON_IsObject(root)) {
+        return set;
+    }
+
+    char* dir = util_fs_get_dir(input);
+    if (dir == NULL) {
+        free(set);
+        return NULL;
+    }
+
+    bool result = xfs_shard_collect(set, root, dir);
+    free(dir);
+
+    // Reading and parsing is what takes the time, moving the elements over is cheap
+    if (result && set->count != 0) {
+        result = xfs_shard_load_all(set, thread_count > 0 ? thread_count : 1);
+    }
+
+    for (size_t i = 0; i < set->count && result; i++) {
+        if (set->shards[i].json == NULL) {
+            fprintf(stderr, "Failed to read shard: %s\n", set->shards[i].path);
+            result = false;
+        }
+    }
+
+    if (result) {
+        result = xfs_shard_splice(set, root);
+    }
+
+    if (!result) {
+        xfs_shard_set_destroy(set);
+        return NULL;
+    }
+
+    return set;
+}
+
+size_t xfs_shard_set_count(const xfs_shard_set* set) {
+    return set != NULL ? set->count : 0;
+}
+
+void xfs_shard_set_destroy(xfs_shard_set* set) {
+    if (set == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < set->count; i++) {
+        cJSON_Delete(set->shards[i].json);
+        free(set->shards[i].buffer);
+        free(set->shards[i].path);
+    }
+
+    free(set->shards);
+    free(set);
+}
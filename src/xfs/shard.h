@@ -0,0 +1,36 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "xfs.h"
+#include "util/json_writer.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <cJSON.h>
+
+// Shards of <name>.json are written to <name>.shards/<i>.json next to it
+#define XFS_SHARD_DIR_SUFFIX ".shards"
+
+
+// Moves the elements of the largest array of objects in the root of json (as produced by
+// xfs_to_json for xfs) into shard_count arrays, and replaces the array with
+// {"$shards": [{"file": "<name>.shards/<i>.json", "count": <elements>}, ...]}, which makes json
+// the manifest. Returns an array holding the shard arrays in order, or NULL if the root has no
+// array of objects with at least two elements. Both trees share their nodes.
+cJSON* xfs_shard_split(const xfs* xfs, cJSON* json, uint32_t shard_count, const char* output);
+
+// Writes the arrays returned by xfs_shard_split for the manifest at output
+bool xfs_shard_write(const cJSON* shards, const char* output, const json_writer_options* options);
+
+// Shard files loaded for a manifest, their strings are referenced by the tree they were joined into
+typedef struct xfs_shard_set xfs_shard_set;
+
+// Reads the shards every "$shards" object in the root of json refers to, relative to input, on up
+// to thread_count threads, and puts their elements back in place of the "$shards" object. Destroy
+// the set only after json. json without shards gives an empty set. Returns NULL on failure.
+xfs_shard_set* xfs_shard_join(cJSON* json, const char* input, int thread_count);
+// Number of shard files that were read
+size_t xfs_shard_set_count(const xfs_shard_set* set);
+void xfs_shard_set_destroy(xfs_shard_set* set);
+
+#endif // SHARD_H
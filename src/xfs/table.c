@@ -0,0 +1,852 @@
+#include "table.h"
+#include "util/file_stream.h"
+#include "util/fs.h"
+#include "util/number_format.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define XFS_TABLE_IMPLICIT_COLUMNS 3
+#define XFS_TABLE_ALIGNMENT 8
+#define XFS_TABLE_MAX_COMPONENTS 32
+
+
+typedef struct xfs_table_buffer {
+    uint8_t* data; //< Free this
+    size_t size;
+    size_t capacity;
+} xfs_table_buffer;
+
+typedef struct xfs_table_column {
+    char* name; //< Free this
+    xfs_type_t type; //< XFS_TYPE_UNDEFINED for the implicit columns
+    uint32_t prop; //< Property the column is filled from
+    xfs_table_kind kind;
+    uint16_t components; //< Values per element, e.g. 3 for a vector
+    uint8_t flags;
+    uint64_t element_count;
+    xfs_table_buffer values;
+    xfs_table_buffer string_ends; //< u64 end offset into values per element, only for strings
+    xfs_table_buffer row_ends; //< u64 element count after each row
+} xfs_table_column;
+
+typedef struct xfs_table {
+    uint32_t dti_hash;
+    uint32_t row_count;
+    uint32_t column_count; //< 0 until the first row is added
+    xfs_table_column* columns; //< Free this
+} xfs_table;
+
+struct xfs_table_set {
+    xfs_table* tables; //< Free this. One per definition, in definition order
+    size_t count;
+};
+
+static const char* const s_implicit_columns[XFS_TABLE_IMPLICIT_COLUMNS] = { "$index", "$parent", "$array_index" };
+
+static size_t xfs_table_kind_size(xfs_table_kind kind) {
+    switch (kind) {
+    case XFS_TABLE_KIND_BOOL:
+    case XFS_TABLE_KIND_U8:
+    case XFS_TABLE_KIND_S8:
+    case XFS_TABLE_KIND_STRING:
+        return 1;
+    case XFS_TABLE_KIND_U16:
+    case XFS_TABLE_KIND_S16:
+        return 2;
+    case XFS_TABLE_KIND_U32:
+    case XFS_TABLE_KIND_S32:
+    case XFS_TABLE_KIND_F32:
+    case XFS_TABLE_KIND_INDEX:
+        return 4;
+    case XFS_TABLE_KIND_U64:
+    case XFS_TABLE_KIND_S64:
+    case XFS_TABLE_KIND_F64:
+        return 8;
+    }
+
+    return 1;
+}
+
+static void xfs_table_add_f32(float* components, uint16_t* count, const float* values, uint16_t value_count) {
+    memcpy(components + *count, values, value_count * sizeof(float));
+    *count += value_count;
+}
+
+// The components of a value made of floats, in the order xfs_json.c writes them. Padding in the
+// structs isn't a component, a vector3 has 3. Returns the component count, 0 for other types.
+static uint16_t xfs_table_f32_components(xfs_type_t type, const xfs_value* value, float components[XFS_TABLE_MAX_COMPONENTS]) {
+    uint16_t count = 0;
+
+    switch (type) {
+    case XFS_TYPE_MATRIX: xfs_table_add_f32(components, &count, &value->matrix.m[0][0], 16); break;
+    case XFS_TYPE_VECTOR3: xfs_table_add_f32(components, &count, &value->vector3.x, 3); break;
+    case XFS_TYPE_VECTOR4: xfs_table_add_f32(components, &count, &value->vector4.x, 4); break;
+    case XFS_TYPE_QUATERNION: xfs_table_add_f32(components, &count, &value->quaternion.x, 4); break;
+    case XFS_TYPE_FLOAT2: xfs_table_add_f32(components, &count, &value->float2.x, 2); break;
+    case XFS_TYPE_FLOAT3: xfs_table_add_f32(components, &count, &value->float3.x, 3); break;
+    case XFS_TYPE_FLOAT4: xfs_table_add_f32(components, &count, &value->float4.x, 4); break;
+    case XFS_TYPE_FLOAT3x3: xfs_table_add_f32(components, &count, &value->float3x3.m[0][0], 9); break;
+    case XFS_TYPE_FLOAT4x3: xfs_table_add_f32(components, &count, &value->float4x3.m[0][0], 12); break;
+    case XFS_TYPE_FLOAT4x4: xfs_table_add_f32(components, &count, &value->float4x4.m[0][0], 16); break;
+    case XFS_TYPE_EASECURVE:
+        xfs_table_add_f32(components, &count, &value->easecurve.p1, 1);
+        xfs_table_add_f32(components, &count, &value->easecurve.p2, 1);
+        break;
+    case XFS_TYPE_LINE:
+        xfs_table_add_f32(components, &count, &value->line.from.x, 3);
+        xfs_table_add_f32(components, &count, &value->line.dir.x, 3);
+        break;
+    case XFS_TYPE_LINESEGMENT:
+        xfs_table_add_f32(components, &count, &value->linesegment.p0.x, 3);
+        xfs_table_add_f32(components, &count, &value->linesegment.p1.x, 3);
+        break;
+    case XFS_TYPE_RAY:
+        xfs_table_add_f32(components, &count, &value->ray.from.x, 3);
+        xfs_table_add_f32(components, &count, &value->ray.dir.x, 3);
+        break;
+    case XFS_TYPE_PLANE:
+        xfs_table_add_f32(components, &count, &value->plane.normal.x, 3);
+        xfs_table_add_f32(components, &count, &value->plane.dist, 1);
+        break;
+    case XFS_TYPE_SPHERE:
+        xfs_table_add_f32(components, &count, &value->sphere.center.x, 3);
+        xfs_table_add_f32(components, &count, &value->sphere.radius, 1);
+        break;
+    case XFS_TYPE_CAPSULE:
+        xfs_table_add_f32(components, &count, &value->capsule.p0.x, 3);
+        xfs_table_add_f32(components, &count, &value->capsule.p1.x, 3);
+        xfs_table_add_f32(components, &count, &value->capsule.radius, 1);
+        break;
+    case XFS_TYPE_AABB:
+        xfs_table_add_f32(components, &count, &value->aabb.min.x, 3);
+        xfs_table_add_f32(components, &count, &value->aabb.max.x, 3);
+        break;
+    case XFS_TYPE_OBB:
+        xfs_table_add_f32(components, &count, &value->obb.transform.m[0][0], 16);
+        xfs_table_add_f32(components, &count, &value->obb.extent.x, 3);
+        break;
+    case XFS_TYPE_CYLINDER:
+        xfs_table_add_f32(components, &count, &value->cylinder.p0.x, 3);
+        xfs_table_add_f32(components, &count, &value->cylinder.p1.x, 3);
+        xfs_table_add_f32(components, &count, &value->cylinder.radius, 1);
+        break;
+    case XFS_TYPE_TRIANGLE:
+        xfs_table_add_f32(components, &count, &value->triangle.p0.x, 3);
+        xfs_table_add_f32(components, &count, &value->triangle.p1.x, 3);
+        xfs_table_add_f32(components, &count, &value->triangle.p2.x, 3);
+        break;
+    case XFS_TYPE_CONE:
+        xfs_table_add_f32(components, &count, &value->cone.p0.x, 3);
+        xfs_table_add_f32(components, &count, &value->cone.p1.x, 3);
+        xfs_table_add_f32(components, &count, &value->cone.r0, 1);
+        xfs_table_add_f32(components, &count, &value->cone.r1, 1);
+        break;
+    case XFS_TYPE_TORUS:
+        xfs_table_add_f32(components, &count, &value->torus.pos.x, 3);
+        xfs_table_add_f32(components, &count, &value->torus.axis.x, 3);
+        xfs_table_add_f32(components, &count, &value->torus.r, 1);
+        xfs_table_add_f32(components, &count, &value->torus.cr, 1);
+        break;
+    case XFS_TYPE_ELLIPSOID:
+        xfs_table_add_f32(components, &count, &value->ellipsoid.pos.x, 3);
+        xfs_table_add_f32(components, &count, &value->ellipsoid.r.x, 3);
+        break;
+    case XFS_TYPE_RANGEF:
+        xfs_table_add_f32(components, &count, &value->rangef.s, 1);
+        xfs_table_add_f32(components, &count, &value->rangef.r, 1);
+        break;
+    case XFS_TYPE_HERMITECURVE:
+        xfs_table_add_f32(components, &count, value->hermitecurve.x, 8);
+        xfs_table_add_f32(components, &count, value->hermitecurve.y, 8);
+        break;
+    case XFS_TYPE_FLOAT3x4: xfs_table_add_f32(components, &count, &value->float3x4.m[0][0], 12); break;
+    case XFS_TYPE_LINESEGMENT4:
+        xfs_table_add_f32(components, &count, &value->linesegment4.p0_4.x.x, 4);
+        xfs_table_add_f32(components, &count, &value->linesegment4.p0_4.y.x, 4);
+        xfs_table_add_f32(components, &count, &value->linesegment4.p0_4.z.x, 4);
+        xfs_table_add_f32(components, &count, &value->linesegment4.p1_4.x.x, 4);
+        xfs_table_add_f32(components, &count, &value->linesegment4.p1_4.y.x, 4);
+        xfs_table_add_f32(components, &count, &value->linesegment4.p1_4.z.x, 4);
+        break;
+    case XFS_TYPE_AABB4:
+        xfs_table_add_f32(components, &count, &value->aabb4.min_4.x.x, 4);
+        xfs_table_add_f32(components, &count, &value->aabb4.min_4.y.x, 4);
+        xfs_table_add_f32(components, &count, &value->aabb4.min_4.z.x, 4);
+        xfs_table_add_f32(components, &count, &value->aabb4.max_4.x.x, 4);
+        xfs_table_add_f32(components, &count, &value->aabb4.max_4.y.x, 4);
+        xfs_table_add_f32(components, &count, &value->aabb4.max_4.z.x, 4);
+        break;
+    case XFS_TYPE_VECTOR2: xfs_table_add_f32(components, &count, &value->vector2.x, 2); break;
+    case XFS_TYPE_MATRIX33: xfs_table_add_f32(components, &count, &value->matrix33.m[0][0], 9); break;
+    case XFS_TYPE_RECT3D_XZ:
+        xfs_table_add_f32(components, &count, &value->rect3d_xz.lt.x, 2);
+        xfs_table_add_f32(components, &count, &value->rect3d_xz.lb.x, 2);
+        xfs_table_add_f32(components, &count, &value->rect3d_xz.rt.x, 2);
+        xfs_table_add_f32(components, &count, &value->rect3d_xz.rb.x, 2);
+        xfs_table_add_f32(components, &count, &value->rect3d_xz.height, 1);
+        break;
+    case XFS_TYPE_RECT3D:
+        xfs_table_add_f32(components, &count, &value->rect3d.normal.x, 3);
+        xfs_table_add_f32(components, &count, &value->rect3d.center.x, 3);
+        xfs_table_add_f32(components, &count, &value->rect3d.size_w, 1);
+        xfs_table_add_f32(components, &count, &value->rect3d.size_h, 1);
+        break;
+    case XFS_TYPE_PLANE_XZ: xfs_table_add_f32(components, &count, &value->plane_xz.dist, 1); break;
+    case XFS_TYPE_RAY_Y:
+        xfs_table_add_f32(components, &count, &value->ray_y.from.x, 3);
+        xfs_table_add_f32(components, &count, &value->ray_y.dir, 1);
+        break;
+    case XFS_TYPE_POINTF:
+        xfs_table_add_f32(components, &count, &value->pointf.x, 1);
+        xfs_table_add_f32(components, &count, &value->pointf.y, 1);
+        break;
+    case XFS_TYPE_SIZEF:
+        xfs_table_add_f32(components, &count, &value->sizef.w, 1);
+        xfs_table_add_f32(components, &count, &value->sizef.h, 1);
+        break;
+    case XFS_TYPE_RECTF:
+        xfs_table_add_f32(components, &count, &value->rectf.l, 1);
+        xfs_table_add_f32(components, &count, &value->rectf.t, 1);
+        xfs_table_add_f32(components, &count, &value->rectf.r, 1);
+        xfs_table_add_f32(components, &count, &value->rectf.b, 1);
+        break;
+    default:
+        break;
+    }
+
+    return count;
+}
+
+// Picks the element type for a property. An element holds every component of the value in the
+// order xfs_json.c writes them, e.g. t l r b for a rect.
+// Returns false for types without a value (groups, events...), which don't get a column.
+static bool xfs_table_column_kind(xfs_type_t type, xfs_table_kind* kind, uint16_t* components) {
+    *components = 1;
+
+    switch (type) {
+    case XFS_TYPE_CLASS:
+    case XFS_TYPE_CLASSREF:
+        *kind = XFS_TABLE_KIND_INDEX;
+        return true;
+    case XFS_TYPE_STRING:
+    case XFS_TYPE_CSTRING:
+    case XFS_TYPE_CUSTOM:
+        *kind = XFS_TABLE_KIND_STRING;
+        return true;
+    case XFS_TYPE_BOOL: *kind = XFS_TABLE_KIND_BOOL; return true;
+    case XFS_TYPE_U8: *kind = XFS_TABLE_KIND_U8; return true;
+    case XFS_TYPE_U16: *kind = XFS_TABLE_KIND_U16; return true;
+    case XFS_TYPE_U32: *kind = XFS_TABLE_KIND_U32; return true;
+    case XFS_TYPE_U64: *kind = XFS_TABLE_KIND_U64; return true;
+    case XFS_TYPE_S8: *kind = XFS_TABLE_KIND_S8; return true;
+    case XFS_TYPE_S16: *kind = XFS_TABLE_KIND_S16; return true;
+    case XFS_TYPE_S32: *kind = XFS_TABLE_KIND_S32; return true;
+    case XFS_TYPE_S64: *kind = XFS_TABLE_KIND_S64; return true;
+    case XFS_TYPE_F32: *kind = XFS_TABLE_KIND_F32; return true;
+    case XFS_TYPE_F64: *kind = XFS_TABLE_KIND_F64; return true;
+    case XFS_TYPE_COLOR: *kind = XFS_TABLE_KIND_U32; return true;
+    case XFS_TYPE_TIME: *kind = XFS_TABLE_KIND_S64; return true;
+    case XFS_TYPE_POINT:
+    case XFS_TYPE_SIZE:
+        *kind = XFS_TABLE_KIND_S32;
+        *components = 2;
+        return true;
+    case XFS_TYPE_RECT:
+        *kind = XFS_TABLE_KIND_S32;
+        *components = 4;
+        return true;
+    case XFS_TYPE_RANGE:
+        // s is signed and r unsigned, both fit into 64 bits
+        *kind = XFS_TABLE_KIND_S64;
+        *components = 2;
+        return true;
+    case XFS_TYPE_RANGEU16:
+        *kind = XFS_TABLE_KIND_U16;
+        *components = 2;
+        return true;
+    default:
+        break;
+    }
+
+    // Everything else (vectors, matrices, shapes...) is made of floats
+    const xfs_value value = { 0 };
+    float values[XFS_TABLE_MAX_COMPONENTS];
+    *kind = XFS_TABLE_KIND_F32;
+    *components = xfs_table_f32_components(type, &value, values);
+
+    return *components != 0;
+}
+
+static bool xfs_table_buffer_append(xfs_table_buffer* buffer, const void* data, size_t size) {
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity != 0 ? buffer->capacity * 2 : 256;
+        while (capacity < buffer->size + size) {
+            capacity *= 2;
+        }
+
+        uint8_t* new_data = realloc(buffer->data, capacity);
+        if (new_data == NULL) {
+            return false;
+        }
+
+        buffer->data = new_data;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+
+    return true;
+}
+
+static bool xfs_table_append_u64(xfs_table_buffer* buffer, uint64_t value) {
+    return xfs_table_buffer_append(buffer, &value, sizeof(value));
+}
+
+static bool xfs_table_append_string(xfs_table_column* column, const char* str) {
+    column->element_count++;
+
+    return (str == NULL || xfs_table_buffer_append(&column->values, str, strlen(str)))
+        && xfs_table_append_u64(&column->string_ends, column->values.size);
+}
+
+static bool xfs_table_append_element(xfs_table_column* column, const xfs_data* data) {
+    switch (column->type) {
+    case XFS_TYPE_CLASS:
+    case XFS_TYPE_CLASSREF: {
+        // Children are visited before their parent, so only their index is left to refer to
+        const uint32_t index = data->obj != NULL ? data->obj->index : UINT32_MAX;
+        column->element_count++;
+        return xfs_table_buffer_append(&column->values, &index, sizeof(index));
+    }
+    case XFS_TYPE_STRING:
+    case XFS_TYPE_CSTRING:
+        return xfs_table_append_string(column, data->str);
+    case XFS_TYPE_CUSTOM:
+        // Every value is an element of its own, which makes the column a list
+        column->flags |= XFS_TABLE_COLUMN_LIST;
+        for (uint8_t i = 0; i < data->custom.count; i++) {
+            if (!xfs_table_append_string(column, data->custom.values[i])) {
+                return false;
+            }
+        }
+        return true;
+    case XFS_TYPE_RANGE: {
+        const int64_t range[2] = { data->value.range.s, data->value.range.r };
+        column->element_count++;
+        return xfs_table_buffer_append(&column->values, range, sizeof(range));
+    }
+    case XFS_TYPE_RANGEU16: {
+        const uint16_t range[2] = { (uint16_t)data->value.rangeu16.s, (uint16_t)data->value.rangeu16.r };
+        column->element_count++;
+        return xfs_table_buffer_append(&column->values, range, sizeof(range));
+    }
+    case XFS_TYPE_BOOL: {
+        const uint8_t value = data->value.b ? 1 : 0;
+        column->element_count++;
+        return xfs_table_buffer_append(&column->values, &value, sizeof(value));
+    }
+    case XFS_TYPE_POINT: {
+        const int32_t point[2] = { data->value.point.x, data->value.point.y };
+        column->element_count++;
+        return xfs_table_buffer_append(&column->values, point, sizeof(point));
+    }
+    case XFS_TYPE_SIZE: {
+        const int32_t size[2] = { data->value.size.w, data->value.size.h };
+        column->element_count++;
+        return xfs_table_buffer_append(&column->values, size, sizeof(size));
+    }
+    case XFS_TYPE_RECT: {
+        const int32_t rect[4] = { data->value.rect.t, data->value.rect.l, data->value.rect.r, data->value.rect.b };
+        column->element_count++;
+        return xfs_table_buffer_append(&column->values, rect, sizeof(rect));
+    }
+    default:
+        break;
+    }
+
+    float values[XFS_TABLE_MAX_COMPONENTS];
+    const uint16_t count = xfs_table_f32_components(column->type, &data->value, values);
+    column->element_count++;
+    if (count != 0) {
+        return count == column->components
+            && xfs_table_buffer_append(&column->values, values, count * sizeof(float));
+    }
+
+    // Plain numbers, times and colors are stored as they are
+    return xfs_table_buffer_append(&column->values, &data->value, xfs_table_kind_size(column->kind));
+}
+
+static bool xfs_table_append_field(xfs_table_column* column, const xfs_field* field) {
+    bool result = true;
+
+    if (field->is_array) {
+        column->flags |= XFS_TABLE_COLUMN_LIST;
+        for (uint32_t i = 0; i < field->data.array.count && result; i++) {
+            result = xfs_table_append_element(column, &field->data.array.entries[i]);
+        }
+    } else {
+        result = xfs_table_append_element(column, &field->data);
+    }
+
+    return result && xfs_table_append_u64(&column->row_ends, column->element_count);
+}
+
+static bool xfs_table_append_u32(xfs_table_column* column, uint32_t value) {
+    column->element_count++;
+
+    return xfs_table_buffer_append(&column->values, &value, sizeof(value))
+        && xfs_table_append_u64(&column->row_ends, column->element_count);
+}
+
+static bool xfs_table_init(xfs_table* table, const xfs_def* def) {
+    uint32_t column_count = XFS_TABLE_IMPLICIT_COLUMNS;
+    xfs_table_kind kind;
+    uint16_t components;
+
+    for (uint32_t i = 0; i < def->prop_count; i++) {
+        column_count += xfs_table_column_kind(def->props[i].type, &kind, &components) ? 1 : 0;
+    }
+
+    table->columns = calloc(column_count, sizeof(xfs_table_column));
+    if (table->columns == NULL) {
+        return false;
+    }
+
+    table->dti_hash = def->dti_hash;
+    table->column_count = column_count;
+
+    for (uint32_t i = 0; i < XFS_TABLE_IMPLICIT_COLUMNS; i++) {
+        xfs_table_column* column = &table->columns[i];
+        column->name = strdup(s_implicit_columns[i]);
+        column->type = XFS_TYPE_UNDEFINED;
+        column->kind = XFS_TABLE_KIND_INDEX;
+        column->components = 1;
+        if (column->name == NULL) {
+            return false;
+        }
+    }
+
+    uint32_t index = XFS_TABLE_IMPLICIT_COLUMNS;
+    for (uint32_t i = 0; i < def->prop_count; i++) {
+        const xfs_property_def* prop = &def->props[i];
+        if (!xfs_table_column_kind(prop->type, &kind, &components)) {
+            continue;
+        }
+
+        xfs_table_column* column = &table->columns[index++];
+        column->name = strdup(prop->name != NULL ? prop->name : "");
+        column->type = prop->type;
+        column->prop = i;
+        column->kind = kind;
+        column->components = components;
+        if (column->name == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+xfs_table_set* xfs_table_set_create(void) {
+    return calloc(1, sizeof(xfs_table_set));
+}
+
+void xfs_table_set_destroy(xfs_table_set* set) {
+    if (set == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < set->count; i++) {
+        xfs_table* table = &set->tables[i];
+        if (table->columns == NULL) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < table->column_count; j++) {
+            xfs_table_column* column = &table->columns[j];
+            free(column->name);
+            free(column->values.data);
+            free(column->string_ends.data);
+            free(column->row_ends.data);
+        }
+
+        free(table->columns);
+    }
+
+    free(set->tables);
+    free(set);
+}
+
+bool xfs_table_on_defs(const xfs* xfs, void* user_data) {
+    xfs_table_set* set = (xfs_table_set*)user_data;
+    if (xfs->header.def_count <= 0) {
+        return true;
+    }
+
+    set->tables = calloc((size_t)xfs->header.def_count, sizeof(xfs_table));
+    if (set->tables == NULL) {
+        fprintf(stderr, "Failed to allocate memory for tables\n");
+        return false;
+    }
+
+    set->count = (size_t)xfs->header.def_count;
+
+    return true;
+}
+
+bool xfs_table_on_object(const xfs* xfs, const xfs_object* obj, const xfs_object_location* location, void* user_data) {
+    xfs_table_set* set = (xfs_table_set*)user_data;
+    if (obj->def_id >= set->count) {
+        fprintf(stderr, "Object %u has an invalid definition: %zu\n", obj->index, obj->def_id);
+        return false;
+    }
+
+    xfs_table* table = &set->tables[obj->def_id];
+    if (table->columns == NULL && !xfs_table_init(table, &xfs->defs[obj->def_id])) {
+        fprintf(stderr, "Failed to allocate memory for tables\n");
+        return false;
+    }
+
+    bool result = xfs_table_append_u32(&table->columns[0], obj->index)
+        && xfs_table_append_u32(&table->columns[1], location->parent)
+        && xfs_table_append_u32(&table->columns[2], location->array_index);
+
+    for (uint32_t i = XFS_TABLE_IMPLICIT_COLUMNS; i < table->column_count && result; i++) {
+        xfs_table_column* column = &table->columns[i];
+        result = xfs_table_append_field(column, &obj->fields[column->prop]);
+    }
+
+    if (!result) {
+        fprintf(stderr, "Failed to add object %u to its table\n", obj->index);
+        return false;
+    }
+
+    table->row_count++;
+
+    return true;
+}
+
+static uint64_t xfs_table_align(uint64_t offset) {
+    return (offset + XFS_TABLE_ALIGNMENT - 1) & ~(uint64_t)(XFS_TABLE_ALIGNMENT - 1);
+}
+
+static void xfs_table_write_padding(file_stream* stream, uint64_t* offset) {
+    static const uint8_t zeros[XFS_TABLE_ALIGNMENT] = { 0 };
+
+    const uint64_t aligned = xfs_table_align(*offset);
+    file_stream_write(stream, zeros, (size_t)(aligned - *offset));
+    *offset = aligned;
+}
+
+static void xfs_table_write_block(file_stream* stream, uint64_t* offset, const xfs_table_buffer* buffer) {
+    xfs_table_write_padding(stream, offset);
+    file_stream_write(stream, buffer->data, buffer->size);
+    *offset += buffer->size;
+}
+
+// Bytes of a column's data, including the padding between its parts
+static uint64_t xfs_table_column_size(const xfs_table_column* column) {
+    uint64_t size = 0;
+    if (column->flags & XFS_TABLE_COLUMN_LIST) {
+        size = xfs_table_align(size) + column->row_ends.size;
+    }
+
+    if (column->kind == XFS_TABLE_KIND_STRING) {
+        size = xfs_table_align(size) + column->string_ends.size;
+    }
+
+    return xfs_table_align(size) + column->values.size;
+}
+
+// Header, then one descriptor per column, then the data of each column starting at an aligned
+// offset: the u64 element count after each row (list columns only), the u64 end of each string
+// (string columns only) and the values.
+static bool xfs_table_write_xcol(const xfs_table* table, const char* path) {
+    file_stream* stream = file_stream_create(path, FILE_COMPRESSION_NONE);
+    if (stream == NULL) {
+        return false;
+    }
+
+    const uint16_t version = XFS_TABLE_FILE_VERSION;
+    const uint16_t reserved = 0;
+
+    uint64_t offset = 4 + 2 + 2 + 4 + 4 + 4;
+    file_stream_write(stream, XFS_TABLE_FILE_MAGIC, 4);
+    file_stream_write(stream, &version, sizeof(version));
+    file_stream_write(stream, &reserved, sizeof(reserved));
+    file_stream_write(stream, &table->dti_hash, sizeof(table->dti_hash));
+    file_stream_write(stream, &table->row_count, sizeof(table->row_count));
+    file_stream_write(stream, &table->column_count, sizeof(table->column_count));
+
+    uint64_t data_offset = offset;
+    for (uint32_t i = 0; i < table->column_count; i++) {
+        data_offset += 2 + strlen(table->columns[i].name) + 1 + 1 + 2 + 8 + 8 + 8;
+    }
+
+    for (uint32_t i = 0; i < table->column_count; i++) {
+        const xfs_table_column* column = &table->columns[i];
+        const uint16_t name_length = (uint16_t)strlen(column->name);
+        const uint8_t kind = (uint8_t)column->kind;
+        const uint64_t size = xfs_table_column_size(column);
+
+        data_offset = xfs_table_align(data_offset);
+
+        file_stream_write(stream, &name_length, sizeof(name_length));
+        file_stream_write(stream, column->name, name_length);
+        file_stream_write(stream, &kind, sizeof(kind));
+        file_stream_write(stream, &column->flags, sizeof(column->flags));
+        file_stream_write(stream, &column->components, sizeof(column->components));
+        file_stream_write(stream, &column->element_count, sizeof(column->element_count));
+        file_stream_write(stream, &data_offset, sizeof(data_offset));
+        file_stream_write(stream, &size, sizeof(size));
+        offset += 2 + name_length + 1 + 1 + 2 + 8 + 8 + 8;
+
+        data_offset += size;
+    }
+
+    for (uint32_t i = 0; i < table->column_count; i++) {
+        const xfs_table_column* column = &table->columns[i];
+        if (column->flags & XFS_TABLE_COLUMN_LIST) {
+            xfs_table_write_block(stream, &offset, &column->row_ends);
+        }
+
+        if (column->kind == XFS_TABLE_KIND_STRING) {
+            xfs_table_write_block(stream, &offset, &column->string_ends);
+        }
+
+        xfs_table_write_block(stream, &offset, &column->values);
+    }
+
+    return file_stream_close(stream);
+}
+
+// Strings in a column aren't null-terminated, they end where the next one starts
+static bool xfs_table_needs_quotes(const char* text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == ',' || text[i] == ';' || text[i] == '"' || text[i] == '\r' || text[i] == '\n') {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Writes text without the surrounding quotes, with quotes inside doubled as in RFC 4180
+static void xfs_table_write_csv_escaped(file_stream* stream, const char* text, size_t length) {
+    for (const char* end = text + length; text < end;) {
+        const char* quote = memchr(text, '"', (size_t)(end - text));
+        const size_t part = quote != NULL ? (size_t)(quote - text) + 1 : (size_t)(end - text);
+        file_stream_write(stream, text, part);
+        if (quote != NULL) {
+            file_stream_write(stream, "\"", 1);
+        }
+        text += part;
+    }
+}
+
+static void xfs_table_write_csv_text(file_stream* stream, const char* text, size_t length) {
+    if (!xfs_table_needs_quotes(text, length)) {
+        file_stream_write(stream, text, length);
+        return;
+    }
+
+    file_stream_write(stream, "\"", 1);
+    xfs_table_write_csv_escaped(stream, text, length);
+    file_stream_write(stream, "\"", 1);
+}
+
+static void xfs_table_write_csv_value(file_stream* stream, xfs_table_kind kind, const uint8_t* value) {
+    char buffer[NUMBER_FORMAT_F64_MAX];
+    int length = 0;
+
+    // Values were copied byte by byte, so they have to be read the same way
+    union {
+        uint8_t u8;
+        uint16_t u16;
+        uint32_t u32;
+        uint64_t u64;
+        int8_t s8;
+        int16_t s16;
+        int32_t s32;
+        int64_t s64;
+        float f32;
+        double f64;
+    } v;
+    memcpy(&v, value, xfs_table_kind_size(kind));
+
+    switch (kind) {
+    case XFS_TABLE_KIND_BOOL: length = snprintf(buffer, sizeof(buffer), "%s", v.u8 ? "true" : "false"); break;
+    case XFS_TABLE_KIND_U8: length = snprintf(buffer, sizeof(buffer), "%u", v.u8); break;
+    case XFS_TABLE_KIND_U16: length = snprintf(buffer, sizeof(buffer), "%u", v.u16); break;
+    case XFS_TABLE_KIND_U32: length = snprintf(buffer, sizeof(buffer), "%u", v.u32); break;
+    case XFS_TABLE_KIND_U64: length = snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)v.u64); break;
+    case XFS_TABLE_KIND_S8: length = snprintf(buffer, sizeof(buffer), "%d", v.s8); break;
+    case XFS_TABLE_KIND_S16: length = snprintf(buffer, sizeof(buffer), "%d", v.s16); break;
+    case XFS_TABLE_KIND_S32: length = snprintf(buffer, sizeof(buffer), "%d", v.s32); break;
+    case XFS_TABLE_KIND_S64: length = snprintf(buffer, sizeof(buffer), "%lld", (long long)v.s64); break;
+    case XFS_TABLE_KIND_F32:
+        // NaN and infinity aren't handled by number_format
+        length = (int)number_format_f32(buffer, v.f32);
+        if (length == 0) {
+            length = snprintf(buffer, sizeof(buffer), "%g", v.f32);
+        }
+        break;
+    case XFS_TABLE_KIND_F64:
+        length = (int)number_format_f64(buffer, v.f64);
+        if (length == 0) {
+            length = snprintf(buffer, sizeof(buffer), "%g", v.f64);
+        }
+        break;
+    case XFS_TABLE_KIND_INDEX:
+        length = v.u32 != UINT32_MAX ? snprintf(buffer, sizeof(buffer), "%u", v.u32) : 0;
+        break;
+    case XFS_TABLE_KIND_STRING:
+        break;
+    }
+
+    file_stream_write(stream, buffer, (size_t)length);
+}
+
+static void xfs_table_write_csv_cell(file_stream* stream, const xfs_table_column* column, uint32_t row) {
+    const uint64_t* row_ends = (const uint64_t*)column->row_ends.data;
+    const uint64_t first = row != 0 ? row_ends[row - 1] : 0;
+    const uint64_t last = row_ends[row];
+
+    if (column->kind == XFS_TABLE_KIND_STRING) {
+        const uint64_t* string_ends = (const uint64_t*)column->string_ends.data;
+
+        const char* values = (const char*)column->values.data;
+        if (last - first <= 1) {
+            const uint64_t start = first != 0 ? string_ends[first - 1] : 0;
+            const uint64_t end = last != first ? string_ends[first] : start;
+            xfs_table_write_csv_text(stream, values + start, (size_t)(end - start));
+            return;
+        }
+
+        // A list of strings is written as a single quoted cell
+        file_stream_write(stream, "\"", 1);
+        for (uint64_t i = first; i < last; i++) {
+            const uint64_t start = i != 0 ? string_ends[i - 1] : 0;
+            xfs_table_write_csv_escaped(stream, values + start, (size_t)(string_ends[i] - start));
+            if (i + 1 < last) {
+                file_stream_write(stream, ";", 1);
+            }
+        }
+        file_stream_write(stream, "\"", 1);
+        return;
+    }
+
+    // Components are separated by spaces and list elements by semicolons
+    const size_t size = xfs_table_kind_size(column->kind);
+    const uint8_t* value = column->values.data + first * size * column->components;
+    for (uint64_t i = first; i < last; i++) {
+        for (uint16_t j = 0; j < column->components; j++) {
+            if (j != 0) {
+                file_stream_write(stream, " ", 1);
+            }
+            xfs_table_write_csv_value(stream, column->kind, value);
+            value += size;
+        }
+
+        if (i + 1 < last) {
+            file_stream_write(stream, ";", 1);
+        }
+    }
+}
+
+static bool xfs_table_write_csv(const xfs_table* table, const char* path) {
+    file_stream* stream = file_stream_create(path, FILE_COMPRESSION_NONE);
+    if (stream == NULL) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < table->column_count; i++) {
+        const xfs_table_column* column = &table->columns[i];
+        if (i != 0) {
+            file_stream_write(stream, ",", 1);
+        }
+        xfs_table_write_csv_text(stream, column->name, strlen(column->name));
+    }
+    file_stream_write(stream, "\n", 1);
+
+    for (uint32_t row = 0; row < table->row_count; row++) {
+        for (uint32_t i = 0; i < table->column_count; i++) {
+            if (i != 0) {
+                file_stream_write(stream, ",", 1);
+            }
+            xfs_table_write_csv_cell(stream, &table->columns[i], row);
+        }
+        file_stream_write(stream, "\n", 1);
+    }
+
+    return file_stream_close(stream);
+}
+
+// "<dir>/<dti hash>[-<definition index>].<extension>", free the result with free
+static char* xfs_table_file_path(const xfs_table_set* set, size_t index, const char* dir, const char* extension) {
+    bool is_shared = false;
+    for (size_t i = 0; i < set->count && !is_shared; i++) {
+        is_shared = i != index && set->tables[i].row_count != 0 && set->tables[i].dti_hash == set->tables[index].dti_hash;
+    }
+
+    char name[32];
+    if (is_shared) {
+        snprintf(name, sizeof(name), "%08x-%zu%s", set->tables[index].dti_hash, index, extension);
+    } else {
+        snprintf(name, sizeof(name), "%08x%s", set->tables[index].dti_hash, extension);
+    }
+
+    return util_fs_join(dir, name);
+}
+
+typedef bool (*xfs_table_writer)(const xfs_table* table, const char* path);
+
+// With keep_unchanged the file is written next to path and only moved over it if they differ
+static bool xfs_table_write_file(const xfs_table* table, const char* path, bool keep_unchanged, xfs_table_writer write) {
+    if (!keep_unchanged) {
+        return write(table, path);
+    }
+
+    char* temp_path = util_fs_temp_path(path);
+    const bool written = temp_path != NULL && write(table, temp_path) && util_fs_replace_if_changed(temp_path, path);
+    if (!written && temp_path != NULL) {
+        remove(temp_path);
+    }
+
+    free(temp_path);
+
+    return written;
+}
+
+bool xfs_table_set_write(const xfs_table_set* set, const char* dir, bool keep_unchanged) {
+    if (!util_fs_exists(dir) && !util_fs_make_dir(dir)) {
+        fprintf(stderr, "Failed to create table directory: %s\n", dir);
+        return false;
+    }
+
+    bool result = true;
+    for (size_t i = 0; i < set->count && result; i++) {
+        const xfs_table* table = &set->tables[i];
+        if (table->row_count == 0) {
+            continue;
+        }
+
+        char* xcol_path = xfs_table_file_path(set, i, dir, ".xcol");
+        char* csv_path = xfs_table_file_path(set, i, dir, ".csv");
+
+        result = xcol_path != NULL && csv_path != NULL
+            && xfs_table_write_file(table, xcol_path, keep_unchanged, xfs_table_write_xcol)
+            && xfs_table_write_file(table, csv_path, keep_unchanged, xfs_table_write_csv);
+        if (!result) {
+            fprintf(stderr, "Failed to write table for %08x to %s\n", table->dti_hash, dir);
+        }
+
+        free(xcol_path);
+        free(csv_path);
+    }
+
+    return result;
+}
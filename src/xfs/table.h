@@ -0,0 +1,51 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "xfs.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Tables of <name>.xfs are written to the directory <name>.tables, one file per definition
+#define XFS_TABLE_DIR_EXTENSION ".tables"
+#define XFS_TABLE_FILE_MAGIC "XCOL"
+#define XFS_TABLE_FILE_VERSION 1
+
+// Element types of a column in a .xcol file
+typedef enum xfs_table_kind {
+    XFS_TABLE_KIND_BOOL = 0,
+    XFS_TABLE_KIND_U8 = 1,
+    XFS_TABLE_KIND_U16 = 2,
+    XFS_TABLE_KIND_U32 = 3,
+    XFS_TABLE_KIND_U64 = 4,
+    XFS_TABLE_KIND_S8 = 5,
+    XFS_TABLE_KIND_S16 = 6,
+    XFS_TABLE_KIND_S32 = 7,
+    XFS_TABLE_KIND_S64 = 8,
+    XFS_TABLE_KIND_F32 = 9,
+    XFS_TABLE_KIND_F64 = 10,
+    XFS_TABLE_KIND_STRING = 11,
+    XFS_TABLE_KIND_INDEX = 12, //< u32 $index of an object or position in an array, UINT32_MAX for none
+} xfs_table_kind;
+
+// The column holds a variable number of elements per row
+#define XFS_TABLE_COLUMN_LIST 0x1
+
+// Every object of a definition becomes a row of that definition's table, with one column per
+// property after the implicit $index, $parent and $array_index columns (UINT32_MAX where the
+// object has no parent or isn't an array element). Rows are filled straight from the objects
+// xfs_load_stream decodes, use xfs_table_on_defs and xfs_table_on_object as its visitor.
+typedef struct xfs_table_set xfs_table_set;
+
+xfs_table_set* xfs_table_set_create(void);
+void xfs_table_set_destroy(xfs_table_set* set);
+
+bool xfs_table_on_defs(const xfs* xfs, void* user_data);
+bool xfs_table_on_object(const xfs* xfs, const xfs_object* obj, const xfs_object_location* location, void* user_data);
+
+// Writes <dti hash>.xcol and <dti hash>.csv for every definition with at least one object into
+// dir, which is created if needed. Definitions sharing a hash get "-<definition index>" appended.
+// With keep_unchanged, files that already hold exactly what would be written are left untouched.
+bool xfs_table_set_write(const xfs_table_set* set, const char* dir, bool keep_unchanged);
+
+#endif // TABLE_H
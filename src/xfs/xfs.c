@@ -1,6 +1,10 @@
 #include "xfs.h"
+#include "codec.h"
+#include "def_cache.h"
+#include "xfs_pod.h"
 #include "util/binary_reader.h"
 #include "util/binary_writer.h"
+#include "util/file_map.h"
 
 #include "xfs/v16/arch_32.h"
 #include "xfs/v15/arch_64.h"
@@ -10,23 +14,73 @@
 #include <string.h>
 
 
-#define XFS_ERROR(...) \
-    fprintf(stderr, __VA_ARGS__); \
-    xfs_free(xfs); \
-    binary_reader_destroy(reader); \
-    return XFS_RESULT_ERROR
-
+// State of xfs_load_stream
+typedef struct xfs_stream {
+    const xfs_load_visitor* visitor;
+    uint32_t object_count;
+    uint32_t parent; //< Index of the object whose fields are being loaded
+    uint32_t array_index; //< Element of the field being loaded, XFS_NO_ARRAY_INDEX for single values
+    char* path; //< Path of the field being loaded
+    size_t path_length;
+    size_t path_capacity;
+    bool failed;
+} xfs_stream;
+
+static int xfs_load_impl(binary_reader* reader, const char* name, arena* arena, xfs_def_cache* def_cache, xfs* xfs);
+static int xfs_load_defs(binary_reader* reader, xfs* xfs);
 static xfs_object* xfs_load_object(xfs* xfs, binary_reader* r);
+static size_t xfs_stream_enter(xfs_stream* stream, uint32_t parent, const char* field, int64_t index);
+static void xfs_stream_leave(xfs_stream* stream, size_t path_length);
+static void xfs_stream_visit(xfs* xfs, xfs_object* obj, uint32_t parent, uint32_t array_index);
 static bool xfs_load_data(xfs* xfs, xfs_type_t type, xfs_data* data, binary_reader* r);
 
 static bool xfs_save_object(const xfs* xfs, const xfs_object* obj, binary_writer* w);
 static bool xfs_save_data(const xfs * xfs, const xfs_data* data, xfs_type_t type, binary_writer* w);
 
-static void xfs_free_def(xfs_def* def);
-static void xfs_free_property_def(xfs_property_def* prop);
-static void xfs_free_object(xfs_object* obj);
-static void xfs_free_field(xfs_field* field);
-static void xfs_free_data(xfs_type_t type, xfs_data* data);
+static void xfs_free_def(const xfs* xfs, xfs_def* def);
+static void xfs_free_property_def(const xfs* xfs, xfs_property_def* prop);
+static void xfs_free_object(const xfs* xfs, xfs_object* obj);
+static void xfs_free_field(const xfs* xfs, xfs_field* field);
+static void xfs_free_data(const xfs* xfs, xfs_type_t type, xfs_data* data);
+static void xfs_free_string(const xfs* xfs, char* str);
+
+// Nodes of a loaded tree come out of the xfs's arena if it has one. xfs is NULL for loose values.
+static void* xfs_alloc(const xfs* xfs, size_t size) {
+    return xfs != NULL && xfs->arena != NULL ? arena_alloc(xfs->arena, size) : malloc(size);
+}
+
+static void* xfs_alloc_zeroed(const xfs* xfs, size_t count, size_t size) {
+    if (xfs == NULL || xfs->arena == NULL) {
+        return calloc(count, size);
+    }
+
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void* ptr = arena_alloc(xfs->arena, count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+static char* xfs_strdup(const xfs* xfs, const char* str) {
+    const size_t size = strlen(str) + 1;
+    char* copy = (char*)xfs_alloc(xfs, size);
+    if (copy != NULL) {
+        memcpy(copy, str, size);
+    }
+
+    return copy;
+}
+
+static void xfs_release(const xfs* xfs, void* ptr) {
+    if (xfs == NULL || xfs->arena == NULL) {
+        free(ptr);
+    }
+}
 
 // Detect if a v15 file is actually a hybrid v16 structure
 static bool detect_hybrid_structure(binary_reader* reader, xfs* xfs) {
@@ -37,16 +91,17 @@ static bool detect_hybrid_structure(binary_reader* reader, xfs* xfs) {
     // Save current position
     size_t pos = binary_reader_tell(reader);
     
-    // Read all definition offsets
-    uint32_t* offsets_32 = calloc(xfs->header.def_count * 2, sizeof(uint32_t));
-    binary_reader_read(reader, offsets_32, xfs->header.def_count * 2 * sizeof(uint32_t));
-    
     // Check if this looks like v16 structure (32-bit offsets with 32-bit padding)
     // In v16 hybrid files, every other 32-bit value should be 0 (padding)
+    // Offsets are checked as they are read, the loader reads them again afterwards anyway
+    uint32_t first_offset = 0;
     bool looks_like_v16 = true;
     for (uint32_t i = 0; i < xfs->header.def_count; i++) {
-        uint32_t offset_low = offsets_32[i * 2];
-        uint32_t offset_high = offsets_32[i * 2 + 1];
+        uint32_t offset_low = binary_reader_read_u32(reader);
+        uint32_t offset_high = binary_reader_read_u32(reader);
+        if (i == 0) {
+            first_offset = offset_low;
+        }
         
         // In v16 hybrid, high should always be 0
         if (offset_high != 0) {
@@ -61,10 +116,10 @@ static bool detect_hybrid_structure(binary_reader* reader, xfs* xfs) {
         }
     }
     
-    if (looks_like_v16 && offsets_32[0] > 0) {
+    if (looks_like_v16 && first_offset > 0) {
         // Further verify by checking the structure at first definition
         // Note: offsets are relative to the start of definition data (after header)
-        binary_reader_seek(reader, sizeof(xfs_header) + offsets_32[0], SEEK_SET);
+        binary_reader_seek(reader, sizeof(xfs_header) + first_offset, SEEK_SET);
         
         uint32_t dti_hash;
         uint32_t prop_count_field;
@@ -80,14 +135,12 @@ static bool detect_hybrid_structure(binary_reader* reader, xfs* xfs) {
             binary_reader_read(reader, &name_offset, sizeof(uint32_t));
             
             if (name_offset > 0 && name_offset < xfs->header.def_size) {
-                free(offsets_32);
                 binary_reader_seek(reader, pos, SEEK_SET);
                 return true; // This is a v16 hybrid
             }
         }
     }
     
-    free(offsets_32);
     binary_reader_seek(reader, pos, SEEK_SET);
     return false;
 }
@@ -97,15 +150,105 @@ int xfs_load(const char* path, xfs* xfs) {
         return XFS_RESULT_ERROR;
     }
 
-    binary_reader* reader = binary_reader_create(path);
+    // Seeking around while detecting the structure is free on a mapping, and nothing in the xfs
+    // points into it, so it can go right after
+    file_map* map = file_map_create(path);
+    if (map == NULL) {
+        fprintf(stderr, "Failed to open XFS file: %s\n", path);
+        return XFS_RESULT_ERROR;
+    }
 
-    binary_reader_read(reader, &xfs->header, sizeof(xfs_header));
-    if (xfs->header.magic != XFS_MAGIC) {
-        fprintf(stderr, "Invalid XFS file: %s\n", path);
-        binary_reader_destroy(reader);
-        return XFS_RESULT_INVALID;
+    const int result = xfs_load_buffer(map->data, map->size, path, xfs);
+    file_map_destroy(map);
+
+    return result;
+}
+
+int xfs_load_buffer(const uint8_t* data, size_t size, const char* name, xfs* xfs) {
+    return xfs_load_buffer_arena(data, size, name, NULL, NULL, xfs);
+}
+
+int xfs_load_buffer_arena(const uint8_t* data, size_t size, const char* name, arena* arena, xfs_def_cache* def_cache, xfs* xfs) {
+    if (data == NULL || xfs == NULL) {
+        return XFS_RESULT_ERROR;
+    }
+
+    // Only read from, the reader just doesn't know about const
+    binary_reader* reader = binary_reader_create_buffer((uint8_t*)data, size);
+    if (reader == NULL) {
+        return XFS_RESULT_ERROR;
+    }
+
+    xfs->stream = NULL;
+    const int result = xfs_load_impl(reader, name != NULL ? name : "(memory)", arena, def_cache, xfs);
+    binary_reader_destroy(reader);
+
+    return result;
+}
+
+int xfs_load_stream(const char* path, xfs* xfs, const xfs_load_visitor* visitor) {
+    if (path == NULL || xfs == NULL || visitor == NULL) {
+        return XFS_RESULT_ERROR;
+    }
+
+    file_map* map = file_map_create(path);
+    if (map == NULL) {
+        fprintf(stderr, "Failed to open XFS file: %s\n", path);
+        return XFS_RESULT_ERROR;
+    }
+
+    const int result = xfs_load_stream_buffer(map->data, map->size, path, xfs, visitor);
+    file_map_destroy(map);
+
+    return result;
+}
+
+int xfs_load_stream_buffer(const uint8_t* data, size_t size, const char* name, xfs* xfs, const xfs_load_visitor* visitor) {
+    if (data == NULL || xfs == NULL || visitor == NULL) {
+        return XFS_RESULT_ERROR;
+    }
+
+    xfs_stream stream = {
+        .visitor = visitor,
+        .object_count = 0,
+        .parent = XFS_NO_PARENT,
+        .array_index = XFS_NO_ARRAY_INDEX,
+        .path = NULL,
+        .path_length = 0,
+        .path_capacity = 0,
+        .failed = false,
+    };
+
+    xfs_stream_enter(&stream, XFS_NO_PARENT, "root", -1);
+    if (stream.failed) {
+        return XFS_RESULT_ERROR;
+    }
+
+    // Only read from, the reader just doesn't know about const
+    binary_reader* reader = binary_reader_create_buffer((uint8_t*)data, size);
+    if (reader == NULL) {
+        free(stream.path);
+        return XFS_RESULT_ERROR;
+    }
+
+    xfs->stream = &stream;
+    int result = xfs_load_impl(reader, name != NULL ? name : "(memory)", NULL, NULL, xfs);
+    xfs->stream = NULL;
+
+    binary_reader_destroy(reader);
+
+    free(stream.path);
+
+    if (result == XFS_RESULT_OK && stream.failed) {
+        xfs_free(xfs);
+        result = XFS_RESULT_ERROR;
     }
 
+    return result;
+}
+
+// Parses the definition block, which decides how the rest is read as well
+static int xfs_load_defs(binary_reader* reader, xfs* xfs) {
     // Detect actual structure type
     bool is_hybrid = detect_hybrid_structure(reader, xfs);
     
@@ -116,14 +259,12 @@ int xfs_load(const char* path, xfs* xfs) {
             printf("Detected hybrid v15/v16 structure\n");
             xfs->actual_structure = XFS_STRUCTURE_V16_HYBRID;
             if (xfs_v16_32_load(reader, xfs) != XFS_RESULT_OK) {
-                binary_reader_destroy(reader);
                 return XFS_RESULT_ERROR;
             }
         } else {
             // True v15 file
             xfs->actual_structure = XFS_STRUCTURE_V15_64BIT;
             if (xfs_v15_64_load(reader, xfs) != XFS_RESULT_OK) {
-                binary_reader_destroy(reader);
                 return XFS_RESULT_ERROR;
             }
         }
@@ -131,23 +272,63 @@ int xfs_load(const char* path, xfs* xfs) {
     case XFS_VERSION_16:
         xfs->actual_structure = XFS_STRUCTURE_V16_32BIT;
         if (xfs_v16_32_load(reader, xfs) != XFS_RESULT_OK) {
-            binary_reader_destroy(reader);
             return XFS_RESULT_ERROR;
         }
         break;
     default:
         fprintf(stderr, "Unsupported XFS version: %04X-%04X\n", xfs->header.major_version, xfs->header.minor_version);
-        binary_reader_destroy(reader);
         return XFS_RESULT_INVALID;
     }
 
+    xfs_def_codec_attach(xfs);
+
+    return XFS_RESULT_OK;
+}
+
+static int xfs_load_impl(binary_reader* reader, const char* name, arena* arena, xfs_def_cache* def_cache, xfs* xfs) {
+    xfs->arena = arena;
+    xfs->string_buffer = NULL;
+    xfs->string_buffer_size = 0;
+    xfs->owns_string_buffer = false;
+    xfs->shares_defs = false;
+
+    binary_reader_read(reader, &xfs->header, sizeof(xfs_header));
+    if (xfs->header.magic != XFS_MAGIC) {
+        fprintf(stderr, "Invalid XFS file: %s\n", name);
+        return XFS_RESULT_INVALID;
+    }
+
+    // The definition block is the same in most files of a game, it's compared in place in the
+    // buffer and skipped if the cache has it already. The structure detection only depends on it too.
+    const uint8_t* def_block = NULL;
+    if (def_cache != NULL && reader->file == NULL && xfs->header.def_size >= 0
+        && reader->buffer_size - reader->buffer_pos >= (size_t)xfs->header.def_size) {
+        def_block = reader->buffer + reader->buffer_pos;
+    }
+
+    if (xfs_def_cache_find(def_cache, def_block, def_block != NULL ? (size_t)xfs->header.def_size : 0, xfs)) {
+        binary_reader_seek(reader, xfs->header.def_size, SEEK_CUR);
+    } else {
+        const int result = xfs_load_defs(reader, xfs);
+        if (result != XFS_RESULT_OK) {
+            return result;
+        }
+
+        xfs_def_cache_add(def_cache, def_block, def_block != NULL ? (size_t)xfs->header.def_size : 0, xfs);
+    }
+
+    if (xfs->stream != NULL && xfs->stream->visitor->on_defs != NULL) {
+        xfs->stream->failed = !xfs->stream->visitor->on_defs(xfs, xfs->stream->visitor->user_data);
+    }
+
     xfs->root = xfs_load_object(xfs, reader);
     if (xfs->root == NULL) {
-        XFS_ERROR("Failed to load root object\n");
+        // The reader belongs to the caller
+        fprintf(stderr, "Failed to load root object\n");
+        xfs_free(xfs);
+        return XFS_RESULT_ERROR;
     }
 
-    binary_reader_destroy(reader);
-
     return XFS_RESULT_OK;
 }
 
@@ -209,18 +390,60 @@ int xfs_save(const char* path, const xfs* xfs) {
         return XFS_RESULT_ERROR;
     }
 
-    binary_writer_destroy(writer);
+    if (!binary_writer_destroy(writer)) {
+        fprintf(stderr, "Failed to write XFS file: %s\n", path);
+        return XFS_RESULT_ERROR;
+    }
 
     return XFS_RESULT_OK;
 }
 
 void xfs_free(xfs* xfs) {
-    for (uint32_t i = 0; i < xfs->header.def_count; i++) {
-        xfs_free_def(&xfs->defs[i]);
+    // A tree in an arena goes with it. Freeing objects looks at their definitions, so those go last.
+    if (xfs->arena == NULL) {
+        xfs_free_object(xfs, xfs->root);
+    }
+
+    if (!xfs->shares_defs) {
+        for (uint32_t i = 0; i < xfs->header.def_count; i++) {
+            xfs_free_def(xfs, &xfs->defs[i]);
+        }
+
+        free(xfs->defs);
+    }
+
+    if (xfs->owns_string_buffer) {
+        free(xfs->string_buffer);
+    }
+
+    xfs->string_buffer = NULL;
+    xfs->string_buffer_size = 0;
+    xfs->owns_string_buffer = false;
+    xfs->arena = NULL;
+    xfs->defs = NULL;
+    xfs->shares_defs = false;
+}
+
+bool xfs_is_borrowed_string(const xfs* xfs, const char* str) {
+    if (xfs->string_buffer == NULL || str == NULL) {
+        return false;
     }
 
-    xfs_free_object(xfs->root);
-    free(xfs->defs);
+    // Compared as integers, relational operators on unrelated pointers are undefined
+    const uintptr_t begin = (uintptr_t)xfs->string_buffer;
+    const uintptr_t ptr = (uintptr_t)str;
+    return ptr >= begin && ptr < begin + xfs->string_buffer_size;
+}
+
+bool is_xfs_buffer(const void* data, size_t size) {
+    xfs_header header;
+    if (data == NULL || size < sizeof(xfs_header)) {
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(xfs_header));
+
+    return header.magic == XFS_MAGIC;
 }
 
 bool is_xfs_file(const char* path) {
@@ -240,65 +463,188 @@ bool is_xfs_file(const char* path) {
     return header.magic == XFS_MAGIC;
 }
 
-static void xfs_free_def(xfs_def* def) {
+size_t xfs_pod_size(xfs_type_t type) {
+    // Packed values are the bytes of their value struct, so every component is kept and reading
+    // them back is a copy. The file encoding differs for rectf, which it stores as t l b r.
+    switch (type) {
+    case XFS_TYPE_BOOL: return sizeof(bool);
+    case XFS_TYPE_U8: return sizeof(uint8_t);
+    case XFS_TYPE_U16: return sizeof(uint16_t);
+    case XFS_TYPE_U32: return sizeof(uint32_t);
+    case XFS_TYPE_U64: return sizeof(uint64_t);
+    case XFS_TYPE_S8: return sizeof(int8_t);
+    case XFS_TYPE_S16: return sizeof(int16_t);
+    case XFS_TYPE_S32: return sizeof(int32_t);
+    case XFS_TYPE_S64: return sizeof(int64_t);
+    case XFS_TYPE_F32: return sizeof(float);
+    case XFS_TYPE_F64: return sizeof(double);
+    case XFS_TYPE_COLOR: return sizeof(xfs_color);
+    case XFS_TYPE_POINT: return sizeof(xfs_point);
+    case XFS_TYPE_SIZE: return sizeof(xfs_size);
+    case XFS_TYPE_RECT: return sizeof(xfs_rect);
+    case XFS_TYPE_MATRIX: return sizeof(xfs_matrix);
+    case XFS_TYPE_VECTOR3: return sizeof(xfs_vector3);
+    case XFS_TYPE_VECTOR4: return sizeof(xfs_vector4);
+    case XFS_TYPE_QUATERNION: return sizeof(xfs_quaternion);
+    case XFS_TYPE_TIME: return sizeof(xfs_time);
+    case XFS_TYPE_FLOAT2: return sizeof(xfs_float2);
+    case XFS_TYPE_FLOAT3: return sizeof(xfs_float3);
+    case XFS_TYPE_FLOAT4: return sizeof(xfs_float4);
+    case XFS_TYPE_FLOAT3x3: return sizeof(xfs_float3x3);
+    case XFS_TYPE_FLOAT4x3: return sizeof(xfs_float4x3);
+    case XFS_TYPE_FLOAT4x4: return sizeof(xfs_float4x4);
+    case XFS_TYPE_EASECURVE: return sizeof(xfs_easecurve);
+    case XFS_TYPE_LINE: return sizeof(xfs_line);
+    case XFS_TYPE_LINESEGMENT: return sizeof(xfs_linesegment);
+    case XFS_TYPE_RAY: return sizeof(xfs_ray);
+    case XFS_TYPE_PLANE: return sizeof(xfs_plane);
+    case XFS_TYPE_SPHERE: return sizeof(xfs_sphere);
+    case XFS_TYPE_CAPSULE: return sizeof(xfs_capsule);
+    case XFS_TYPE_AABB: return sizeof(xfs_aabb);
+    case XFS_TYPE_OBB: return sizeof(xfs_obb);
+    case XFS_TYPE_CYLINDER: return sizeof(xfs_cylinder);
+    case XFS_TYPE_TRIANGLE: return sizeof(xfs_triangle);
+    case XFS_TYPE_CONE: return sizeof(xfs_cone);
+    case XFS_TYPE_TORUS: return sizeof(xfs_torus);
+    case XFS_TYPE_ELLIPSOID: return sizeof(xfs_ellipsoid);
+    case XFS_TYPE_RANGE: return sizeof(xfs_range);
+    case XFS_TYPE_RANGEF: return sizeof(xfs_rangef);
+    case XFS_TYPE_RANGEU16: return sizeof(xfs_rangeu16);
+    case XFS_TYPE_HERMITECURVE: return sizeof(xfs_hermitecurve);
+    case XFS_TYPE_FLOAT3x4: return sizeof(xfs_float3x4);
+    case XFS_TYPE_LINESEGMENT4: return sizeof(xfs_linesegment4);
+    case XFS_TYPE_AABB4: return sizeof(xfs_aabb4);
+    case XFS_TYPE_VECTOR2: return sizeof(xfs_vector2);
+    case XFS_TYPE_MATRIX33: return sizeof(xfs_matrix33);
+    case XFS_TYPE_RECT3D_XZ: return sizeof(xfs_rect3d_xz);
+    case XFS_TYPE_RECT3D: return sizeof(xfs_rect3d);
+    case XFS_TYPE_PLANE_XZ: return sizeof(xfs_plane_xz);
+    case XFS_TYPE_RAY_Y: return sizeof(xfs_ray_y);
+    case XFS_TYPE_POINTF: return sizeof(xfs_pointf);
+    case XFS_TYPE_SIZEF: return sizeof(xfs_sizef);
+    case XFS_TYPE_RECTF: return sizeof(xfs_rectf);
+    default: return 0;
+    }
+}
+
+size_t xfs_pack_value(xfs_type_t type, const xfs_data* value, uint8_t* buffer) {
+    const size_t size = xfs_pod_size(type);
+    if (type == XFS_TYPE_BOOL) {
+        buffer[0] = value->value.b ? 1 : 0;
+    } else if (size != 0) {
+        memcpy(buffer, &value->value, size);
+    }
+
+    return size;
+}
+
+uint8_t* xfs_pack_values(xfs_type_t type, const xfs_data* values, uint32_t count, size_t* size) {
+    const size_t element_size = xfs_pod_size(type);
+    if (element_size == 0 || count == 0) {
+        return NULL;
+    }
+
+    uint8_t* data = malloc(element_size * count);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        xfs_pack_value(type, &values[i], data + element_size * i);
+    }
+
+    *size = element_size * count;
+
+    return data;
+}
+
+bool xfs_unpack_values(xfs_type_t type, const uint8_t* data, size_t size, xfs_data* values, uint32_t count) {
+    const size_t element_size = xfs_pod_size(type);
+    if (element_size == 0 || size / element_size != count || size % element_size != 0) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* const element = data + element_size * i;
+        memset(&values[i], 0, sizeof(xfs_data));
+        if (type == XFS_TYPE_BOOL) {
+            values[i].value.b = element[0] != 0;
+        } else {
+            memcpy(&values[i].value, element, element_size);
+        }
+    }
+
+    return true;
+}
+
+static void xfs_free_def(const xfs* xfs, xfs_def* def) {
     for (uint32_t i = 0; i < def->prop_count; i++) {
-        xfs_free_property_def(&def->props[i]);
+        xfs_free_property_def(xfs, &def->props[i]);
     }
 
     free(def->props);
 }
 
-static void xfs_free_property_def(xfs_property_def* prop) {
-    free(prop->name);
+static void xfs_free_property_def(const xfs* xfs, xfs_property_def* prop) {
+    xfs_free_string(xfs, prop->name);
 }
 
-static void xfs_free_object(xfs_object* obj) {
+static void xfs_free_object(const xfs* xfs, xfs_object* obj) {
     if (obj == NULL) {
         return;
     }
 
-    for (uint32_t i = 0; i < obj->def->prop_count; i++) {
-        xfs_free_field(&obj->fields[i]);
+    // Fields are already gone for objects that went through xfs_load_stream
+    if (obj->fields != NULL) {
+        for (uint32_t i = 0; i < obj->def->prop_count; i++) {
+            xfs_free_field(xfs, &obj->fields[i]);
+        }
     }
 
     free(obj->fields);
     free(obj);
 }
 
-void xfs_free_field(xfs_field* field) {
+void xfs_free_field(const xfs* xfs, xfs_field* field) {
     if (field == NULL) {
         return;
     }
 
     if (field->is_array) {
         for (uint32_t j = 0; j < field->data.array.count; j++) {
-            xfs_free_data(field->type, &field->data.array.entries[j]);
+            xfs_free_data(xfs, field->type, &field->data.array.entries[j]);
         }
 
         free(field->data.array.entries);
     } else {
-        xfs_free_data(field->type, &field->data);
+        xfs_free_data(xfs, field->type, &field->data);
     }
 }
 
-void xfs_free_data(xfs_type_t type, xfs_data* data) {
+void xfs_free_data(const xfs* xfs, xfs_type_t type, xfs_data* data) {
     if (data == NULL) {
         return;
     }
 
     if (type == XFS_TYPE_CLASS || type == XFS_TYPE_CLASSREF) {
-        xfs_free_object(data->obj);
+        xfs_free_object(xfs, data->obj);
     } else if (type == XFS_TYPE_STRING || type == XFS_TYPE_CSTRING) {
-        free(data->str);
+        xfs_free_string(xfs, data->str);
     } else if (type == XFS_TYPE_CUSTOM) {
         for (uint8_t j = 0; j < data->custom.count; j++) {
-            free(data->custom.values[j]);
+            xfs_free_string(xfs, data->custom.values[j]);
         }
 
         free((void*)data->custom.values);
     }
 }
 
+static void xfs_free_string(const xfs* xfs, char* str) {
+    if (!xfs_is_borrowed_string(xfs, str)) {
+        free(str);
+    }
+}
+
 static xfs_object* xfs_load_object(xfs* xfs, binary_reader* r) {
     xfs_class_ref ref;
     if (binary_reader_read(r, &ref, sizeof(xfs_class_ref)) != BINARY_READER_OK) {
@@ -310,7 +656,7 @@ static xfs_object* xfs_load_object(xfs* xfs, binary_reader* r) {
         return NULL; // Skip invalid class ID
     }
 
-    xfs_object* obj = calloc(1, sizeof(xfs_object));
+    xfs_object* obj = (xfs_object*)xfs_alloc_zeroed(xfs, 1, sizeof(xfs_object));
     if (obj == NULL) {
         fprintf(stderr, "Failed to allocate memory for XFS object\n");
         return NULL;
@@ -319,14 +665,21 @@ static xfs_object* xfs_load_object(xfs* xfs, binary_reader* r) {
     obj->def = &xfs->defs[ref.class_id >> 1];
     obj->def_id = ref.class_id >> 1;
     obj->id = ref.var;
-    obj->fields = calloc(obj->def->prop_count, sizeof(xfs_field));
+    obj->fields = (xfs_field*)xfs_alloc_zeroed(xfs, obj->def->prop_count, sizeof(xfs_field));
 
     if (obj->fields == NULL) {
         fprintf(stderr, "Failed to allocate memory for XFS object fields\n");
-        free(obj);
+        xfs_release(xfs, obj);
         return NULL;
     }
 
+    xfs_stream* const stream = xfs->stream;
+    const uint32_t parent = stream != NULL ? stream->parent : XFS_NO_PARENT;
+    const uint32_t array_index = stream != NULL ? stream->array_index : XFS_NO_ARRAY_INDEX;
+    if (stream != NULL) {
+        obj->index = stream->object_count++;
+    }
+
     const uint32_t size = binary_reader_read_u32(r);
     const size_t start_pos = binary_reader_tell(r);
 
@@ -334,48 +687,166 @@ static xfs_object* xfs_load_object(xfs* xfs, binary_reader* r) {
         (void)binary_reader_read_u32(r);
     }
 
-    for (uint32_t i = 0; i < obj->def->prop_count; i++) {
-        const xfs_property_def* prop = &obj->def->props[i];
-        xfs_field* field = &obj->fields[i];
-
-        field->name = prop->name;
-        field->type = (xfs_type_t)prop->type;
-        field->is_array = false;
-
-        const uint32_t count = binary_reader_read_u32(r);
-        if (count == 0 || count > 1) {
-            field->is_array = true;
-            field->data.array.count = count;
-            field->data.array.entries = calloc(count, sizeof(xfs_data));
-            if (field->data.array.entries == NULL) {
-                fprintf(stderr, "Failed to allocate memory for XFS array entries\n");
-                free(obj->fields);
-                free(obj);
-                binary_reader_seek(r, (int)(start_pos + size), SEEK_SET);
-                return NULL;
+    // Generated code only covers plain loading, streaming keeps track of paths on the way
+    const xfs_def_codec* const codec = stream == NULL ? obj->def->codec : NULL;
+    bool loaded = true;
+    if (codec != NULL) {
+        loaded = codec->load(xfs, obj, r);
+    } else {
+        for (uint32_t i = 0; loaded && i < obj->def->prop_count; i++) {
+            const xfs_property_def* prop = &obj->def->props[i];
+            xfs_field* field = &obj->fields[i];
+
+            field->name = prop->name;
+            field->type = (xfs_type_t)prop->type;
+
+            const uint32_t count = binary_reader_read_u32(r);
+            loaded = xfs_codec_load_values(xfs, obj, field, count, r);
+        }
+    }
+
+    if (!loaded) {
+        xfs_release(xfs, obj->fields);
+        xfs_release(xfs, obj);
+        binary_reader_seek(r, (int)(start_pos + size), SEEK_SET);
+        return NULL;
+    }
+
+    if (stream != NULL) {
+        xfs_stream_visit(xfs, obj, parent, array_index);
+    }
+
+    return obj;
+}
+
+bool xfs_codec_load_values(xfs* xfs, const xfs_object* obj, xfs_field* field, uint32_t count, binary_reader* r) {
+    xfs_stream* const stream = xfs->stream;
+    field->is_array = false;
+
+    // Only objects need to know where they are while streaming
+    const bool track_path = stream != NULL && (field->type == XFS_TYPE_CLASS || field->type == XFS_TYPE_CLASSREF);
+
+    if (count == 0 || count > 1) {
+        field->is_array = true;
+        field->data.array.count = count;
+        field->data.array.entries = xfs_codec_alloc_entries(xfs, count);
+        if (field->data.array.entries == NULL) {
+            return false;
+        }
+
+        for (uint32_t j = 0; j < count; j++) {
+            const size_t path_length = track_path ? xfs_stream_enter(stream, obj->index, field->name, j) : 0;
+            const bool loaded = xfs_load_data(xfs, field->type, &field->data.array.entries[j], r);
+            if (track_path) {
+                xfs_stream_leave(stream, path_length);
             }
 
-            for (uint32_t j = 0; j < count; j++) {
-                if (!xfs_load_data(xfs, field->type, &field->data.array.entries[j], r)) {
-                    fprintf(stderr, "Failed to load array entry\n");
-                    free(obj->fields);
-                    free(obj);
-                    binary_reader_seek(r, (int)(start_pos + size), SEEK_SET);
-                    return NULL;
-                }
+            if (!loaded) {
+                fprintf(stderr, "Failed to load array entry\n");
+                return false;
             }
-        } else {
-            if (!xfs_load_data(xfs, field->type, &field->data, r)) {
-                fprintf(stderr, "Failed to load field value\n");
-                free(obj->fields);
-                free(obj);
-                binary_reader_seek(r, (int)(start_pos + size), SEEK_SET);
-                return NULL;
+        }
+    } else {
+        const size_t path_length = track_path ? xfs_stream_enter(stream, obj->index, field->name, -1) : 0;
+        const bool loaded = xfs_load_data(xfs, field->type, &field->data, r);
+        if (track_path) {
+            xfs_stream_leave(stream, path_length);
+        }
+
+        if (!loaded) {
+            fprintf(stderr, "Failed to load field value\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+xfs_data* xfs_codec_alloc_entries(xfs* xfs, uint32_t count) {
+    xfs_data* entries = (xfs_data*)xfs_alloc_zeroed(xfs, count, sizeof(xfs_data));
+    if (entries == NULL) {
+        fprintf(stderr, "Failed to allocate memory for XFS array entries\n");
+    }
+
+    return entries;
+}
+
+bool xfs_codec_save_values(const xfs* xfs, const xfs_field* field, binary_writer* w) {
+    binary_writer_write_s32(w, field->is_array ? field->data.array.count : 1);
+
+    if (field->is_array) {
+        for (uint32_t j = 0; j < field->data.array.count; j++) {
+            if (!xfs_save_data(xfs, &field->data.array.entries[j], field->type, w)) {
+                return false;
             }
         }
+    } else {
+        if (!xfs_save_data(xfs, &field->data, field->type, w)) {
+            return false;
+        }
     }
 
-    return obj;
+    return true;
+}
+
+// Appends ".field" or ".field[index]" to the path, returns the previous length to restore later
+static size_t xfs_stream_enter(xfs_stream* stream, uint32_t parent, const char* field, int64_t index) {
+    const size_t path_length = stream->path_length;
+    char index_buffer[24] = "";
+
+    stream->parent = parent;
+    stream->array_index = index >= 0 ? (uint32_t)index : XFS_NO_ARRAY_INDEX;
+
+    if (index >= 0) {
+        snprintf(index_buffer, sizeof(index_buffer), "[%lld]", (long long)index);
+    }
+
+    const size_t needed = path_length + 1 + strlen(field) + strlen(index_buffer) + 1;
+    if (needed > stream->path_capacity) {
+        const size_t capacity = needed > stream->path_capacity * 2 ? needed : stream->path_capacity * 2;
+        char* path = realloc(stream->path, capacity);
+        if (path == NULL) {
+            stream->failed = true;
+            return path_length;
+        }
+
+        stream->path = path;
+        stream->path_capacity = capacity;
+    }
+
+    const int written = sprintf(stream->path + path_length, "%s%s%s", path_length != 0 ? "." : "", field, index_buffer);
+    stream->path_length += (size_t)written;
+
+    return path_length;
+}
+
+static void xfs_stream_leave(xfs_stream* stream, size_t path_length) {
+    if (stream->path != NULL) {
+        stream->path_length = path_length;
+        stream->path[path_length] = '\0';
+    }
+}
+
+static void xfs_stream_visit(xfs* xfs, xfs_object* obj, uint32_t parent, uint32_t array_index) {
+    xfs_stream* const stream = xfs->stream;
+
+    if (!stream->failed) {
+        const xfs_object_location location = {
+            .parent = parent,
+            .array_index = array_index,
+            .path = stream->path,
+        };
+
+        stream->failed = !stream->visitor->on_object(xfs, obj, &location, stream->visitor->user_data);
+    }
+
+    // Children were visited and freed the same way, so this only releases the object's own data
+    for (uint32_t i = 0; i < obj->def->prop_count; i++) {
+        xfs_free_field(xfs, &obj->fields[i]);
+    }
+
+    free(obj->fields);
+    obj->fields = NULL;
 }
 
 bool xfs_load_data(xfs* xfs, xfs_type_t type, xfs_data* data, binary_reader* r) {
@@ -388,39 +859,6 @@ bool xfs_load_data(xfs* xfs, xfs_type_t type, xfs_data* data, binary_reader* r)
     case XFS_TYPE_CLASSREF:
         data->obj = xfs_load_object(xfs, r);
         break;
-    case XFS_TYPE_BOOL:
-        data->value.b = binary_reader_read_bool(r);
-        break;
-    case XFS_TYPE_U8:
-        data->value.u8 = binary_reader_read_u8(r);
-        break;
-    case XFS_TYPE_U16:
-        data->value.u16 = binary_reader_read_u16(r);
-        break;
-    case XFS_TYPE_U32:
-        data->value.u32 = binary_reader_read_u32(r);
-        break;
-    case XFS_TYPE_U64:
-        data->value.u64 = binary_reader_read_u64(r);
-        break;
-    case XFS_TYPE_S8:
-        data->value.s8 = binary_reader_read_s8(r);
-        break;
-    case XFS_TYPE_S16:
-        data->value.s16 = binary_reader_read_s16(r);
-        break;
-    case XFS_TYPE_S32:
-        data->value.s32 = binary_reader_read_s32(r);
-        break;
-    case XFS_TYPE_S64:
-        data->value.s64 = binary_reader_read_s64(r);
-        break;
-    case XFS_TYPE_F32:
-        data->value.f32 = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_F64:
-        data->value.f64 = binary_reader_read_f64(r);
-        break;
     case XFS_TYPE_STRING:
     case XFS_TYPE_CSTRING:
         if (binary_reader_read_str(r, string_buffer_1, sizeof(string_buffer_1)) != BINARY_READER_OK) {
@@ -428,41 +866,12 @@ bool xfs_load_data(xfs* xfs, xfs_type_t type, xfs_data* data, binary_reader* r)
             return false;
         }
 
-        data->str = strdup(string_buffer_1);
+        data->str = xfs_strdup(xfs, string_buffer_1);
         if (data->str == NULL) {
             fprintf(stderr, "Failed to allocate memory for XFS string\n");
             return false;
         }
         break;
-    case XFS_TYPE_COLOR:
-        data->value.color = binary_reader_read_u32(r);
-        break;
-    case XFS_TYPE_POINT:
-        data->value.point.x = binary_reader_read_s32(r);
-        data->value.point.y = binary_reader_read_s32(r);
-        break;
-    case XFS_TYPE_SIZE:
-        data->value.size.w = binary_reader_read_s32(r);
-        data->value.size.h = binary_reader_read_s32(r);
-        break;
-    case XFS_TYPE_RECT:
-        data->value.rect.l = binary_reader_read_s32(r);
-        data->value.rect.t = binary_reader_read_s32(r);
-        data->value.rect.r = binary_reader_read_s32(r);
-        data->value.rect.b = binary_reader_read_s32(r);
-        break;
-    case XFS_TYPE_MATRIX:
-        binary_reader_read(r, &data->value.matrix, sizeof(xfs_matrix));
-        break;
-    case XFS_TYPE_VECTOR3:
-        binary_reader_read(r, &data->value.vector3, sizeof(xfs_vector3));
-        break;
-    case XFS_TYPE_VECTOR4:
-        binary_reader_read(r, &data->value.vector4, sizeof(xfs_vector4));
-        break;
-    case XFS_TYPE_QUATERNION:
-        binary_reader_read(r, &data->value.quaternion, sizeof(xfs_quaternion));
-        break;
     case XFS_TYPE_PROPERTY:
     case XFS_TYPE_EVENT:
     case XFS_TYPE_GROUP:
@@ -480,136 +889,9 @@ bool xfs_load_data(xfs* xfs, xfs_type_t type, xfs_data* data, binary_reader* r)
     case XFS_TYPE_END:
         fprintf(stderr, "Unsupported type: %d\n", type);
         break;
-    case XFS_TYPE_TIME:
-        data->value.time.time = binary_reader_read_s64(r);
-        break;
-    case XFS_TYPE_FLOAT2:
-        data->value.float2.x = binary_reader_read_f32(r);
-        data->value.float2.y = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_FLOAT3:
-        data->value.float3.x = binary_reader_read_f32(r);
-        data->value.float3.y = binary_reader_read_f32(r);
-        data->value.float3.z = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_FLOAT4:
-        data->value.float4.x = binary_reader_read_f32(r);
-        data->value.float4.y = binary_reader_read_f32(r);
-        data->value.float4.z = binary_reader_read_f32(r);
-        data->value.float4.w = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_FLOAT3x3:
-        binary_reader_read(r, &data->value.float3x3, sizeof(xfs_float3x3));
-        break;
-    case XFS_TYPE_FLOAT4x3:
-        binary_reader_read(r, &data->value.float4x3, sizeof(xfs_float4x3));
-        break;
-    case XFS_TYPE_FLOAT4x4:
-        binary_reader_read(r, &data->value.float4x4, sizeof(xfs_float4x4));
-        break;
-    case XFS_TYPE_EASECURVE:
-        data->value.easecurve.p1 = binary_reader_read_f32(r);
-        data->value.easecurve.p2 = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_LINE:
-        binary_reader_read(r, &data->value.line, sizeof(xfs_line));
-        break;
-    case XFS_TYPE_LINESEGMENT:
-        binary_reader_read(r, &data->value.linesegment, sizeof(xfs_linesegment));
-        break;
-    case XFS_TYPE_RAY:
-        binary_reader_read(r, &data->value.ray, sizeof(xfs_ray));
-        break;
-    case XFS_TYPE_PLANE:
-        binary_reader_read(r, &data->value.plane, sizeof(xfs_plane));
-        break;
-    case XFS_TYPE_SPHERE:
-        binary_reader_read(r, &data->value.sphere, sizeof(xfs_sphere));
-        break;
-    case XFS_TYPE_CAPSULE:
-        binary_reader_read(r, &data->value.capsule, sizeof(xfs_capsule));
-        break;
-    case XFS_TYPE_AABB:
-        binary_reader_read(r, &data->value.aabb, sizeof(xfs_aabb));
-        break;
-    case XFS_TYPE_OBB:
-        binary_reader_read(r, &data->value.obb, sizeof(xfs_obb));
-        break;
-    case XFS_TYPE_CYLINDER:
-        binary_reader_read(r, &data->value.cylinder, sizeof(xfs_cylinder));
-        break;
-    case XFS_TYPE_TRIANGLE:
-        binary_reader_read(r, &data->value.triangle, sizeof(xfs_triangle));
-        break;
-    case XFS_TYPE_CONE:
-        binary_reader_read(r, &data->value.cone, sizeof(xfs_cone));
-        break;
-    case XFS_TYPE_TORUS:
-        binary_reader_read(r, &data->value.torus, sizeof(xfs_torus));
-        break;
-    case XFS_TYPE_ELLIPSOID:
-        binary_reader_read(r, &data->value.ellipsoid, sizeof(xfs_ellipsoid));
-        break;
-    case XFS_TYPE_RANGE:
-        data->value.range.s = binary_reader_read_s32(r);
-        data->value.range.r = binary_reader_read_u32(r);
-        break;
-    case XFS_TYPE_RANGEF:
-        data->value.rangef.s = binary_reader_read_f32(r);
-        data->value.rangef.r = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_RANGEU16:
-        data->value.rangeu16.s = binary_reader_read_u16(r);
-        data->value.rangeu16.r = binary_reader_read_u16(r);
-        break;
-    case XFS_TYPE_HERMITECURVE:
-        binary_reader_read(r, &data->value.hermitecurve, sizeof(xfs_hermitecurve));
-        break;
-    case XFS_TYPE_FLOAT3x4:
-        binary_reader_read(r, &data->value.float3x4, sizeof(xfs_float3x4));
-        break;
-    case XFS_TYPE_LINESEGMENT4:
-        binary_reader_read(r, &data->value.linesegment4, sizeof(xfs_linesegment4));
-        break;
-    case XFS_TYPE_AABB4:
-        binary_reader_read(r, &data->value.aabb4, sizeof(xfs_aabb4));
-        break;
-    case XFS_TYPE_VECTOR2:
-        data->value.vector2.x = binary_reader_read_f32(r);
-        data->value.vector2.y = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_MATRIX33:
-        binary_reader_read(r, &data->value.matrix33, sizeof(xfs_matrix33));
-        break;
-    case XFS_TYPE_RECT3D_XZ:
-        binary_reader_read(r, &data->value.rect3d_xz, sizeof(xfs_rect3d_xz));
-        break;
-    case XFS_TYPE_RECT3D:
-        binary_reader_read(r, &data->value.rect3d, sizeof(xfs_rect3d));
-        break;
-    case XFS_TYPE_PLANE_XZ:
-        binary_reader_read(r, &data->value.plane_xz, sizeof(xfs_plane_xz));
-        break;
-    case XFS_TYPE_RAY_Y:
-        binary_reader_read(r, &data->value.ray_y, sizeof(xfs_ray_y));
-        break;
-    case XFS_TYPE_POINTF:
-        data->value.pointf.x = binary_reader_read_f32(r);
-        data->value.pointf.y = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_SIZEF:
-        data->value.sizef.w = binary_reader_read_f32(r);
-        data->value.sizef.h = binary_reader_read_f32(r);
-        break;
-    case XFS_TYPE_RECTF:
-        data->value.rectf.t = binary_reader_read_f32(r);
-        data->value.rectf.l = binary_reader_read_f32(r);
-        data->value.rectf.b = binary_reader_read_f32(r);
-        data->value.rectf.r = binary_reader_read_f32(r);
-        break;
     case XFS_TYPE_CUSTOM:
         data->custom.count = binary_reader_read_u8(r);
-        data->custom.values = (char**)malloc(data->custom.count * sizeof(char*));
+        data->custom.values = (char**)xfs_alloc(xfs, data->custom.count * sizeof(char*));
         if (data->custom.values == NULL) {
             fprintf(stderr, "Failed to allocate memory for XFS custom values\n");
             return false;
@@ -620,13 +902,16 @@ bool xfs_load_data(xfs* xfs, xfs_type_t type, xfs_data* data, binary_reader* r)
                 fprintf(stderr, "Failed to read XFS custom value\n");
                 return false;
             }
-            data->custom.values[i] = strdup(string_buffer_2);
+            data->custom.values[i] = xfs_strdup(xfs, string_buffer_2);
             if (data->custom.values[i] == NULL) {
                 fprintf(stderr, "Failed to allocate memory for XFS custom value\n");
                 return false;
             }
         }
         break;
+    default:
+        xfs_pod_read(type, data, r);
+        break;
     }
 
     return true;
@@ -651,20 +936,13 @@ bool xfs_save_object(const xfs* xfs, const xfs_object* obj, binary_writer* w) {
         binary_writer_write_u32(w, 0); // v15 size is 8 bytes
     }
 
-    for (uint32_t i = 0; i < obj->def->prop_count; i++) {
-        const xfs_property_def* prop = &obj->def->props[i];
-        const xfs_field* field = &obj->fields[i];
-
-        binary_writer_write_s32(w, field->is_array ? field->data.array.count : 1);
-
-        if (field->is_array) {
-            for (uint32_t j = 0; j < field->data.array.count; j++) {
-                if (!xfs_save_data(xfs, &field->data.array.entries[j], field->type, w)) {
-                    return false;
-                }
-            }
-        } else {
-            if (!xfs_save_data(xfs, &field->data, field->type, w)) {
+    if (obj->def->codec != NULL) {
+        if (!obj->def->codec->save(xfs, obj, w)) {
+            return false;
+        }
+    } else {
+        for (uint32_t i = 0; i < obj->def->prop_count; i++) {
+            if (!xfs_codec_save_values(xfs, &obj->fields[i], w)) {
                 return false;
             }
         }
@@ -701,39 +979,6 @@ bool xfs_save_data(const xfs* xfs, const xfs_data* data, xfs_type_t type, binary
             }
         }
         break;
-    case XFS_TYPE_BOOL:
-        binary_writer_write_bool(w, data->value.b);
-        break;
-    case XFS_TYPE_U8:
-        binary_writer_write_u8(w, data->value.u8);
-        break;
-    case XFS_TYPE_U16:
-        binary_writer_write_u16(w, data->value.u16);
-        break;
-    case XFS_TYPE_U32:
-        binary_writer_write_u32(w, data->value.u32);
-        break;
-    case XFS_TYPE_U64:
-        binary_writer_write_u64(w, data->value.u64);
-        break;
-    case XFS_TYPE_S8:
-        binary_writer_write_s8(w, data->value.s8);
-        break;
-    case XFS_TYPE_S16:
-        binary_writer_write_s16(w, data->value.s16);
-        break;
-    case XFS_TYPE_S32:
-        binary_writer_write_s32(w, data->value.s32);
-        break;
-    case XFS_TYPE_S64:
-        binary_writer_write_s64(w, data->value.s64);
-        break;
-    case XFS_TYPE_F32:
-        binary_writer_write_f32(w, data->value.f32);
-        break;
-    case XFS_TYPE_F64:
-        binary_writer_write_f64(w, data->value.f64);
-        break;
     case XFS_TYPE_STRING:
     case XFS_TYPE_CSTRING:
         if (data->str != NULL) {
@@ -742,32 +987,6 @@ bool xfs_save_data(const xfs* xfs, const xfs_data* data, xfs_type_t type, binary
             binary_writer_write_str(w, "");
         }
         break;
-    case XFS_TYPE_COLOR:
-        binary_writer_write_u32(w, data->value.color);
-        break;
-    case XFS_TYPE_POINT:
-        binary_writer_write_s32(w, data->value.point.x);
-        binary_writer_write_s32(w, data->value.point.y);
-        break;
-    case XFS_TYPE_SIZE:
-        binary_writer_write_s32(w, data->value.size.w);
-        binary_writer_write_s32(w, data->value.size.h);
-        break;
-    case XFS_TYPE_RECT:
-        binary_writer_write(w, &data->value.rect, sizeof(xfs_rect));
-        break;
-    case XFS_TYPE_MATRIX:
-        binary_writer_write(w, &data->value.matrix, sizeof(xfs_matrix));
-        break;
-    case XFS_TYPE_VECTOR3:
-        binary_writer_write(w, &data->value.vector3, sizeof(xfs_vector3));
-        break;
-    case XFS_TYPE_VECTOR4:
-        binary_writer_write(w, &data->value.vector4, sizeof(xfs_vector4));
-        break;
-    case XFS_TYPE_QUATERNION:
-        binary_writer_write(w, &data->value.quaternion, sizeof(xfs_quaternion));
-        break;
     case XFS_TYPE_PROPERTY:
     case XFS_TYPE_EVENT:
     case XFS_TYPE_GROUP:
@@ -785,121 +1004,6 @@ bool xfs_save_data(const xfs* xfs, const xfs_data* data, xfs_type_t type, binary
     case XFS_TYPE_END:
         fprintf(stderr, "Unsupported type: %d\n", type);
         break;
-    case XFS_TYPE_TIME:
-        binary_writer_write_s64(w, data->value.time.time);
-        break;
-    case XFS_TYPE_FLOAT2:
-        binary_writer_write_f32(w, data->value.float2.x);
-        break;
-    case XFS_TYPE_FLOAT3:
-        binary_writer_write(w, &data->value.float3, sizeof(xfs_float3));
-        break;
-    case XFS_TYPE_FLOAT4:
-        binary_writer_write(w, &data->value.float4, sizeof(xfs_float4));
-        break;
-    case XFS_TYPE_FLOAT3x3:
-        binary_writer_write(w, &data->value.float3x3, sizeof(xfs_float3x3));
-        break;
-    case XFS_TYPE_FLOAT4x3:
-        binary_writer_write(w, &data->value.float4x3, sizeof(xfs_float4x3));
-        break;
-    case XFS_TYPE_FLOAT4x4:
-        binary_writer_write(w, &data->value.float4x4, sizeof(xfs_float4x4));
-        break;
-    case XFS_TYPE_EASECURVE:
-        binary_writer_write_f32(w, data->value.easecurve.p1);
-        binary_writer_write_f32(w, data->value.easecurve.p2);
-        break;
-    case XFS_TYPE_LINE:
-        binary_writer_write(w, &data->value.line, sizeof(xfs_line));
-        break;
-    case XFS_TYPE_LINESEGMENT:
-        binary_writer_write(w, &data->value.linesegment, sizeof(xfs_linesegment));
-        break;
-    case XFS_TYPE_RAY:
-        binary_writer_write(w, &data->value.ray, sizeof(xfs_ray));
-        break;
-    case XFS_TYPE_PLANE:
-        binary_writer_write(w, &data->value.plane, sizeof(xfs_plane));
-        break;
-    case XFS_TYPE_SPHERE:
-        binary_writer_write(w, &data->value.sphere, sizeof(xfs_sphere));
-        break;
-    case XFS_TYPE_CAPSULE:
-        binary_writer_write(w, &data->value.capsule, sizeof(xfs_capsule));
-        break;
-    case XFS_TYPE_AABB:
-        binary_writer_write(w, &data->value.aabb, sizeof(xfs_aabb));
-        break;
-    case XFS_TYPE_OBB:
-        binary_writer_write(w, &data->value.obb, sizeof(xfs_obb));
-        break;
-    case XFS_TYPE_CYLINDER:
-        binary_writer_write(w, &data->value.cylinder, sizeof(xfs_cylinder));
-        break;
-    case XFS_TYPE_TRIANGLE:
-        binary_writer_write(w, &data->value.triangle, sizeof(xfs_triangle));
-        break;
-    case XFS_TYPE_CONE:
-        binary_writer_write(w, &data->value.cone, sizeof(xfs_cone));
-        break;
-    case XFS_TYPE_TORUS:
-        binary_writer_write(w, &data->value.torus, sizeof(xfs_torus));
-        break;
-    case XFS_TYPE_ELLIPSOID:
-        binary_writer_write(w, &data->value.ellipsoid, sizeof(xfs_ellipsoid));
-        break;
-    case XFS_TYPE_RANGE:
-        binary_writer_write_s32(w, data->value.range.s);
-        break;
-    case XFS_TYPE_RANGEF:
-        binary_writer_write_f32(w, data->value.rangef.s);
-        break;
-    case XFS_TYPE_RANGEU16:
-        binary_writer_write_u16(w, data->value.rangeu16.s);
-        break;
-    case XFS_TYPE_HERMITECURVE:
-        binary_writer_write(w, &data->value.hermitecurve, sizeof(xfs_hermitecurve));
-        break;
-    case XFS_TYPE_FLOAT3x4:
-        binary_writer_write(w, &data->value.float3x4, sizeof(xfs_float3x4));
-        break;
-    case XFS_TYPE_LINESEGMENT4:
-        binary_writer_write(w, &data->value.linesegment4, sizeof(xfs_linesegment4));
-        break;
-    case XFS_TYPE_AABB4:
-        binary_writer_write(w, &data->value.aabb4, sizeof(xfs_aabb4));
-        break;
-    case XFS_TYPE_VECTOR2:
-        binary_writer_write_f32(w, data->value.vector2.x);
-        binary_writer_write_f32(w, data->value.vector2.y);
-        break;
-    case XFS_TYPE_MATRIX33:
-        binary_writer_write(w, &data->value.matrix33, sizeof(xfs_matrix33));
-        break;
-    case XFS_TYPE_RECT3D_XZ:
-        binary_writer_write(w, &data->value.rect3d_xz, sizeof(xfs_rect3d_xz));
-        break;
-    case XFS_TYPE_RECT3D:
-        binary_writer_write(w, &data->value.rect3d, sizeof(xfs_rect3d));
-        break;
-    case XFS_TYPE_PLANE_XZ:
-        binary_writer_write(w, &data->value.plane_xz, sizeof(xfs_plane_xz));
-        break;
-    case XFS_TYPE_RAY_Y:
-        binary_writer_write(w, &data->value.ray_y, sizeof(xfs_ray_y));
-        break;
-    case XFS_TYPE_POINTF:
-        binary_writer_write_f32(w, data->value.pointf.x);
-        binary_writer_write_f32(w, data->value.pointf.y);
-        break;
-    case XFS_TYPE_SIZEF:
-        binary_writer_write_f32(w, data->value.sizef.w);
-        binary_writer_write_f32(w, data->value.sizef.h);
-        break;
-    case XFS_TYPE_RECTF:
-        binary_writer_write(w, &data->value.rectf, sizeof(xfs_rectf));
-        break;
     case XFS_TYPE_CUSTOM:
         binary_writer_write_u8(w, data->custom.count);
         for (uint8_t i = 0; i < data->custom.count; i++) {
@@ -910,6 +1014,9 @@ bool xfs_save_data(const xfs* xfs, const xfs_data* data, xfs_type_t type, binary
             }
         }
         break;
+    default:
+        xfs_pod_write(data, type, w);
+        break;
     }
 
     return true;
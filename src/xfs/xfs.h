@@ -2,6 +2,7 @@
 #define XFS_H
 
 #include "prop_types.h"
+#include "util/arena.h"
 
 #include <stdint.h>
 #include <stdbool.h>
@@ -107,12 +108,15 @@ typedef struct xfs_property_def {
     bool disable;
 } xfs_property_def;
 
+struct xfs_def_codec;
+
 typedef struct xfs_def {
     uint32_t dti_hash;
     uint32_t prop_count : 31;
     uint32_t init : 1;
     uint8_t raw_header[16]; // Preserve raw header bytes for byte-identical round-trip
     xfs_property_def* props; //< Free this
+    const struct xfs_def_codec* codec; //< Code generated for this definition, NULL to use the generic one
 } xfs_def;
 
 typedef struct xfs_class_ref {
@@ -126,7 +130,8 @@ typedef struct xfs_object {
     xfs_def* def;
     size_t def_id;
     int16_t id;
-    struct xfs_field* fields; //< Free this
+    uint32_t index; //< Position in load order, only assigned by xfs_load_stream
+    struct xfs_field* fields; //< Free this. NULL once the object was handed to a stream visitor
 } xfs_object;
 
 typedef union xfs_value {
@@ -216,13 +221,40 @@ typedef enum {
     XFS_STRUCTURE_V16_HYBRID = 3  // v16 structure with v15 header
 } xfs_structure_type;
 
+struct xfs_stream;
+struct xfs_def_cache;
+
 typedef struct xfs {
     xfs_header header;
     xfs_def* defs; //< Free this
     xfs_object* root; //< Free this
     xfs_structure_type actual_structure; //< Detected structure type for hybrid support
+    char* string_buffer; //< Strings and names of the tree may point into this instead of being allocated
+    size_t string_buffer_size;
+    bool owns_string_buffer; //< Free string_buffer in xfs_free
+    struct xfs_stream* stream; //< Only set while xfs_load_stream runs
+    arena* arena; //< Objects, fields and strings of a loaded tree come out of this if set, xfs_free leaves them to it
+    bool shares_defs; //< defs belong to a def cache, xfs_free leaves them to it
 } xfs;
 
+#define XFS_NO_PARENT UINT32_MAX
+#define XFS_NO_ARRAY_INDEX UINT32_MAX
+
+typedef struct xfs_object_location {
+    uint32_t parent; //< Index of the object holding this one, XFS_NO_PARENT for the root
+    uint32_t array_index; //< Position in the parent's array field, XFS_NO_ARRAY_INDEX for a single object
+    const char* path; //< Field path from the root, e.g. "root.items[2].child"
+} xfs_object_location;
+
+typedef struct xfs_load_visitor {
+    // Called once the definitions are loaded, before any object
+    bool (*on_defs)(const xfs* xfs, void* user_data);
+    // Called for every object as soon as it is completely loaded, so children come before their
+    // parent. Objects below obj were visited already and are only left as shells (fields == NULL).
+    bool (*on_object)(const xfs* xfs, const xfs_object* obj, const xfs_object_location* location, void* user_data);
+    void* user_data;
+} xfs_load_visitor;
+
 enum {
     XFS_RESULT_OK = 0,
     XFS_RESULT_ERROR = -1,
@@ -231,11 +263,78 @@ enum {
 
 int xfs_load(const char* path, xfs* xfs);
 int xfs_save(const char* path, const xfs* xfs);
+
+// Like xfs_load, but from a file that was read into memory already. Nothing in the xfs points
+// into data afterwards. name is only used in messages.
+int xfs_load_buffer(const uint8_t* data, size_t size, const char* name, xfs* xfs);
+
+// Like xfs_load_buffer, but the objects, fields and strings of the tree are allocated from arena,
+// which has to outlive the xfs. xfs_free only releases the definitions then, resetting the arena
+// releases the tree in one go. With a def_cache (see def_cache.h) definition blocks seen before
+// aren't parsed again, the xfs shares the cached definitions instead. Both can be NULL.
+int xfs_load_buffer_arena(const uint8_t* data, size_t size, const char* name, arena* arena, struct xfs_def_cache* def_cache, xfs* xfs);
+
+// Like xfs_load, but hands every object to the visitor as it is decoded and frees its fields
+// right after, so memory doesn't grow with the file. Only the shell of the root is left in the
+// xfs afterwards. Fails if a visitor callback returns false.
+int xfs_load_stream(const char* path, xfs* xfs, const xfs_load_visitor* visitor);
+// xfs_load_stream for a file in memory, see xfs_load_buffer
+int xfs_load_stream_buffer(const uint8_t* data, size_t size, const char* name, xfs* xfs, const xfs_load_visitor* visitor);
 void xfs_free(xfs* xfs);
 
-cJSON* xfs_to_json(const xfs* xfs);
-xfs* xfs_from_json(const cJSON* json);
+typedef struct xfs_json_options {
+    // Arrays of plain values (numbers, vectors, matrices, shapes...) with at least this many
+    // elements are written as {"$type": type, "$count": count, "$base64": data}, with data holding
+    // the bytes of each value's struct. 0 writes every array element by element.
+    uint32_t pack_min_count;
+    // Objects equal to one written before, including everything below them, are written as
+    // {"$ref": index}, and the first of them gets an additional "$index": index. Doesn't apply to
+    // xfs_stream_object_to_json.
+    bool dedup;
+    // Threads xfs_from_json builds large arrays of objects with, 0 or 1 imports everything on the
+    // calling thread. Documents using "$ref" are always imported on the calling thread.
+    int thread_count;
+} xfs_json_options;
+
+// options can be NULL for the defaults
+cJSON* xfs_to_json(const xfs* xfs, const xfs_json_options* options);
+
+// Pieces of xfs_to_json for streamed output: the definitions along with the version, and a
+// single object tagged with its index, parent and path. Children left as shells by
+// xfs_load_stream are written as {"$ref": index}.
+cJSON* xfs_defs_to_json(const xfs* xfs);
+cJSON* xfs_stream_object_to_json(const xfs_object* obj, const xfs_object_location* location, const xfs_json_options* options);
+xfs* xfs_from_json(const cJSON* json, const xfs_json_options* options);
+
+// Like xfs_from_json, but strings and property names that point into buffer (as produced by
+// json_reader_parse) are borrowed instead of copied. The xfs takes ownership of buffer, also
+// on failure, and frees it in xfs_free. json must not be used after its strings are freed.
+xfs* xfs_from_json_buffer(const cJSON* json, char* buffer, size_t size, const xfs_json_options* options);
+
+// Whether str points into the xfs's string buffer, i.e. isn't allocated separately
+bool xfs_is_borrowed_string(const xfs* xfs, const char* str);
 
 bool is_xfs_file(const char* path);
+// Whether data starts with an XFS header
+bool is_xfs_buffer(const void* data, size_t size);
+
+// Upper bound of xfs_pod_size for any type
+#define XFS_POD_MAX_SIZE 256
+
+// Bytes a packed value of type takes, the size of its value struct (e.g. xfs_float2). 0 for types
+// holding strings or objects.
+size_t xfs_pod_size(xfs_type_t type);
+
+// Encodes a single value like xfs_pack_values into buffer, which has to hold XFS_POD_MAX_SIZE
+// bytes. Returns the bytes written, 0 for types that aren't plain values.
+size_t xfs_pack_value(xfs_type_t type, const xfs_data* value, uint8_t* buffer);
+
+// Encodes count values as the bytes of their value structs, every component in declaration
+// order, count * xfs_pod_size(type) bytes in total. Returns NULL for types that aren't plain
+// values. Free the result with free.
+uint8_t* xfs_pack_values(xfs_type_t type, const xfs_data* values, uint32_t count, size_t* size);
+
+// Decodes values packed by xfs_pack_values, size has to match count exactly
+bool xfs_unpack_values(xfs_type_t type, const uint8_t* data, size_t size, xfs_data* values, uint32_t count);
 
 #endif // XFS_H
@@ -1,16 +1,72 @@
 #include "xfs.h"
+#include "xfs/codec.h"
 #include "xfs/common.h"
+#include "xfs/dedup.h"
 #include "xfs/v16/arch_32.h"
 #include "xfs/v15/arch_64.h"
+#include "util/number_format.h"
+#include "util/number_parse.h"
+#include "util/msgpack_writer.h"
+#include "util/base64.h"
+#include "util/thread.h"
+
+#include <inttypes.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 
-static cJSON* xfs_object_to_json(const xfs_object* obj);
-static cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data);
-
+// State of a single xfs_to_json or xfs_stream_object_to_json call
+typedef struct xfs_json_export {
+    const xfs_json_options* options;
+    xfs_dedup* dedup; //< NULL unless options->dedup is set
+} xfs_json_export;
+
+// State of a single xfs_from_json call
+typedef struct xfs_json_import {
+    // Objects written with "$index", so {"$ref": index} can be expanded
+    const cJSON** refs; //< Free this. NULL where no object was read for an index yet
+    uint32_t ref_capacity;
+    bool failed; //< An invalid reference was found, which would otherwise only leave a null behind
+    int thread_count; //< Threads for large arrays of objects, 1 once inside one of them
+} xfs_json_import;
+
+// Arrays of objects with at least this many elements are imported on multiple threads
+#define XFS_JSON_PARALLEL_MIN_COUNT 1024
+// Elements per chunk at least, smaller chunks cost more in handing out than they save
+#define XFS_JSON_CHUNK_MIN_COUNT 256
+
+// Consecutive elements of an array of objects, imported on one thread
+typedef struct xfs_json_chunk {
+    const cJSON* first;
+    uint32_t start;
+    uint32_t count;
+    int64_t class_count; //< Objects created for the chunk, their ids count from 0
+    bool result;
+} xfs_json_chunk;
+
+typedef struct xfs_json_worker {
+    const xfs* xfs;
+    xfs_field* field;
+    xfs_json_chunk* chunks;
+    size_t chunk_count;
+    size_t first_chunk;
+    size_t chunk_stride;
+} xfs_json_worker;
+
+static cJSON* xfs_defs_array_to_json(const xfs* xfs);
+static cJSON* xfs_object_to_json(const xfs_object* obj, xfs_json_export* state);
+static void xfs_object_fields_to_json(cJSON* json, const xfs_object* obj, xfs_json_export* state);
+static cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data, xfs_json_export* state);
+static cJSON* xfs_json_create_packed(xfs_type_t type, const xfs_data* values, uint32_t count);
+
+static cJSON* xfs_json_create_f32(float value);
+static cJSON* xfs_json_create_f64(double value);
+static cJSON* xfs_json_create_u64(uint64_t value);
+static cJSON* xfs_json_create_s64(int64_t value);
+// Keys passed to this must outlive the tree, they aren't copied
+#define xfs_json_add_f32(json, key, value) cJSON_AddItemToObjectCS(json, key, xfs_json_create_f32(value))
 static cJSON* xfs_json_create_float2(const float* values);
 static cJSON* xfs_json_create_float3(const float* values);
 static cJSON* xfs_json_create_float4(const float* values);
@@ -18,22 +74,91 @@ static cJSON* xfs_json_create_matrix(const float* values, int m, int n);
 static cJSON* xfs_json_create_soa_vector3(const xfs_soa_vector3* value);
 
 static double xfs_json_get_number(const cJSON* json, const char* key);
-static double xfs_json_get_array_number(const cJSON* json, int index);
+static uint64_t xfs_json_get_u64(const cJSON* json, const char* key);
+static int64_t xfs_json_get_s64(const cJSON* json, const char* key);
+static float xfs_json_get_f32(const cJSON* json, const char* key);
+static float xfs_json_get_array_f32(const cJSON* json, int index);
 static void xfs_json_get_float2(const cJSON* json, const char* key, float* values);
 static void xfs_json_get_float3(const cJSON* json, const char* key, float* values);
 static void xfs_json_get_float4(const cJSON* json, const char* key, float* values);
 static void xfs_json_get_matrix(const cJSON* json, const char* key, float* values, int m, int n);
 static void xfs_json_get_soa_vector3(const cJSON* json, const char* key, xfs_soa_vector3* value);
 #define xfs_json_get_t(type, json, key) (type)xfs_json_get_number(json, key)
-#define xfs_json_get_array_t(type, json, index) (type)xfs_json_get_array_number(json, index)
 
-static xfs_object* xfs_object_from_json(const cJSON* json, xfs* xfs);
-static bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs* xfs);
+static xfs* xfs_from_json_impl(const cJSON* json, char* buffer, size_t size, int thread_count);
+static char* xfs_json_take_string(const xfs* xfs, const char* str);
+static xfs_object* xfs_object_from_json(const cJSON* json, xfs* xfs, xfs_json_import* import);
+static bool xfs_json_add_ref(xfs_json_import* import, const cJSON* json, const xfs* xfs);
+static bool xfs_json_has_refs(const cJSON* json);
+static bool xfs_json_get_array(const cJSON* json, xfs_field* field, xfs* xfs, xfs_json_import* import);
+static bool xfs_json_get_objects_parallel(const cJSON* json, xfs_field* field, xfs* xfs, xfs_json_import* import);
+static bool xfs_json_get_packed(const cJSON* json, xfs_type_t type, xfs_field* field);
+static bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs* xfs, xfs_json_import* import);
+
+static const xfs_json_options s_default_options = { 0 };
+
+static const char* const s_matrix_keys[4][4] = {
+    { "m00", "m01", "m02", "m03" },
+    { "m10", "m11", "m12", "m13" },
+    { "m20", "m21", "m22", "m23" },
+    { "m30", "m31", "m32", "m33" },
+};
+
+cJSON* xfs_to_json(const xfs* xfs, const xfs_json_options* options) {
+    xfs_json_export state = {
+        .options = options != NULL ? options : &s_default_options,
+        .dedup = NULL,
+    };
+
+    // Without the table everything is written out, which is still valid output
+    if (state.options->dedup) {
+        state.dedup = xfs_dedup_create(xfs->root);
+    }
+
+    cJSON* json = cJSON_CreateObject();
+
+    cJSON_AddItemToObject(json, "root", xfs_object_to_json(xfs->root, &state));
+    cJSON_AddItemToObject(json, "$defs", xfs_defs_array_to_json(xfs));
+    cJSON_AddNumberToObject(json, "$major_version", xfs->header.major_version);
+    cJSON_AddNumberToObject(json, "$minor_version", xfs->header.minor_version);
+
+    xfs_dedup_destroy(state.dedup);
+
+    return json;
+}
+
+cJSON* xfs_defs_to_json(const xfs* xfs) {
+    cJSON* json = cJSON_CreateObject();
+
+    cJSON_AddItemToObject(json, "$defs", xfs_defs_array_to_json(xfs));
+    cJSON_AddNumberToObject(json, "$major_version", xfs->header.major_version);
+    cJSON_AddNumberToObject(json, "$minor_version", xfs->header.minor_version);
+
+    return json;
+}
 
-cJSON* xfs_to_json(const xfs* xfs) {
+cJSON* xfs_stream_object_to_json(const xfs_object* obj, const xfs_object_location* location, const xfs_json_options* options) {
     cJSON* json = cJSON_CreateObject();
 
-    // Add definitions
+    cJSON_AddNumberToObject(json, "$index", obj->index);
+    if (location->parent == XFS_NO_PARENT) {
+        cJSON_AddNullToObject(json, "$parent");
+    } else {
+        cJSON_AddNumberToObject(json, "$parent", location->parent);
+    }
+    cJSON_AddStringToObject(json, "$path", location->path);
+
+    xfs_json_export state = {
+        .options = options != NULL ? options : &s_default_options,
+        .dedup = NULL,
+    };
+
+    xfs_object_fields_to_json(json, obj, &state);
+
+    return json;
+}
+
+cJSON* xfs_defs_array_to_json(const xfs* xfs) {
     cJSON* defs = cJSON_CreateArray();
     for (int i = 0; i < xfs->header.def_count; i++) {
         const xfs_def* def = &xfs->defs[i];
@@ -53,7 +178,7 @@ cJSON* xfs_to_json(const xfs* xfs) {
             const xfs_property_def* prop = &def->props[j];
             cJSON* prop_json = cJSON_CreateObject();
 
-            cJSON_AddStringToObject(prop_json, "name", prop->name);
+            cJSON_AddItemToObjectCS(prop_json, "name", cJSON_CreateStringReference(prop->name));
             cJSON_AddNumberToObject(prop_json, "type", prop->type);
             cJSON_AddNumberToObject(prop_json, "attr", prop->attr);
             cJSON_AddNumberToObject(prop_json, "bytes", prop->bytes);
@@ -66,20 +191,35 @@ cJSON* xfs_to_json(const xfs* xfs) {
         cJSON_AddItemToArray(defs, def_json);
     }
 
-    cJSON_AddItemToObject(json, "root", xfs_object_to_json(xfs->root));
-    cJSON_AddItemToObject(json, "$defs", defs);
-    cJSON_AddNumberToObject(json, "$major_version", xfs->header.major_version);
-    cJSON_AddNumberToObject(json, "$minor_version", xfs->header.minor_version);
+    return defs;
+}
 
-    return json;
+xfs* xfs_from_json(const cJSON* json, const xfs_json_options* options) {
+    return xfs_from_json_impl(json, NULL, 0, options != NULL ? options->thread_count : 1);
+}
+
+xfs* xfs_from_json_buffer(const cJSON* json, char* buffer, size_t size, const xfs_json_options* options) {
+    xfs* xfs = xfs_from_json_impl(json, buffer, size, options != NULL ? options->thread_count : 1);
+    if (xfs == NULL) {
+        free(buffer);
+        return NULL;
+    }
+
+    xfs->owns_string_buffer = true;
+
+    return xfs;
 }
 
-xfs* xfs_from_json(const cJSON* json) {
+xfs* xfs_from_json_impl(const cJSON* json, char* buffer, size_t size, int thread_count) {
     xfs* xfs = calloc(1, sizeof(struct xfs));
     if (xfs == NULL) {
         return NULL;
     }
 
+    // Only borrowed from for now, ownership is taken once the tree is complete
+    xfs->string_buffer = buffer;
+    xfs->string_buffer_size = size;
+
     const cJSON* defs = cJSON_GetObjectItem(json, "$defs");
     const cJSON* root = cJSON_GetObjectItem(json, "root");
 
@@ -157,7 +297,7 @@ xfs* xfs_from_json(const cJSON* json) {
             xfs_property_def* prop = &def->props[j];
 
             const char* name = cJSON_GetStringValue(cJSON_GetObjectItem(prop_json, "name"));
-            prop->name = strdup(name);
+            prop->name = xfs_json_take_string(xfs, name);
             if (prop->name == NULL) {
                 xfs_free(xfs);
                 free(xfs);
@@ -184,39 +324,120 @@ xfs* xfs_from_json(const cJSON* json) {
         return NULL;
     }
 
-    xfs->root = xfs_object_from_json(root, xfs);
+    xfs_def_codec_attach(xfs);
+
+    // Expanding references depends on the order objects are read in, which only a single thread keeps
+    xfs_json_import import = {
+        .thread_count = thread_count > 1 && !xfs_json_has_refs(root) ? thread_count : 1,
+    };
+
+    xfs->root = xfs_object_from_json(root, xfs, &import);
+    free(import.refs);
+
+    if (import.failed) {
+        xfs_free(xfs);
+        free(xfs);
+        return NULL;
+    }
 
     return xfs;
 }
 
-cJSON* xfs_object_to_json(const xfs_object* obj) {
+cJSON* xfs_object_to_json(const xfs_object* obj, xfs_json_export* state) {
     if (obj == NULL) {
         return cJSON_CreateNull();
     }
 
     cJSON* json = cJSON_CreateObject();
 
+    // Objects already written by a streaming visitor are only referenced
+    if (obj->fields == NULL) {
+        cJSON_AddNumberToObject(json, "$ref", obj->index);
+        return json;
+    }
+
+    if (state->dedup != NULL) {
+        uint32_t index = 0;
+        switch (xfs_dedup_visit(state->dedup, obj, &index)) {
+        case XFS_DEDUP_REFERENCE:
+            cJSON_AddNumberToObject(json, "$ref", index);
+            return json;
+        case XFS_DEDUP_WRITE_INDEXED:
+            cJSON_AddNumberToObject(json, "$index", index);
+            break;
+        case XFS_DEDUP_WRITE:
+            break;
+        }
+    }
+
+    xfs_object_fields_to_json(json, obj, state);
+
+    return json;
+}
+
+void xfs_object_fields_to_json(cJSON* json, const xfs_object* obj, xfs_json_export* state) {
+    const xfs_json_options* options = state->options;
+
     cJSON_AddNumberToObject(json, "$id", obj->def_id);
 
     for (int i = 0; i < obj->def->prop_count; i++) {
         const xfs_field* field = &obj->fields[i];
         
         if (field->is_array) {
+            const uint32_t count = field->data.array.count;
+            if (options->pack_min_count != 0 && count >= options->pack_min_count && xfs_pod_size(field->type) != 0) {
+                cJSON* packed = xfs_json_create_packed(field->type, field->data.array.entries, count);
+                if (packed != NULL) {
+                    cJSON_AddItemToObjectCS(json, field->name, packed);
+                    continue;
+                }
+            }
+
             cJSON* items = cJSON_CreateArray();
             for (int j = 0; j < field->data.array.count; j++) {
-                cJSON_AddItemToArray(items, xfs_data_to_json(field->type, &field->data.array.entries[j]));
+                cJSON_AddItemToArray(items, xfs_data_to_json(field->type, &field->data.array.entries[j], state));
             }
             
-            cJSON_AddItemToObject(json, field->name, items);
+            cJSON_AddItemToObjectCS(json, field->name, items);
         } else {
-            cJSON_AddItemToObject(json, field->name, xfs_data_to_json(field->type, &field->data));
+            cJSON_AddItemToObjectCS(json, field->name, xfs_data_to_json(field->type, &field->data, state));
         }
     }
+}
+
+cJSON* xfs_json_create_packed(xfs_type_t type, const xfs_data* values, uint32_t count) {
+    size_t size = 0;
+    uint8_t* data = xfs_pack_values(type, values, count, &size);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    // Allocated through cJSON so the string item can own it, whichever allocator is installed
+    char* text = cJSON_malloc(BASE64_ENCODED_SIZE(size) + 1);
+    if (text == NULL) {
+        free(data);
+        return NULL;
+    }
+
+    base64_encode(text, data, size);
+    free(data);
+
+    cJSON* blob = cJSON_CreateStringReference(text);
+    if (blob == NULL) {
+        cJSON_free(text);
+        return NULL;
+    }
+    blob->type &= ~cJSON_IsReference;
+
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "$type", type);
+    cJSON_AddNumberToObject(json, "$count", count);
+    cJSON_AddItemToObjectCS(json, "$base64", blob);
 
     return json;
 }
 
-cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
+cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data, xfs_json_export* state) {
     char string_buffer[128];
     cJSON* json = NULL;
     cJSON* array = NULL;
@@ -242,7 +463,7 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
 
     case XFS_TYPE_CLASS:
     case XFS_TYPE_CLASSREF:
-        return xfs_object_to_json(data->obj);
+        return xfs_object_to_json(data->obj, state);
     case XFS_TYPE_BOOL:
         return cJSON_CreateBool(data->value.b);
     case XFS_TYPE_U8:
@@ -252,7 +473,7 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
     case XFS_TYPE_U32:
         return cJSON_CreateNumber(data->value.u32);
     case XFS_TYPE_U64:
-        return cJSON_CreateNumber(data->value.u64);
+        return xfs_json_create_u64(data->value.u64);
     case XFS_TYPE_S8:
         return cJSON_CreateNumber(data->value.s8);
     case XFS_TYPE_S16:
@@ -260,14 +481,14 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
     case XFS_TYPE_S32:
         return cJSON_CreateNumber(data->value.s32);
     case XFS_TYPE_S64:
-        return cJSON_CreateNumber(data->value.s64);
+        return xfs_json_create_s64(data->value.s64);
     case XFS_TYPE_F32:
-        return cJSON_CreateNumber(data->value.f32);
+        return xfs_json_create_f32(data->value.f32);
     case XFS_TYPE_F64:
-        return cJSON_CreateNumber(data->value.f64);
+        return xfs_json_create_f64(data->value.f64);
     case XFS_TYPE_STRING:
     case XFS_TYPE_CSTRING:
-        return cJSON_CreateString(data->str);
+        return cJSON_CreateStringReference(data->str);
     case XFS_TYPE_COLOR:
         snprintf(string_buffer, sizeof(string_buffer), "#%08X", data->value.color);
         return cJSON_CreateString(string_buffer);
@@ -289,14 +510,7 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
         cJSON_AddNumberToObject(json, "b", data->value.rect.b);
         return json;
     case XFS_TYPE_MATRIX:
-        json = cJSON_CreateObject();
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                snprintf(string_buffer, sizeof(string_buffer), "m%d%d", i, j);
-                cJSON_AddNumberToObject(json, string_buffer, data->value.matrix.m[i][j]);
-            }
-        }
-        return json;
+        return xfs_json_create_matrix(&data->value.matrix.m[0][0], 4, 4);
     case XFS_TYPE_VECTOR3:
         return xfs_json_create_float3(&data->value.vector3.x);
     case XFS_TYPE_VECTOR4:
@@ -304,7 +518,7 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
     case XFS_TYPE_QUATERNION:
         return xfs_json_create_float4(&data->value.quaternion.x);
     case XFS_TYPE_TIME:
-        return cJSON_CreateNumber(data->value.time.time);
+        return xfs_json_create_s64(data->value.time.time);
     case XFS_TYPE_FLOAT2:
         return xfs_json_create_float2(&data->value.float2.x);
     case XFS_TYPE_FLOAT3:
@@ -319,8 +533,8 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
         return xfs_json_create_matrix(&data->value.float4x4.m[0][0], 4, 4);
     case XFS_TYPE_EASECURVE:
         json = cJSON_CreateObject();
-        cJSON_AddNumberToObject(json, "p1", data->value.easecurve.p1);
-        cJSON_AddNumberToObject(json, "p2", data->value.easecurve.p2);
+        xfs_json_add_f32(json, "p1", data->value.easecurve.p1);
+        xfs_json_add_f32(json, "p2", data->value.easecurve.p2);
         return json;
     case XFS_TYPE_LINE:
         json = cJSON_CreateObject();
@@ -340,18 +554,18 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
     case XFS_TYPE_PLANE:
         json = cJSON_CreateObject();
         cJSON_AddItemToObject(json, "normal", xfs_json_create_float3(&data->value.plane.normal.x));
-        cJSON_AddNumberToObject(json, "dist", data->value.plane.dist);
+        xfs_json_add_f32(json, "dist", data->value.plane.dist);
         return json;
     case XFS_TYPE_SPHERE:
         json = cJSON_CreateObject();
         cJSON_AddItemToObject(json, "center", xfs_json_create_float3(&data->value.sphere.center.x));
-        cJSON_AddNumberToObject(json, "radius", data->value.sphere.radius);
+        xfs_json_add_f32(json, "radius", data->value.sphere.radius);
         return json;
     case XFS_TYPE_CAPSULE:
         json = cJSON_CreateObject();
         cJSON_AddItemToObject(json, "p0", xfs_json_create_float3(&data->value.capsule.p0.x));
         cJSON_AddItemToObject(json, "p1", xfs_json_create_float3(&data->value.capsule.p1.x));
-        cJSON_AddNumberToObject(json, "radius", data->value.capsule.radius);
+        xfs_json_add_f32(json, "radius", data->value.capsule.radius);
         return json;
     case XFS_TYPE_AABB:
         json = cJSON_CreateObject();
@@ -367,7 +581,7 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
         json = cJSON_CreateObject();
         cJSON_AddItemToObject(json, "p0", xfs_json_create_float3(&data->value.cylinder.p0.x));
         cJSON_AddItemToObject(json, "p1", xfs_json_create_float3(&data->value.cylinder.p1.x));
-        cJSON_AddNumberToObject(json, "radius", data->value.cylinder.radius);
+        xfs_json_add_f32(json, "radius", data->value.cylinder.radius);
         return json;
     case XFS_TYPE_TRIANGLE:
         json = cJSON_CreateObject();
@@ -379,15 +593,15 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
         json = cJSON_CreateObject();
         cJSON_AddItemToObject(json, "p0", xfs_json_create_float3(&data->value.cone.p0.x));
         cJSON_AddItemToObject(json, "p1", xfs_json_create_float3(&data->value.cone.p1.x));
-        cJSON_AddNumberToObject(json, "r0", data->value.cone.r0);
-        cJSON_AddNumberToObject(json, "r1", data->value.cone.r1);
+        xfs_json_add_f32(json, "r0", data->value.cone.r0);
+        xfs_json_add_f32(json, "r1", data->value.cone.r1);
         return json;
     case XFS_TYPE_TORUS:
         json = cJSON_CreateObject();
         cJSON_AddItemToObject(json, "pos", xfs_json_create_float3(&data->value.torus.pos.x));
         cJSON_AddItemToObject(json, "axis", xfs_json_create_float3(&data->value.torus.axis.x));
-        cJSON_AddNumberToObject(json, "r", data->value.torus.r);
-        cJSON_AddNumberToObject(json, "cr", data->value.torus.cr);
+        xfs_json_add_f32(json, "r", data->value.torus.r);
+        xfs_json_add_f32(json, "cr", data->value.torus.cr);
         return json;
     case XFS_TYPE_ELLIPSOID:
         json = cJSON_CreateObject();
@@ -401,8 +615,8 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
         return json;
     case XFS_TYPE_RANGEF:
         json = cJSON_CreateObject();
-        cJSON_AddNumberToObject(json, "s", data->value.rangef.s);
-        cJSON_AddNumberToObject(json, "r", data->value.rangef.r);
+        xfs_json_add_f32(json, "s", data->value.rangef.s);
+        xfs_json_add_f32(json, "r", data->value.rangef.r);
         return json;
     case XFS_TYPE_RANGEU16:
         json = cJSON_CreateObject();
@@ -413,14 +627,16 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
         json = cJSON_CreateObject();
 
         array = cJSON_CreateArray();
+        array->valueint = MSGPACK_HINT_F32_ARRAY;
         for (int i = 0; i < 8; i++) {
-            cJSON_AddItemToArray(array, cJSON_CreateNumber(data->value.hermitecurve.x[i]));
+            cJSON_AddItemToArray(array, xfs_json_create_f32(data->value.hermitecurve.x[i]));
         }
         cJSON_AddItemToObject(json, "x", array);
 
         array = cJSON_CreateArray();
+        array->valueint = MSGPACK_HINT_F32_ARRAY;
         for (int i = 0; i < 8; i++) {
-            cJSON_AddItemToArray(array, cJSON_CreateNumber(data->value.hermitecurve.y[i]));
+            cJSON_AddItemToArray(array, xfs_json_create_f32(data->value.hermitecurve.y[i]));
         }
         cJSON_AddItemToObject(json, "y", array);
         return json;
@@ -446,46 +662,46 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
         cJSON_AddItemToObject(json, "lb", xfs_json_create_float2(&data->value.rect3d_xz.lb.x));
         cJSON_AddItemToObject(json, "rt", xfs_json_create_float2(&data->value.rect3d_xz.rt.x));
         cJSON_AddItemToObject(json, "rb", xfs_json_create_float2(&data->value.rect3d_xz.rb.x));
-        cJSON_AddNumberToObject(json, "height", data->value.rect3d_xz.height);
+        xfs_json_add_f32(json, "height", data->value.rect3d_xz.height);
         return json;
     case XFS_TYPE_RECT3D:
         json = cJSON_CreateObject();
         cJSON_AddItemToObject(json, "normal", xfs_json_create_float3(&data->value.rect3d.normal.x));
         cJSON_AddItemToObject(json, "center", xfs_json_create_float3(&data->value.rect3d.center.x));
-        cJSON_AddNumberToObject(json, "size_w", data->value.rect3d.size_w);
-        cJSON_AddNumberToObject(json, "size_h", data->value.rect3d.size_h);
+        xfs_json_add_f32(json, "size_w", data->value.rect3d.size_w);
+        xfs_json_add_f32(json, "size_h", data->value.rect3d.size_h);
         return json;
     case XFS_TYPE_PLANE_XZ:
         json = cJSON_CreateObject();
-        cJSON_AddNumberToObject(json, "dist", data->value.plane_xz.dist);
+        xfs_json_add_f32(json, "dist", data->value.plane_xz.dist);
         return json;
     case XFS_TYPE_RAY_Y:
         json = cJSON_CreateObject();
         cJSON_AddItemToObject(json, "from", xfs_json_create_float3(&data->value.ray_y.from.x));
-        cJSON_AddNumberToObject(json, "dir", data->value.ray_y.dir);
+        xfs_json_add_f32(json, "dir", data->value.ray_y.dir);
         return json;
     case XFS_TYPE_POINTF:
         json = cJSON_CreateObject();
-        cJSON_AddNumberToObject(json, "x", data->value.pointf.x);
-        cJSON_AddNumberToObject(json, "y", data->value.pointf.y);
+        xfs_json_add_f32(json, "x", data->value.pointf.x);
+        xfs_json_add_f32(json, "y", data->value.pointf.y);
         return json;
     case XFS_TYPE_SIZEF:
         json = cJSON_CreateObject();
-        cJSON_AddNumberToObject(json, "w", data->value.sizef.w);
-        cJSON_AddNumberToObject(json, "h", data->value.sizef.h);
+        xfs_json_add_f32(json, "w", data->value.sizef.w);
+        xfs_json_add_f32(json, "h", data->value.sizef.h);
         return json;
     case XFS_TYPE_RECTF:
         json = cJSON_CreateObject();
-        cJSON_AddNumberToObject(json, "l", data->value.rectf.l);
-        cJSON_AddNumberToObject(json, "t", data->value.rectf.t);
-        cJSON_AddNumberToObject(json, "r", data->value.rectf.r);
-        cJSON_AddNumberToObject(json, "b", data->value.rectf.b);
+        xfs_json_add_f32(json, "l", data->value.rectf.l);
+        xfs_json_add_f32(json, "t", data->value.rectf.t);
+        xfs_json_add_f32(json, "r", data->value.rectf.r);
+        xfs_json_add_f32(json, "b", data->value.rectf.b);
         return json;
     case XFS_TYPE_CUSTOM:
         json = cJSON_CreateObject();
         array = cJSON_CreateArray();
         for (uint8_t i = 0; i < data->custom.count; i++) {
-            cJSON_AddItemToArray(array, cJSON_CreateString(data->custom.values[i]));
+            cJSON_AddItemToArray(array, cJSON_CreateStringReference(data->custom.values[i]));
         }
         cJSON_AddItemToObject(json, "values", array);
         return json;
@@ -494,27 +710,64 @@ cJSON* xfs_data_to_json(xfs_type_t type, const xfs_data* data) {
     return NULL;
 }
 
+cJSON* xfs_json_create_f32(float value) {
+    // Emitted as raw text so cJSON doesn't print the widened double with 17 digits.
+    // Non-finite values become null in JSON, but binary formats can still store them as they are.
+    char buffer[NUMBER_FORMAT_F32_MAX];
+    cJSON* json = cJSON_CreateRaw(number_format_f32(buffer, value) != 0 ? buffer : "null");
+    if (json != NULL) {
+        json->valueint = MSGPACK_HINT_F32;
+        json->valuedouble = value;
+    }
+
+    return json;
+}
+
+cJSON* xfs_json_create_f64(double value) {
+    char buffer[NUMBER_FORMAT_F64_MAX];
+    cJSON* json = cJSON_CreateRaw(number_format_f64(buffer, value) != 0 ? buffer : "null");
+    if (json != NULL) {
+        json->valueint = MSGPACK_HINT_F64;
+        json->valuedouble = value;
+    }
+
+    return json;
+}
+
+cJSON* xfs_json_create_u64(uint64_t value) {
+    // Values above 2^53 don't survive a round trip through double
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%" PRIu64, value);
+    return cJSON_CreateRaw(buffer);
+}
+
+cJSON* xfs_json_create_s64(int64_t value) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%" PRId64, value);
+    return cJSON_CreateRaw(buffer);
+}
+
 cJSON* xfs_json_create_float2(const float* values) {
     cJSON* json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "x", values[0]);
-    cJSON_AddNumberToObject(json, "y", values[1]);
+    xfs_json_add_f32(json, "x", values[0]);
+    xfs_json_add_f32(json, "y", values[1]);
     return json;
 }
 
 cJSON* xfs_json_create_float3(const float* values) {
     cJSON* json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "x", values[0]);
-    cJSON_AddNumberToObject(json, "y", values[1]);
-    cJSON_AddNumberToObject(json, "z", values[2]);
+    xfs_json_add_f32(json, "x", values[0]);
+    xfs_json_add_f32(json, "y", values[1]);
+    xfs_json_add_f32(json, "z", values[2]);
     return json;
 }
 
 cJSON* xfs_json_create_float4(const float* values) {
     cJSON* json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "x", values[0]);
-    cJSON_AddNumberToObject(json, "y", values[1]);
-    cJSON_AddNumberToObject(json, "z", values[2]);
-    cJSON_AddNumberToObject(json, "w", values[3]);
+    xfs_json_add_f32(json, "x", values[0]);
+    xfs_json_add_f32(json, "y", values[1]);
+    xfs_json_add_f32(json, "z", values[2]);
+    xfs_json_add_f32(json, "w", values[3]);
     return json;
 }
 
@@ -522,12 +775,13 @@ cJSON* xfs_json_create_matrix(const float* values, int m, int n) {
     cJSON* json = cJSON_CreateObject();
     for (int i = 0; i < m; i++) {
         for (int j = 0; j < n; j++) {
-            char string_buffer[16];
-            snprintf(string_buffer, sizeof(string_buffer), "m%d%d", i, j);
-            cJSON_AddNumberToObject(json, string_buffer, values[i * n + j]);
+            xfs_json_add_f32(json, s_matrix_keys[i][j], values[i * n + j]);
         }
     }
 
+    // Stored as a flat row-major array by binary formats
+    json->valueint = MSGPACK_HINT_F32_ARRAY;
+
     return json;
 }
 
@@ -550,13 +804,68 @@ double xfs_json_get_number(const cJSON* json, const char* key) {
     return cJSON_GetNumberValue(json);
 }
 
-double xfs_json_get_array_number(const cJSON* json, int index) {
+// Source text of a number parsed by json_reader (or a wide integer read by msgpack_reader),
+// NULL for numbers created any other way
+static const char* xfs_json_get_literal(const cJSON* item) {
+    if (item == NULL || !cJSON_IsNumber(item)) {
+        return NULL;
+    }
+
+    return item->valuestring;
+}
+
+uint64_t xfs_json_get_u64(const cJSON* json, const char* key) {
+    if (key != NULL) {
+        json = cJSON_GetObjectItem(json, key);
+        if (json == NULL) {
+            return 0;
+        }
+    }
+
+    uint64_t value;
+    const char* literal = xfs_json_get_literal(json);
+    if (literal == NULL || number_parse_u64(literal, &value) == NULL) {
+        return (uint64_t)xfs_json_get_number(json, NULL);
+    }
+
+    return value;
+}
+
+int64_t xfs_json_get_s64(const cJSON* json, const char* key) {
+    if (key != NULL) {
+        json = cJSON_GetObjectItem(json, key);
+        if (json == NULL) {
+            return 0;
+        }
+    }
+
+    int64_t value;
+    const char* literal = xfs_json_get_literal(json);
+    if (literal == NULL || number_parse_s64(literal, &value) == NULL) {
+        return (int64_t)xfs_json_get_number(json, NULL);
+    }
+
+    return value;
+}
+
+float xfs_json_get_f32(const cJSON* json, const char* key) {
+    if (key != NULL) {
+        json = cJSON_GetObjectItem(json, key);
+        if (json == NULL) {
+            return 0.0f;
+        }
+    }
+
+    return number_narrow_f32(cJSON_GetNumberValue(json), xfs_json_get_literal(json));
+}
+
+float xfs_json_get_array_f32(const cJSON* json, int index) {
     const cJSON* item = cJSON_GetArrayItem(json, index);
     if (item == NULL || !cJSON_IsNumber(item)) {
-        return 0.0;
+        return 0.0f;
     }
 
-    return cJSON_GetNumberValue(item);
+    return number_narrow_f32(cJSON_GetNumberValue(item), xfs_json_get_literal(item));
 }
 
 void xfs_json_get_float2(const cJSON* json, const char* key, float* values) {
@@ -567,8 +876,8 @@ void xfs_json_get_float2(const cJSON* json, const char* key, float* values) {
         }
     }
 
-    values[0] = xfs_json_get_t(float, json, "x");
-    values[1] = xfs_json_get_t(float, json, "y");
+    values[0] = xfs_json_get_f32(json, "x");
+    values[1] = xfs_json_get_f32(json, "y");
 }
 
 void xfs_json_get_float3(const cJSON* json, const char* key, float* values) {
@@ -579,9 +888,9 @@ void xfs_json_get_float3(const cJSON* json, const char* key, float* values) {
         }
     }
 
-    values[0] = xfs_json_get_t(float, json, "x");
-    values[1] = xfs_json_get_t(float, json, "y");
-    values[2] = xfs_json_get_t(float, json, "z");
+    values[0] = xfs_json_get_f32(json, "x");
+    values[1] = xfs_json_get_f32(json, "y");
+    values[2] = xfs_json_get_f32(json, "z");
 }
 
 void xfs_json_get_float4(const cJSON* json, const char* key, float* values) {
@@ -592,25 +901,32 @@ void xfs_json_get_float4(const cJSON* json, const char* key, float* values) {
         }
     }
 
-    values[0] = xfs_json_get_t(float, json, "x");
-    values[1] = xfs_json_get_t(float, json, "y");
-    values[2] = xfs_json_get_t(float, json, "z");
-    values[3] = xfs_json_get_t(float, json, "w");
+    values[0] = xfs_json_get_f32(json, "x");
+    values[1] = xfs_json_get_f32(json, "y");
+    values[2] = xfs_json_get_f32(json, "z");
+    values[3] = xfs_json_get_f32(json, "w");
 }
 
 void xfs_json_get_matrix(const cJSON* json, const char* key, float* values, int m, int n) {
     if (key != NULL) {
         json = cJSON_GetObjectItem(json, key);
-        if (json == NULL || !cJSON_IsObject(json)) {
+        if (json == NULL || !(cJSON_IsObject(json) || cJSON_IsArray(json))) {
             return;
         }
     }
 
+    // Typed arrays from binary formats are flat and row-major
+    if (cJSON_IsArray(json)) {
+        const cJSON* item = json->child;
+        for (int i = 0; i < m * n && item != NULL; i++, item = item->next) {
+            values[i] = number_narrow_f32(cJSON_GetNumberValue(item), xfs_json_get_literal(item));
+        }
+        return;
+    }
+
     for (int i = 0; i < m; i++) {
         for (int j = 0; j < n; j++) {
-            char string_buffer[16];
-            snprintf(string_buffer, sizeof(string_buffer), "m%d%d", i, j);
-            values[i * n + j] = xfs_json_get_t(float, json, string_buffer);
+            values[i * n + j] = xfs_json_get_f32(json, s_matrix_keys[i][j]);
         }
     }
 }
@@ -628,11 +944,37 @@ void xfs_json_get_soa_vector3(const cJSON* json, const char* key, xfs_soa_vector
     xfs_json_get_float4(json, "z", &value->z.x);
 }
 
-xfs_object* xfs_object_from_json(const cJSON* json, xfs* xfs) {
+char* xfs_json_take_string(const xfs* xfs, const char* str) {
+    if (str == NULL) {
+        return NULL;
+    }
+
+    // Strings parsed in place by json_reader can be used as they are
+    if (xfs_is_borrowed_string(xfs, str)) {
+        return (char*)str;
+    }
+
+    return strdup(str);
+}
+
+xfs_object* xfs_object_from_json(const cJSON* json, xfs* xfs, xfs_json_import* import) {
     if (cJSON_IsNull(json) || !cJSON_IsObject(json)) {
         return NULL;
     }
 
+    // Deduplicated subtrees are read again from the object that was written in full
+    const cJSON* ref_item = cJSON_GetObjectItem(json, "$ref");
+    if (ref_item != NULL) {
+        const double ref = cJSON_GetNumberValue(ref_item);
+        if (!(ref >= 0 && ref < import->ref_capacity) || import->refs[(uint32_t)ref] == NULL) {
+            fprintf(stderr, "Invalid $ref: %g\n", ref);
+            import->failed = true;
+            return NULL;
+        }
+
+        return xfs_object_from_json(import->refs[(uint32_t)ref], xfs, import);
+    }
+
     const cJSON* id_item = cJSON_GetObjectItem(json, "$id");
     if (id_item == NULL || !cJSON_IsNumber(id_item)) {
         return NULL;
@@ -666,26 +1008,31 @@ xfs_object* xfs_object_from_json(const cJSON* json, xfs* xfs) {
             continue;
         }
 
-        if (cJSON_IsArray(item)) {
+        // Typed arrays hold a single matrix, not an array of values
+        if (cJSON_IsArray(item) && item->valueint != MSGPACK_HINT_F32_ARRAY) {
             field->is_array = true;
             field->data.array.count = cJSON_GetArraySize(item);
             field->data.array.entries = calloc(field->data.array.count, sizeof(xfs_data));
-            for (uint32_t j = 0; j < field->data.array.count; j++) {
-                const cJSON* array_item = cJSON_GetArrayItem(item, j);
-                if (array_item == NULL) {
-                    continue;
-                }
 
-                xfs_data* data = &field->data.array.entries[j];
-                if (!xfs_data_from_json(array_item, field->type, data, xfs)) {
-                    free(obj->fields);
-                    free(obj);
-                    return NULL;
-                }
+            const bool is_large_object_array = (field->type == XFS_TYPE_CLASS || field->type == XFS_TYPE_CLASSREF)
+                && field->data.array.count >= XFS_JSON_PARALLEL_MIN_COUNT;
+            const bool result = import->thread_count > 1 && is_large_object_array
+                ? xfs_json_get_objects_parallel(item, field, xfs, import)
+                : xfs_json_get_array(item, field, xfs, import);
+            if (!result) {
+                free(obj->fields);
+                free(obj);
+                return NULL;
+            }
+        } else if (cJSON_IsObject(item) && cJSON_HasObjectItem(item, "$base64")) {
+            if (!xfs_json_get_packed(item, field->type, field)) {
+                free(obj->fields);
+                free(obj);
+                return NULL;
             }
         } else {
             field->is_array = false;
-            if (!xfs_data_from_json(item, field->type, &field->data, xfs)) {
+            if (!xfs_data_from_json(item, field->type, &field->data, xfs, import)) {
                 free(obj->fields);
                 free(obj);
                 return NULL;
@@ -693,10 +1040,249 @@ xfs_object* xfs_object_from_json(const cJSON* json, xfs* xfs) {
         }
     }
 
+    if (!xfs_json_add_ref(import, json, xfs)) {
+        free(obj->fields);
+        free(obj);
+        return NULL;
+    }
+
     return obj;
 }
 
-bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs* xfs) {
+// Makes an object written with "$index" available to {"$ref": index}. Only done once the whole
+// subtree is read, so a reference can't point at one of its parents and recurse forever.
+bool xfs_json_add_ref(xfs_json_import* import, const cJSON* json, const xfs* xfs) {
+    const cJSON* index_item = cJSON_GetObjectItem(json, "$index");
+    if (index_item == NULL) {
+        return true;
+    }
+
+    // Indices count the objects written in full, so they can't exceed the objects read so far
+    const double index = cJSON_GetNumberValue(index_item);
+    if (!(index >= 0 && index < xfs->header.class_count)) {
+        fprintf(stderr, "Invalid $index: %g\n", index);
+        import->failed = true;
+        return false;
+    }
+
+    if ((uint32_t)index >= import->ref_capacity) {
+        uint32_t capacity = import->ref_capacity != 0 ? import->ref_capacity : 64;
+        while (capacity <= (uint32_t)index) {
+            capacity *= 2;
+        }
+
+        const cJSON** refs = realloc(import->refs, capacity * sizeof(const cJSON*));
+        if (refs == NULL) {
+            fprintf(stderr, "Failed to allocate memory for JSON references\n");
+            import->failed = true;
+            return false;
+        }
+
+        memset(refs + import->ref_capacity, 0, (capacity - import->ref_capacity) * sizeof(const cJSON*));
+        import->refs = refs;
+        import->ref_capacity = capacity;
+    }
+
+    // Expanding a reference reads the same objects again, the first one stays
+    if (import->refs[(uint32_t)index] == NULL) {
+        import->refs[(uint32_t)index] = json;
+    }
+
+    return true;
+}
+
+bool xfs_json_has_refs(const cJSON* json) {
+    const cJSON* item = NULL;
+    cJSON_ArrayForEach(item, json) {
+        if (item->string != NULL && (strcmp(item->string, "$ref") == 0 || strcmp(item->string, "$index") == 0)) {
+            return true;
+        }
+
+        if ((cJSON_IsObject(item) || cJSON_IsArray(item)) && xfs_json_has_refs(item)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool xfs_json_get_array(const cJSON* json, xfs_field* field, xfs* xfs, xfs_json_import* import) {
+    // Walks the list instead of cJSON_GetArrayItem, which starts from the front every time
+    uint32_t index = 0;
+    const cJSON* item = NULL;
+    cJSON_ArrayForEach(item, json) {
+        if (!xfs_data_from_json(item, field->type, &field->data.array.entries[index++], xfs, import)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void xfs_json_import_chunks(void* arg) {
+    const xfs_json_worker* worker = (const xfs_json_worker*)arg;
+
+    for (size_t i = worker->first_chunk; i < worker->chunk_count; i += worker->chunk_stride) {
+        xfs_json_chunk* chunk = &worker->chunks[i];
+
+        // Only the object count differs from the shared xfs, ids are moved into place afterwards
+        struct xfs local = *worker->xfs;
+        local.header.class_count = 0;
+
+        xfs_json_import import = {
+            .thread_count = 1,
+        };
+
+        chunk->result = true;
+
+        const cJSON* item = chunk->first;
+        for (uint32_t j = 0; j < chunk->count && chunk->result; j++, item = item->next) {
+            chunk->result = xfs_data_from_json(item, worker->field->type, &worker->field->data.array.entries[chunk->start + j], &local, &import);
+        }
+
+        chunk->result = chunk->result && !import.failed;
+        chunk->class_count = local.header.class_count;
+        free(import.refs);
+    }
+}
+
+// Adds offset to the ids of obj and everything below it
+static void xfs_json_offset_ids(xfs_object* obj, int64_t offset) {
+    if (obj == NULL) {
+        return;
+    }
+
+    obj->id = (int16_t)(obj->id + offset);
+
+    for (uint32_t i = 0; i < obj->def->prop_count; i++) {
+        xfs_field* field = &obj->fields[i];
+        if (field->type != XFS_TYPE_CLASS && field->type != XFS_TYPE_CLASSREF) {
+            continue;
+        }
+
+        if (field->is_array) {
+            for (uint32_t j = 0; j < field->data.array.count; j++) {
+                xfs_json_offset_ids(field->data.array.entries[j].obj, offset);
+            }
+        } else {
+            xfs_json_offset_ids(field->data.obj, offset);
+        }
+    }
+}
+
+bool xfs_json_get_objects_parallel(const cJSON* json, xfs_field* field, xfs* xfs, xfs_json_import* import) {
+    const uint32_t count = field->data.array.count;
+
+    // A few chunks per thread even out elements of different sizes
+    size_t chunk_count = (size_t)import->thread_count * 4;
+    if (chunk_count > count / XFS_JSON_CHUNK_MIN_COUNT) {
+        chunk_count = count / XFS_JSON_CHUNK_MIN_COUNT;
+    }
+
+    const size_t thread_count = chunk_count < (size_t)import->thread_count ? chunk_count : (size_t)import->thread_count;
+    xfs_json_chunk* chunks = calloc(chunk_count, sizeof(xfs_json_chunk));
+    xfs_json_worker* workers = calloc(thread_count, sizeof(xfs_json_worker));
+    thread** threads = calloc(thread_count, sizeof(thread*));
+    if (chunks == NULL || workers == NULL || threads == NULL) {
+        free(chunks);
+        free(workers);
+        free(threads);
+        return xfs_json_get_array(json, field, xfs, import);
+    }
+
+    const cJSON* item = json->child;
+    for (size_t i = 0; i < chunk_count; i++) {
+        xfs_json_chunk* chunk = &chunks[i];
+        chunk->start = (uint32_t)((uint64_t)count * i / chunk_count);
+        chunk->count = (uint32_t)((uint64_t)count * (i + 1) / chunk_count) - chunk->start;
+        chunk->first = item;
+
+        for (uint32_t j = 0; j < chunk->count; j++) {
+            item = item->next;
+        }
+    }
+
+    for (size_t i = 0; i < thread_count; i++) {
+        workers[i].xfs = xfs;
+        workers[i].field = field;
+        workers[i].chunks = chunks;
+        workers[i].chunk_count = chunk_count;
+        workers[i].first_chunk = i;
+        workers[i].chunk_stride = thread_count;
+    }
+
+    // The calling thread takes the first share itself, if a thread can't be started it does that share too
+    for (size_t i = 1; i < thread_count; i++) {
+        threads[i] = thread_create(xfs_json_import_chunks, &workers[i]);
+    }
+
+    xfs_json_import_chunks(&workers[0]);
+
+    for (size_t i = 1; i < thread_count; i++) {
+        if (threads[i] != NULL) {
+            thread_join(threads[i]);
+        } else {
+            xfs_json_import_chunks(&workers[i]);
+        }
+    }
+
+    // Numbered in chunk order, the ids come out the same as when importing on a single thread
+    bool result = true;
+    for (size_t i = 0; i < chunk_count; i++) {
+        const xfs_json_chunk* chunk = &chunks[i];
+        result = result && chunk->result;
+
+        for (uint32_t j = 0; j < chunk->count && result; j++) {
+            xfs_json_offset_ids(field->data.array.entries[chunk->start + j].obj, xfs->header.class_count);
+        }
+
+        xfs->header.class_count += chunk->class_count;
+    }
+
+    free(chunks);
+    free(workers);
+    free(threads);
+
+    return result;
+}
+
+// Arrays written by xfs_json_create_packed, decoded straight into the entries
+bool xfs_json_get_packed(const cJSON* json, xfs_type_t type, xfs_field* field) {
+    const char* text = cJSON_GetStringValue(cJSON_GetObjectItem(json, "$base64"));
+    const double count = xfs_json_get_number(json, "$count");
+    if (text == NULL || xfs_json_get_t(xfs_type_t, json, "$type") != type || !(count >= 0 && count <= UINT32_MAX)) {
+        fprintf(stderr, "Invalid packed array for %s\n", field->name);
+        return false;
+    }
+
+    const size_t length = strlen(text);
+    uint8_t* data = malloc(BASE64_DECODED_MAX(length));
+    size_t size = 0;
+    if (data == NULL || !base64_decode(data, &size, text, length)) {
+        fprintf(stderr, "Invalid base64 data in %s\n", field->name);
+        free(data);
+        return false;
+    }
+
+    field->is_array = true;
+    field->data.array.count = (uint32_t)count;
+    field->data.array.entries = calloc(field->data.array.count != 0 ? field->data.array.count : 1, sizeof(xfs_data));
+
+    const bool result = field->data.array.entries != NULL
+        && xfs_unpack_values(type, data, size, field->data.array.entries, field->data.array.count);
+    free(data);
+
+    if (!result) {
+        fprintf(stderr, "Packed array %s doesn't match its type and count\n", field->name);
+        free(field->data.array.entries);
+        field->data.array.entries = NULL;
+        field->data.array.count = 0;
+    }
+
+    return result;
+}
+
+bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs* xfs, xfs_json_import* import) {
     if (cJSON_IsNull(json)) {
         memset(data, 0, sizeof(xfs_data));
         return true;
@@ -724,7 +1310,7 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
         return false;
     case XFS_TYPE_CLASS:
     case XFS_TYPE_CLASSREF:
-        data->obj = xfs_object_from_json(json, xfs);
+        data->obj = xfs_object_from_json(json, xfs, import);
         break;
     case XFS_TYPE_BOOL:
         data->value.b = cJSON_IsTrue(json);
@@ -739,7 +1325,7 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
         data->value.u32 = xfs_json_get_t(uint32_t, json, NULL);
         break;
     case XFS_TYPE_U64:
-        data->value.u64 = xfs_json_get_t(uint64_t, json, NULL);
+        data->value.u64 = xfs_json_get_u64(json, NULL);
         break;
     case XFS_TYPE_S8:
         data->value.s8 = xfs_json_get_t(int8_t, json, NULL);
@@ -751,17 +1337,17 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
         data->value.s32 = xfs_json_get_t(int32_t, json, NULL);
         break;
     case XFS_TYPE_S64:
-        data->value.s64 = xfs_json_get_t(int64_t, json, NULL);
+        data->value.s64 = xfs_json_get_s64(json, NULL);
         break;
     case XFS_TYPE_F32:
-        data->value.f32 = xfs_json_get_t(float, json, NULL);
+        data->value.f32 = xfs_json_get_f32(json, NULL);
         break;
     case XFS_TYPE_F64:
         data->value.f64 = xfs_json_get_t(double, json, NULL);
         break;
     case XFS_TYPE_STRING:
     case XFS_TYPE_CSTRING:
-        data->str = strdup(cJSON_GetStringValue(json));
+        data->str = xfs_json_take_string(xfs, cJSON_GetStringValue(json));
         break;
     case XFS_TYPE_COLOR:
         if (cJSON_IsString(json)) {
@@ -802,7 +1388,7 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
         xfs_json_get_float4(json, NULL, &data->value.quaternion.x);
         break;
     case XFS_TYPE_TIME:
-        data->value.time.time = xfs_json_get_t(int64_t, json, NULL);
+        data->value.time.time = xfs_json_get_s64(json, NULL);
         break;
     case XFS_TYPE_FLOAT2:
         xfs_json_get_float2(json, NULL, &data->value.float2.x);
@@ -823,8 +1409,8 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
         xfs_json_get_matrix(json, NULL, &data->value.float4x4.m[0][0], 4, 4);
         break;
     case XFS_TYPE_EASECURVE:
-        data->value.easecurve.p1 = xfs_json_get_t(float, json, "p1");
-        data->value.easecurve.p2 = xfs_json_get_t(float, json, "p2");
+        data->value.easecurve.p1 = xfs_json_get_f32(json, "p1");
+        data->value.easecurve.p2 = xfs_json_get_f32(json, "p2");
         break;
     case XFS_TYPE_LINE:
         xfs_json_get_float3(json, "from", &data->value.line.from.x);
@@ -840,16 +1426,16 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
         break;
     case XFS_TYPE_PLANE:
         xfs_json_get_float3(json, "normal", &data->value.plane.normal.x);
-        data->value.plane.dist = xfs_json_get_t(float, json, "dist");
+        data->value.plane.dist = xfs_json_get_f32(json, "dist");
         break;
     case XFS_TYPE_SPHERE:
         xfs_json_get_float3(json, "center", &data->value.sphere.center.x);
-        data->value.sphere.radius = xfs_json_get_t(float, json, "radius");
+        data->value.sphere.radius = xfs_json_get_f32(json, "radius");
         break;
     case XFS_TYPE_CAPSULE:
         xfs_json_get_float3(json, "p0", &data->value.capsule.p0.x);
         xfs_json_get_float3(json, "p1", &data->value.capsule.p1.x);
-        data->value.capsule.radius = xfs_json_get_t(float, json, "radius");
+        data->value.capsule.radius = xfs_json_get_f32(json, "radius");
         break;
     case XFS_TYPE_AABB:
         xfs_json_get_float3(json, "min", &data->value.aabb.min.x);
@@ -862,7 +1448,7 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
     case XFS_TYPE_CYLINDER:
         xfs_json_get_float3(json, "p0", &data->value.cylinder.p0.x);
         xfs_json_get_float3(json, "p1", &data->value.cylinder.p1.x);
-        data->value.cylinder.radius = xfs_json_get_t(float, json, "radius");
+        data->value.cylinder.radius = xfs_json_get_f32(json, "radius");
         break;
     case XFS_TYPE_TRIANGLE:
         xfs_json_get_float3(json, "p0", &data->value.triangle.p0.x);
@@ -872,14 +1458,14 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
     case XFS_TYPE_CONE:
         xfs_json_get_float3(json, "p0", &data->value.cone.p0.x);
         xfs_json_get_float3(json, "p1", &data->value.cone.p1.x);
-        data->value.cone.r0 = xfs_json_get_t(float, json, "r0");
-        data->value.cone.r1 = xfs_json_get_t(float, json, "r1");
+        data->value.cone.r0 = xfs_json_get_f32(json, "r0");
+        data->value.cone.r1 = xfs_json_get_f32(json, "r1");
         break;
     case XFS_TYPE_TORUS:
         xfs_json_get_float3(json, "pos", &data->value.torus.pos.x);
         xfs_json_get_float3(json, "axis", &data->value.torus.axis.x);
-        data->value.torus.r = xfs_json_get_t(float, json, "r");
-        data->value.torus.cr = xfs_json_get_t(float, json, "cr");
+        data->value.torus.r = xfs_json_get_f32(json, "r");
+        data->value.torus.cr = xfs_json_get_f32(json, "cr");
         break;
     case XFS_TYPE_ELLIPSOID:
         xfs_json_get_float3(json, "pos", &data->value.ellipsoid.pos.x);
@@ -890,8 +1476,8 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
         data->value.range.r = xfs_json_get_t(uint32_t, json, "r");
         break;
     case XFS_TYPE_RANGEF:
-        data->value.rangef.s = xfs_json_get_t(float, json, "s");
-        data->value.rangef.r = xfs_json_get_t(float, json, "r");
+        data->value.rangef.s = xfs_json_get_f32(json, "s");
+        data->value.rangef.r = xfs_json_get_f32(json, "r");
         break;
     case XFS_TYPE_RANGEU16:
         data->value.rangeu16.s = xfs_json_get_t(uint16_t, json, "s");
@@ -909,8 +1495,8 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
         }
 
         for (int i = 0; i < 8; i++) {
-            data->value.hermitecurve.x[i] = xfs_json_get_array_t(float, temp[0], i);
-            data->value.hermitecurve.y[i] = xfs_json_get_array_t(float, temp[1], i);
+            data->value.hermitecurve.x[i] = xfs_json_get_array_f32(temp[0], i);
+            data->value.hermitecurve.y[i] = xfs_json_get_array_f32(temp[1], i);
         }
         break;
     case XFS_TYPE_FLOAT3x4:
@@ -939,29 +1525,29 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
     case XFS_TYPE_RECT3D:
         xfs_json_get_float3(json, "normal", &data->value.rect3d.normal.x);
         xfs_json_get_float3(json, "center", &data->value.rect3d.center.x);
-        data->value.rect3d.size_w = xfs_json_get_t(float, json, "size_w");
-        data->value.rect3d.size_h = xfs_json_get_t(float, json, "size_h");
+        data->value.rect3d.size_w = xfs_json_get_f32(json, "size_w");
+        data->value.rect3d.size_h = xfs_json_get_f32(json, "size_h");
         break;
     case XFS_TYPE_PLANE_XZ:
-        data->value.plane_xz.dist = xfs_json_get_t(float, json, "dist");
+        data->value.plane_xz.dist = xfs_json_get_f32(json, "dist");
         break;
     case XFS_TYPE_RAY_Y:
         xfs_json_get_float3(json, "from", &data->value.ray_y.from.x);
-        data->value.ray_y.dir = xfs_json_get_t(float, json, "dir");
+        data->value.ray_y.dir = xfs_json_get_f32(json, "dir");
         break;
     case XFS_TYPE_POINTF:
-        data->value.pointf.x = xfs_json_get_t(float, json, "x");
-        data->value.pointf.y = xfs_json_get_t(float, json, "y");
+        data->value.pointf.x = xfs_json_get_f32(json, "x");
+        data->value.pointf.y = xfs_json_get_f32(json, "y");
         break;
     case XFS_TYPE_SIZEF:
-        data->value.sizef.w = xfs_json_get_t(float, json, "w");
-        data->value.sizef.h = xfs_json_get_t(float, json, "h");
+        data->value.sizef.w = xfs_json_get_f32(json, "w");
+        data->value.sizef.h = xfs_json_get_f32(json, "h");
         break;
     case XFS_TYPE_RECTF:
-        data->value.rectf.l = xfs_json_get_t(float, json, "l");
-        data->value.rectf.t = xfs_json_get_t(float, json, "t");
-        data->value.rectf.r = xfs_json_get_t(float, json, "r");
-        data->value.rectf.b = xfs_json_get_t(float, json, "b");
+        data->value.rectf.l = xfs_json_get_f32(json, "l");
+        data->value.rectf.t = xfs_json_get_f32(json, "t");
+        data->value.rectf.r = xfs_json_get_f32(json, "r");
+        data->value.rectf.b = xfs_json_get_f32(json, "b");
         break;
     case XFS_TYPE_CUSTOM:
         temp[0] = cJSON_GetObjectItem(json, "values");
@@ -974,7 +1560,7 @@ bool xfs_data_from_json(const cJSON* json, xfs_type_t type, xfs_data* data, xfs*
                     return false;
                 }
 
-                data->custom.values[i] = strdup(cJSON_GetStringValue(item));
+                data->custom.values[i] = xfs_json_take_string(xfs, cJSON_GetStringValue(item));
             }
         } else {
             return false;
@@ -0,0 +1,432 @@
+#ifndef XFS_POD_H
+#define XFS_POD_H
+
+#include "xfs.h"
+#include "util/binary_reader.h"
+#include "util/binary_writer.h"
+
+#include <stdbool.h>
+
+
+// Plain values, the types xfs_pod_size is non-zero for. They are read and written here, inline,
+// so that wherever the type is known at compile time (as in generated codecs, see codec.h) the
+// switch folds away into the reads or writes of that one type.
+
+// Types with a fixed size that hold no strings or objects
+static inline bool xfs_pod_is_type(xfs_type_t type) {
+    switch (type) {
+    case XFS_TYPE_CLASS:
+    case XFS_TYPE_CLASSREF:
+    case XFS_TYPE_STRING:
+    case XFS_TYPE_CSTRING:
+    case XFS_TYPE_CUSTOM:
+    case XFS_TYPE_UNDEFINED:
+    case XFS_TYPE_PROPERTY:
+    case XFS_TYPE_EVENT:
+    case XFS_TYPE_GROUP:
+    case XFS_TYPE_PAGE_BEGIN:
+    case XFS_TYPE_PAGE_END:
+    case XFS_TYPE_EVENT32:
+    case XFS_TYPE_ARRAY:
+    case XFS_TYPE_PROPERTYLIST:
+    case XFS_TYPE_GROUP_END:
+    case XFS_TYPE_ENUMLIST:
+    case XFS_TYPE_OSCILLATOR:
+    case XFS_TYPE_VARIABLE:
+    case XFS_TYPE_RECT3D_COLLISION:
+    case XFS_TYPE_EVENT64:
+    case XFS_TYPE_END:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// Reads a value of a type xfs_pod_is_type accepts, like xfs_load_data
+static inline void xfs_pod_read(xfs_type_t type, xfs_data* data, binary_reader* r) {
+    switch (type) {
+    case XFS_TYPE_BOOL:
+        data->value.b = binary_reader_read_bool(r);
+        break;
+    case XFS_TYPE_U8:
+        data->value.u8 = binary_reader_read_u8(r);
+        break;
+    case XFS_TYPE_U16:
+        data->value.u16 = binary_reader_read_u16(r);
+        break;
+    case XFS_TYPE_U32:
+        data->value.u32 = binary_reader_read_u32(r);
+        break;
+    case XFS_TYPE_U64:
+        data->value.u64 = binary_reader_read_u64(r);
+        break;
+    case XFS_TYPE_S8:
+        data->value.s8 = binary_reader_read_s8(r);
+        break;
+    case XFS_TYPE_S16:
+        data->value.s16 = binary_reader_read_s16(r);
+        break;
+    case XFS_TYPE_S32:
+        data->value.s32 = binary_reader_read_s32(r);
+        break;
+    case XFS_TYPE_S64:
+        data->value.s64 = binary_reader_read_s64(r);
+        break;
+    case XFS_TYPE_F32:
+        data->value.f32 = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_F64:
+        data->value.f64 = binary_reader_read_f64(r);
+        break;
+    case XFS_TYPE_COLOR:
+        data->value.color = binary_reader_read_u32(r);
+        break;
+    case XFS_TYPE_POINT:
+        data->value.point.x = binary_reader_read_s32(r);
+        data->value.point.y = binary_reader_read_s32(r);
+        break;
+    case XFS_TYPE_SIZE:
+        data->value.size.w = binary_reader_read_s32(r);
+        data->value.size.h = binary_reader_read_s32(r);
+        break;
+    case XFS_TYPE_RECT:
+        data->value.rect.l = binary_reader_read_s32(r);
+        data->value.rect.t = binary_reader_read_s32(r);
+        data->value.rect.r = binary_reader_read_s32(r);
+        data->value.rect.b = binary_reader_read_s32(r);
+        break;
+    case XFS_TYPE_MATRIX:
+        binary_reader_read(r, &data->value.matrix, sizeof(xfs_matrix));
+        break;
+    case XFS_TYPE_VECTOR3:
+        binary_reader_read(r, &data->value.vector3, sizeof(xfs_vector3));
+        break;
+    case XFS_TYPE_VECTOR4:
+        binary_reader_read(r, &data->value.vector4, sizeof(xfs_vector4));
+        break;
+    case XFS_TYPE_QUATERNION:
+        binary_reader_read(r, &data->value.quaternion, sizeof(xfs_quaternion));
+        break;
+    case XFS_TYPE_TIME:
+        data->value.time.time = binary_reader_read_s64(r);
+        break;
+    case XFS_TYPE_FLOAT2:
+        data->value.float2.x = binary_reader_read_f32(r);
+        data->value.float2.y = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_FLOAT3:
+        data->value.float3.x = binary_reader_read_f32(r);
+        data->value.float3.y = binary_reader_read_f32(r);
+        data->value.float3.z = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_FLOAT4:
+        data->value.float4.x = binary_reader_read_f32(r);
+        data->value.float4.y = binary_reader_read_f32(r);
+        data->value.float4.z = binary_reader_read_f32(r);
+        data->value.float4.w = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_FLOAT3x3:
+        binary_reader_read(r, &data->value.float3x3, sizeof(xfs_float3x3));
+        break;
+    case XFS_TYPE_FLOAT4x3:
+        binary_reader_read(r, &data->value.float4x3, sizeof(xfs_float4x3));
+        break;
+    case XFS_TYPE_FLOAT4x4:
+        binary_reader_read(r, &data->value.float4x4, sizeof(xfs_float4x4));
+        break;
+    case XFS_TYPE_EASECURVE:
+        data->value.easecurve.p1 = binary_reader_read_f32(r);
+        data->value.easecurve.p2 = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_LINE:
+        binary_reader_read(r, &data->value.line, sizeof(xfs_line));
+        break;
+    case XFS_TYPE_LINESEGMENT:
+        binary_reader_read(r, &data->value.linesegment, sizeof(xfs_linesegment));
+        break;
+    case XFS_TYPE_RAY:
+        binary_reader_read(r, &data->value.ray, sizeof(xfs_ray));
+        break;
+    case XFS_TYPE_PLANE:
+        binary_reader_read(r, &data->value.plane, sizeof(xfs_plane));
+        break;
+    case XFS_TYPE_SPHERE:
+        binary_reader_read(r, &data->value.sphere, sizeof(xfs_sphere));
+        break;
+    case XFS_TYPE_CAPSULE:
+        binary_reader_read(r, &data->value.capsule, sizeof(xfs_capsule));
+        break;
+    case XFS_TYPE_AABB:
+        binary_reader_read(r, &data->value.aabb, sizeof(xfs_aabb));
+        break;
+    case XFS_TYPE_OBB:
+        binary_reader_read(r, &data->value.obb, sizeof(xfs_obb));
+        break;
+    case XFS_TYPE_CYLINDER:
+        binary_reader_read(r, &data->value.cylinder, sizeof(xfs_cylinder));
+        break;
+    case XFS_TYPE_TRIANGLE:
+        binary_reader_read(r, &data->value.triangle, sizeof(xfs_triangle));
+        break;
+    case XFS_TYPE_CONE:
+        binary_reader_read(r, &data->value.cone, sizeof(xfs_cone));
+        break;
+    case XFS_TYPE_TORUS:
+        binary_reader_read(r, &data->value.torus, sizeof(xfs_torus));
+        break;
+    case XFS_TYPE_ELLIPSOID:
+        binary_reader_read(r, &data->value.ellipsoid, sizeof(xfs_ellipsoid));
+        break;
+    case XFS_TYPE_RANGE:
+        data->value.range.s = binary_reader_read_s32(r);
+        data->value.range.r = binary_reader_read_u32(r);
+        break;
+    case XFS_TYPE_RANGEF:
+        data->value.rangef.s = binary_reader_read_f32(r);
+        data->value.rangef.r = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_RANGEU16:
+        data->value.rangeu16.s = binary_reader_read_u16(r);
+        data->value.rangeu16.r = binary_reader_read_u16(r);
+        break;
+    case XFS_TYPE_HERMITECURVE:
+        binary_reader_read(r, &data->value.hermitecurve, sizeof(xfs_hermitecurve));
+        break;
+    case XFS_TYPE_FLOAT3x4:
+        binary_reader_read(r, &data->value.float3x4, sizeof(xfs_float3x4));
+        break;
+    case XFS_TYPE_LINESEGMENT4:
+        binary_reader_read(r, &data->value.linesegment4, sizeof(xfs_linesegment4));
+        break;
+    case XFS_TYPE_AABB4:
+        binary_reader_read(r, &data->value.aabb4, sizeof(xfs_aabb4));
+        break;
+    case XFS_TYPE_VECTOR2:
+        data->value.vector2.x = binary_reader_read_f32(r);
+        data->value.vector2.y = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_MATRIX33:
+        binary_reader_read(r, &data->value.matrix33, sizeof(xfs_matrix33));
+        break;
+    case XFS_TYPE_RECT3D_XZ:
+        binary_reader_read(r, &data->value.rect3d_xz, sizeof(xfs_rect3d_xz));
+        break;
+    case XFS_TYPE_RECT3D:
+        binary_reader_read(r, &data->value.rect3d, sizeof(xfs_rect3d));
+        break;
+    case XFS_TYPE_PLANE_XZ:
+        binary_reader_read(r, &data->value.plane_xz, sizeof(xfs_plane_xz));
+        break;
+    case XFS_TYPE_RAY_Y:
+        binary_reader_read(r, &data->value.ray_y, sizeof(xfs_ray_y));
+        break;
+    case XFS_TYPE_POINTF:
+        data->value.pointf.x = binary_reader_read_f32(r);
+        data->value.pointf.y = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_SIZEF:
+        data->value.sizef.w = binary_reader_read_f32(r);
+        data->value.sizef.h = binary_reader_read_f32(r);
+        break;
+    case XFS_TYPE_RECTF:
+        data->value.rectf.t = binary_reader_read_f32(r);
+        data->value.rectf.l = binary_reader_read_f32(r);
+        data->value.rectf.b = binary_reader_read_f32(r);
+        data->value.rectf.r = binary_reader_read_f32(r);
+        break;
+    default:
+        break;
+    }
+}
+
+// Writes a value of a type xfs_pod_is_type accepts, like xfs_save_data. Writes exactly what
+// xfs_pod_read reads, in the same order.
+static inline void xfs_pod_write(const xfs_data* data, xfs_type_t type, binary_writer* w) {
+    switch (type) {
+    case XFS_TYPE_BOOL:
+        binary_writer_write_bool(w, data->value.b);
+        break;
+    case XFS_TYPE_U8:
+        binary_writer_write_u8(w, data->value.u8);
+        break;
+    case XFS_TYPE_U16:
+        binary_writer_write_u16(w, data->value.u16);
+        break;
+    case XFS_TYPE_U32:
+        binary_writer_write_u32(w, data->value.u32);
+        break;
+    case XFS_TYPE_U64:
+        binary_writer_write_u64(w, data->value.u64);
+        break;
+    case XFS_TYPE_S8:
+        binary_writer_write_s8(w, data->value.s8);
+        break;
+    case XFS_TYPE_S16:
+        binary_writer_write_s16(w, data->value.s16);
+        break;
+    case XFS_TYPE_S32:
+        binary_writer_write_s32(w, data->value.s32);
+        break;
+    case XFS_TYPE_S64:
+        binary_writer_write_s64(w, data->value.s64);
+        break;
+    case XFS_TYPE_F32:
+        binary_writer_write_f32(w, data->value.f32);
+        break;
+    case XFS_TYPE_F64:
+        binary_writer_write_f64(w, data->value.f64);
+        break;
+    case XFS_TYPE_COLOR:
+        binary_writer_write_u32(w, data->value.color);
+        break;
+    case XFS_TYPE_POINT:
+        binary_writer_write_s32(w, data->value.point.x);
+        binary_writer_write_s32(w, data->value.point.y);
+        break;
+    case XFS_TYPE_SIZE:
+        binary_writer_write_s32(w, data->value.size.w);
+        binary_writer_write_s32(w, data->value.size.h);
+        break;
+    case XFS_TYPE_RECT:
+        binary_writer_write(w, &data->value.rect, sizeof(xfs_rect));
+        break;
+    case XFS_TYPE_MATRIX:
+        binary_writer_write(w, &data->value.matrix, sizeof(xfs_matrix));
+        break;
+    case XFS_TYPE_VECTOR3:
+        binary_writer_write(w, &data->value.vector3, sizeof(xfs_vector3));
+        break;
+    case XFS_TYPE_VECTOR4:
+        binary_writer_write(w, &data->value.vector4, sizeof(xfs_vector4));
+        break;
+    case XFS_TYPE_QUATERNION:
+        binary_writer_write(w, &data->value.quaternion, sizeof(xfs_quaternion));
+        break;
+    case XFS_TYPE_TIME:
+        binary_writer_write_s64(w, data->value.time.time);
+        break;
+    case XFS_TYPE_FLOAT2:
+        binary_writer_write_f32(w, data->value.float2.x);
+        binary_writer_write_f32(w, data->value.float2.y);
+        break;
+    case XFS_TYPE_FLOAT3:
+        binary_writer_write(w, &data->value.float3, sizeof(xfs_float3));
+        break;
+    case XFS_TYPE_FLOAT4:
+        binary_writer_write(w, &data->value.float4, sizeof(xfs_float4));
+        break;
+    case XFS_TYPE_FLOAT3x3:
+        binary_writer_write(w, &data->value.float3x3, sizeof(xfs_float3x3));
+        break;
+    case XFS_TYPE_FLOAT4x3:
+        binary_writer_write(w, &data->value.float4x3, sizeof(xfs_float4x3));
+        break;
+    case XFS_TYPE_FLOAT4x4:
+        binary_writer_write(w, &data->value.float4x4, sizeof(xfs_float4x4));
+        break;
+    case XFS_TYPE_EASECURVE:
+        binary_writer_write_f32(w, data->value.easecurve.p1);
+        binary_writer_write_f32(w, data->value.easecurve.p2);
+        break;
+    case XFS_TYPE_LINE:
+        binary_writer_write(w, &data->value.line, sizeof(xfs_line));
+        break;
+    case XFS_TYPE_LINESEGMENT:
+        binary_writer_write(w, &data->value.linesegment, sizeof(xfs_linesegment));
+        break;
+    case XFS_TYPE_RAY:
+        binary_writer_write(w, &data->value.ray, sizeof(xfs_ray));
+        break;
+    case XFS_TYPE_PLANE:
+        binary_writer_write(w, &data->value.plane, sizeof(xfs_plane));
+        break;
+    case XFS_TYPE_SPHERE:
+        binary_writer_write(w, &data->value.sphere, sizeof(xfs_sphere));
+        break;
+    case XFS_TYPE_CAPSULE:
+        binary_writer_write(w, &data->value.capsule, sizeof(xfs_capsule));
+        break;
+    case XFS_TYPE_AABB:
+        binary_writer_write(w, &data->value.aabb, sizeof(xfs_aabb));
+        break;
+    case XFS_TYPE_OBB:
+        binary_writer_write(w, &data->value.obb, sizeof(xfs_obb));
+        break;
+    case XFS_TYPE_CYLINDER:
+        binary_writer_write(w, &data->value.cylinder, sizeof(xfs_cylinder));
+        break;
+    case XFS_TYPE_TRIANGLE:
+        binary_writer_write(w, &data->value.triangle, sizeof(xfs_triangle));
+        break;
+    case XFS_TYPE_CONE:
+        binary_writer_write(w, &data->value.cone, sizeof(xfs_cone));
+        break;
+    case XFS_TYPE_TORUS:
+        binary_writer_write(w, &data->value.torus, sizeof(xfs_torus));
+        break;
+    case XFS_TYPE_ELLIPSOID:
+        binary_writer_write(w, &data->value.ellipsoid, sizeof(xfs_ellipsoid));
+        break;
+    case XFS_TYPE_RANGE:
+        binary_writer_write_s32(w, data->value.range.s);
+        binary_writer_write_u32(w, data->value.range.r);
+        break;
+    case XFS_TYPE_RANGEF:
+        binary_writer_write_f32(w, data->value.rangef.s);
+        binary_writer_write_f32(w, data->value.rangef.r);
+        break;
+    case XFS_TYPE_RANGEU16:
+        binary_writer_write_u16(w, (uint16_t)data->value.rangeu16.s);
+        binary_writer_write_u16(w, (uint16_t)data->value.rangeu16.r);
+        break;
+    case XFS_TYPE_HERMITECURVE:
+        binary_writer_write(w, &data->value.hermitecurve, sizeof(xfs_hermitecurve));
+        break;
+    case XFS_TYPE_FLOAT3x4:
+        binary_writer_write(w, &data->value.float3x4, sizeof(xfs_float3x4));
+        break;
+    case XFS_TYPE_LINESEGMENT4:
+        binary_writer_write(w, &data->value.linesegment4, sizeof(xfs_linesegment4));
+        break;
+    case XFS_TYPE_AABB4:
+        binary_writer_write(w, &data->value.aabb4, sizeof(xfs_aabb4));
+        break;
+    case XFS_TYPE_VECTOR2:
+        binary_writer_write_f32(w, data->value.vector2.x);
+        binary_writer_write_f32(w, data->value.vector2.y);
+        break;
+    case XFS_TYPE_MATRIX33:
+        binary_writer_write(w, &data->value.matrix33, sizeof(xfs_matrix33));
+        break;
+    case XFS_TYPE_RECT3D_XZ:
+        binary_writer_write(w, &data->value.rect3d_xz, sizeof(xfs_rect3d_xz));
+        break;
+    case XFS_TYPE_RECT3D:
+        binary_writer_write(w, &data->value.rect3d, sizeof(xfs_rect3d));
+        break;
+    case XFS_TYPE_PLANE_XZ:
+        binary_writer_write(w, &data->value.plane_xz, sizeof(xfs_plane_xz));
+        break;
+    case XFS_TYPE_RAY_Y:
+        binary_writer_write(w, &data->value.ray_y, sizeof(xfs_ray_y));
+        break;
+    case XFS_TYPE_POINTF:
+        binary_writer_write_f32(w, data->value.pointf.x);
+        binary_writer_write_f32(w, data->value.pointf.y);
+        break;
+    case XFS_TYPE_SIZEF:
+        binary_writer_write_f32(w, data->value.sizef.w);
+        binary_writer_write_f32(w, data->value.sizef.h);
+        break;
+    case XFS_TYPE_RECTF:
+        binary_writer_write_f32(w, data->value.rectf.t);
+        binary_writer_write_f32(w, data->value.rectf.l);
+        binary_writer_write_f32(w, data->value.rectf.b);
+        binary_writer_write_f32(w, data->value.rectf.r);
+        break;
+    default:
+        break;
+    }
+}
+
+#endif // XFS_POD_H